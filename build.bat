@@ -15,12 +15,12 @@ IF "%1"=="debug" (GOTO Debug) ELSE (GOTO Release)
 
 :Debug
 @echo "Debug Build"
-SET flags=/Od /Zi /DCOY_PROFILE /WX /W3
+SET flags=/Od /Zi /DCOY_PROFILE /DCOY_MEMORY_TAGS /WX /W3
 GOTO Operation
 
 :Release
 @echo "Release Build"
-SET flags=/O2 /favor:INTEL64 /arch:AVX2 /DNDEBUG /DCOY_PROFILE /WX /W3
+SET flags=/O2 /favor:INTEL64 /arch:AVX2 /DNDEBUG /DCOY_PROFILE /DCOY_MEMORY_TAGS /WX /W3
 GOTO Operation
 
 rem
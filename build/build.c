@@ -13,14 +13,6 @@ str_eq(char const *left, char const *right, size len)
     return 0 == memcmp(left, right, len);
 }
 
-static b32
-load_file(char const *fname, size buf_size, byte *buffer, size *read)
-{
-    *read = coy_file_slurp(fname, buf_size, buffer);
-    if(*read < 0) { return false; }
-    return true;
-}
-
 static void
 insert_buffer(size out_size, size *out_idx, char *out, size in_size, char *in)
 {
@@ -34,43 +26,42 @@ insert_buffer(size out_size, size *out_idx, char *out, size in_size, char *in)
 int
 main(int argc, char *argv[])
 {
-    char main_buffer[COY_KiB(100)] = {0};
-    size mb_size = 0;
-    char win32_buffer[COY_KiB(100)] = {0};
-    size w32_size = 0;
-    char apple_buffer[COY_KiB(20)] = {0};
-    size ap_size = 0;
-    char linux_buffer[COY_KiB(20)] = {0};
-    size li_size = 0;
-    char common_buffer[COY_KiB(100)] = {0};
-    size co_size = 0;
-
-    char finished_lib[COY_KiB(350)] = {0};
-
-    // Load all the files
-    char const *fname = "../src/coyote.h";
-    b32 success = load_file(fname, sizeof(main_buffer), main_buffer, &mb_size);
-    StopIf(!success, return 1);
-
-    char const *fname_win32 = "../src/coyote_win32.h";
-    success = load_file(fname_win32, sizeof(win32_buffer), win32_buffer, &w32_size);
-    StopIf(!success, return 1);
-
-    char const *fname_apple = "../src/coyote_apple_osx.h";
-    success = load_file(fname_apple, sizeof(apple_buffer), apple_buffer, &ap_size);
-    StopIf(!success, return 1);
-
-    char const *fname_linux = "../src/coyote_linux.h";
-    success = load_file(fname_linux, sizeof(linux_buffer), linux_buffer, &li_size);
-    StopIf(!success, return 1);
-
-    char const *fname_common = "../src/coyote_linux_apple_common.h";
-    success = load_file(fname_common, sizeof(common_buffer), common_buffer, &co_size);
-    StopIf(!success, return 1);
+    // Load all the files, in one go and exactly as big as they are.
+    char const *fnames[] =
+    {
+        "../src/coyote.h",
+        "../src/coyote_win32.h",
+        "../src/coyote_apple_osx.h",
+        "../src/coyote_linux.h",
+        "../src/coyote_linux_apple_common.h",
+    };
+    CoyByteView files[COY_ARRAY_SIZE(fnames)] = {0};
+
+    /* Only what gets pushed is committed, so the reservation can be generous. */
+    CoyArena arena_ = coy_arena_create_reserved(COY_GiB(1));
+    CoyArena *arena = &arena_;
+    StopIf(!arena->valid, fprintf(stderr, "Error allocating memory\n"); return 1);
+
+    b32 success = coy_file_slurp_batch(COY_ARRAY_SIZE(fnames), fnames, arena, COY_ARRAY_SIZE(fnames), files);
+    StopIf(!success, fprintf(stderr, "Error loading source files\n"); return 1);
+
+    char *main_buffer = (char *)files[0].data;
+    char *win32_buffer = (char *)files[1].data;
+    size w32_size = files[1].num_bytes;
+    char *apple_buffer = (char *)files[2].data;
+    size ap_size = files[2].num_bytes;
+    char *linux_buffer = (char *)files[3].data;
+    size li_size = files[3].num_bytes;
+    char *common_buffer = (char *)files[4].data;
+    size co_size = files[4].num_bytes;
+
+    size finished_size = files[0].num_bytes + w32_size + ap_size + li_size + co_size + 1;
+    char *finished_lib = coy_arena_push(arena, finished_size, 1);
+    StopIf(!finished_lib, fprintf(stderr, "Error allocating memory\n"); return 1);
 
     // Merge them in a buffer
     char *c = main_buffer;
-    char *end = memchr(c, '\0', sizeof(main_buffer));
+    char *end = main_buffer + files[0].num_bytes;
 
     char *insert_marker = memchr(c, '#', end - c);
     Assert(insert_marker);
@@ -79,29 +70,29 @@ main(int argc, char *argv[])
     {
 	  if(str_eq("#include \"coyote_win32.h\"", insert_marker, 25))
 	  {
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, insert_marker - c, c);
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, w32_size, win32_buffer);
+		insert_buffer(finished_size, &oi, finished_lib, insert_marker - c, c);
+		insert_buffer(finished_size, &oi, finished_lib, w32_size, win32_buffer);
 		insert_marker += 25;
 		c = insert_marker;
 	  }
 	  else if(str_eq("#include \"coyote_linux.h\"", insert_marker, 25))
 	  {
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, insert_marker - c, c);
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, li_size, linux_buffer);
+		insert_buffer(finished_size, &oi, finished_lib, insert_marker - c, c);
+		insert_buffer(finished_size, &oi, finished_lib, li_size, linux_buffer);
 		insert_marker += 25;
 		c = insert_marker;
 	  }
 	  else if(str_eq("#include \"coyote_apple_osx.h\"", insert_marker, 29))
 	  {
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, insert_marker - c, c);
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, ap_size, apple_buffer);
+		insert_buffer(finished_size, &oi, finished_lib, insert_marker - c, c);
+		insert_buffer(finished_size, &oi, finished_lib, ap_size, apple_buffer);
 		insert_marker += 29;
 		c = insert_marker;
 	  }
 	  else if(str_eq("#include \"coyote_linux_apple_common.h\"", insert_marker, 38))
 	  {
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, insert_marker - c, c);
-		insert_buffer(sizeof(finished_lib), &oi, finished_lib, co_size, common_buffer);
+		insert_buffer(finished_size, &oi, finished_lib, insert_marker - c, c);
+		insert_buffer(finished_size, &oi, finished_lib, co_size, common_buffer);
 		insert_marker += 38;
 		c = insert_marker;
 	  }
@@ -110,7 +101,7 @@ main(int argc, char *argv[])
 		insert_marker = memchr(insert_marker + 1, '#', end - insert_marker);
 		if(!insert_marker)
 		{
-		    insert_buffer(sizeof(finished_lib), &oi, finished_lib, end - c, c);
+		    insert_buffer(finished_size, &oi, finished_lib, end - c, c);
 		    break;
 		}
 	  }
@@ -125,4 +116,5 @@ main(int argc, char *argv[])
     Assert(coyote_wrote == oi);
 
     coy_file_writer_close(coyote);
+    coy_arena_destroy(arena);
 }
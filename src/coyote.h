@@ -4,6 +4,20 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/* SSSE3 code is compiled on every x86-64 target without any compiler flags and only run if the CPU has it. */
+#if defined(__x86_64__) || defined(_M_X64)
+#include <tmmintrin.h>
+#define COY_HAVE_SSSE3 1
+#  if defined(_MSC_VER)
+#  include <intrin.h>
+#  define COY_TARGET_SSSE3
+#  else
+#  define COY_TARGET_SSSE3 __attribute__((target("ssse3")))
+#  endif
+#else
+#define COY_HAVE_SSSE3 0
+#endif
+
 #pragma warning(push)
 
 /*---------------------------------------------------------------------------------------------------------------------------
@@ -97,11 +111,40 @@ static inline u64 coy_time_now(void); // Get the current system time in seconds
  *---------------------------------------------------------------------------------------------------------------------------
  * Request big chunks of memory from the OS, bypassing the CRT. The system may round up your requested memory size, but it
  * will return an error instead of rounding down if there isn't enough memory.
+ *
+ * coy_memory_allocate returns memory that is ready to use (and on Linux pre-faulted). Alternatively, coy_memory_reserve only
+ * reserves address space, and then sub-ranges are committed and decommitted on demand. Commit and decommit round the range
+ * out to page boundaries. Pages that are decommitted and then committed again are zeroed. The committed member adds the
+ * bytes committed and subtracts the bytes decommitted, clamped to 0..size. It doesn't track individual pages, so it's
+ * exact only if you don't commit a range that's already committed (or decommit one that isn't), but committing or
+ * decommitting the whole block always leaves it at size or 0.
+ *
+ * coy_memory_allocate_with_flags can request huge pages to cut down on TLB misses for big blocks. It tries explicit huge
+ * pages first (MAP_HUGETLB on Linux, large pages on Windows), falls back to transparent huge pages where the OS has them,
+ * and finally to normal pages. The page_kind member reports what you actually got. Explicit huge pages must be set up by
+ * the system administrator (e.g. /proc/sys/vm/nr_hugepages), and the size is rounded up to a multiple of the huge page size.
  */
+typedef enum
+{
+    COY_MEMORY_PAGES_NORMAL = 0,
+    COY_MEMORY_PAGES_TRANSPARENT_HUGE, /* Normal pages, but the OS was asked to back them with huge pages when it can. */
+    COY_MEMORY_PAGES_HUGE_2MiB,
+    COY_MEMORY_PAGES_HUGE_1GiB,
+} CoyMemoryPageKind;
+
+typedef enum
+{
+    COY_MEMORY_FLAG_HUGE_PAGES      = 1 << 0, /* Prefer 2 MiB pages.                                */
+    COY_MEMORY_FLAG_HUGE_PAGES_1GiB = 1 << 1, /* Prefer 1 GiB pages, then fall back to 2 MiB pages.    */
+    COY_MEMORY_FLAG_LOCKED          = 1 << 2, /* Lock in RAM with coy_memory_lock, fail if it can't be. */
+} CoyMemoryFlags;
+
 typedef struct
 {
     void *mem;
-    size size;
+    size size;                   /* Bytes of address space reserved. */
+    size committed;              /* Bytes of that space committed.   */
+    CoyMemoryPageKind page_kind;
     b32 valid;
 } CoyMemoryBlock;
 
@@ -115,8 +158,224 @@ typedef struct
 #define COY_GiB(a) (COY_MiB(a) * INT64_C(1024))
 #define COY_TiB(a) (COY_GiB(a) * INT64_C(1024))
 
+static inline size coy_memory_page_size(void);
 static inline CoyMemoryBlock coy_memory_allocate(size minimum_num_bytes);
-static inline void coy_memory_free(CoyMemoryBlock *mem);
+static inline CoyMemoryBlock coy_memory_allocate_with_flags(size minimum_num_bytes, u32 flags); /* CoyMemoryFlags */
+static inline void coy_memory_free(CoyMemoryBlock *mem); /* Also frees reserved blocks. */
+
+/* Map the block without pre-faulting it, then fault the pages in with num_threads threads (including the calling thread).
+ * Each thread touches its own contiguous slice, so with the OS's default first touch policy, pages land on the NUMA node of
+ * the thread that touched them. stats may be NULL. Page faults are only counted if coy_profile_initialize_os_metrics was
+ * called first.
+ */
+#define COY_PREFAULT_MAX_THREADS 256
+typedef struct
+{
+    f64 seconds;     /* Wall clock time spent faulting in the pages. */
+    u64 page_faults;
+    i32 num_threads; /* Number of threads actually used.             */
+} CoyPrefaultStats;
+
+static inline CoyMemoryBlock coy_memory_allocate_prefault_parallel(size minimum_num_bytes, i32 num_threads, CoyPrefaultStats *stats);
+
+static inline CoyMemoryBlock coy_memory_reserve(size minimum_num_bytes); /* Nothing committed, touching it will crash. */
+static inline b32 coy_memory_commit(CoyMemoryBlock *mem, size offset, size num_bytes);
+static inline b32 coy_memory_decommit(CoyMemoryBlock *mem, size offset, size num_bytes);
+
+/* Lock pages in RAM so they're never paged out, so touching them never takes a major fault. Locking normally faults in the
+ * whole block first. With on_fault (Linux only, elsewhere it's ignored) pages are locked as they're first touched instead,
+ * which works for reserved blocks that are committed bit by bit. The OS limits how much memory a process can lock
+ * (RLIMIT_MEMLOCK on Linux & Apple, the working set size on Windows), so these return false if the limit is hit. The whole
+ * block counts against the limit, even with on_fault. Freeing a block unlocks it.
+ */
+static inline b32 coy_memory_lock(CoyMemoryBlock const *mem, b32 on_fault);
+static inline b32 coy_memory_unlock(CoyMemoryBlock const *mem);
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                          NUMA
+ *---------------------------------------------------------------------------------------------------------------------------
+ * On machines with more than one socket, each node has its own memory and reaching another node's memory is slower. By
+ * default the OS puts a page on the node of the thread that first touches it. These functions place memory and threads on a
+ * node explicitly. Nodes are numbered 0 to coy_numa_node_count() - 1. On single node machines (and OS's without NUMA
+ * support) there is only node 0, allocation is the same as coy_memory_allocate, and binding a thread does nothing.
+ *
+ * coy_memory_allocate_numa returns memory that is ready to use, like coy_memory_allocate. Pass COY_NUMA_INTERLEAVE as the
+ * node to spread the pages round robin across all the nodes, which is good for tables that every thread reads. Memory
+ * placed on a node may still come from another node if the preferred node runs out.
+ *
+ * coy_numa_bind_current_thread restricts the calling thread to the CPUs of a node, and on Linux also prefers that node for
+ * memory the thread faults in from then on. Call it first thing in a CoyThreadFunc.
+ */
+#define COY_NUMA_INTERLEAVE -1
+
+static inline i32 coy_numa_node_count(void); /* Always at least 1. */
+static inline CoyMemoryBlock coy_memory_allocate_numa(size minimum_num_bytes, i32 node);
+static inline i32 coy_memory_node(CoyMemoryBlock const *mem); /* Node of the first page, or -1 on error. */
+static inline b32 coy_numa_bind_current_thread(i32 node); /* Returns false on error or if the node doesn't exist. */
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                   Memory Block Cache
+ *---------------------------------------------------------------------------------------------------------------------------
+ * An opt-in cache for blocks from coy_memory_allocate. Requests are rounded up to a size class (4 classes per power of 2),
+ * and freeing a block into the cache keeps it mapped while telling the OS it may reclaim the pages lazily if it needs them
+ * (MADV_FREE on Linux & Apple, MEM_RESET on Windows). If the OS doesn't reclaim them, the next allocation of the same size
+ * class gets the block back with no system call and no page faults. The contents of a recycled block are undefined.
+ *
+ * The cache holds at most COY_MEMORY_CACHE_SLOTS blocks and max_bytes_cached bytes, a block that doesn't fit is freed.
+ * coy_memory_cache_trim releases cached blocks back to the OS, oldest first.
+ *
+ * WARNING: NOT THREADSAFE.
+ */
+#define COY_MEMORY_CACHE_SLOTS 64
+typedef struct
+{
+    CoyMemoryBlock blocks[COY_MEMORY_CACHE_SLOTS]; /* Oldest first. */
+    i32 count;
+    size bytes_cached;
+    size max_bytes_cached;
+    u64 hits;
+    u64 misses;
+} CoyMemoryCache;
+
+static inline CoyMemoryCache coy_memory_cache_create(size max_bytes_cached);
+static inline void coy_memory_cache_destroy(CoyMemoryCache *cache); /* Releases all cached blocks. */
+static inline CoyMemoryBlock coy_memory_cache_allocate(CoyMemoryCache *cache, size minimum_num_bytes);
+static inline void coy_memory_cache_free(CoyMemoryCache *cache, CoyMemoryBlock *mem); /* Must set valid member to false. */
+static inline void coy_memory_cache_trim(CoyMemoryCache *cache, size max_bytes_to_keep);
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                      Memory Arena
+ *---------------------------------------------------------------------------------------------------------------------------
+ * A linear (bump) allocator. Pushing onto an arena is just a pointer bump, and everything is released at once with a reset
+ * or by restoring a previously saved marker. An arena either owns its memory (coy_arena_create gets it from
+ * coy_memory_allocate) or borrows a buffer from the caller (coy_arena_create_from_buffer).
+ *
+ * coy_arena_create_reserved reserves address space for the worst case and commits it COY_ARENA_COMMIT_SIZE bytes at a time
+ * as the arena grows, so you only pay for what you actually use.
+ *
+ * Check the 'valid' member of the struct to check for errors! Push functions return NULL if there isn't enough space left.
+ */
+typedef struct
+{
+    byte *buf;
+    size buf_size;
+    size offset;         /* Next free byte in buf.                                  */
+    CoyMemoryBlock mem;  /* Backing memory, only valid if the arena owns its memory. */
+    b32 valid;
+} CoyArena;
+
+typedef struct
+{
+    CoyArena *arena;
+    size offset;
+} CoyArenaMarker;
+
+#define COY_ARENA_COMMIT_SIZE COY_KiB(64)
+
+static inline CoyArena coy_arena_create(size minimum_num_bytes);
+static inline CoyArena coy_arena_create_reserved(size maximum_num_bytes);
+static inline CoyArena coy_arena_create_from_buffer(size buf_size, byte *buffer); /* Does NOT take ownership of buffer. */
+static inline void coy_arena_destroy(CoyArena *arena);                             /* Must set valid member to false.    */
+
+static inline void *coy_arena_push(CoyArena *arena, size num_bytes, size alignment);      /* alignment must be a power of 2 */
+static inline void *coy_arena_push_zero(CoyArena *arena, size num_bytes, size alignment); /* Same as above, but zeroed.     */
+static inline void coy_arena_reset(CoyArena *arena);
+static inline size coy_arena_bytes_remaining(CoyArena const *arena);
+
+static inline CoyArenaMarker coy_arena_save(CoyArena *arena);
+static inline void coy_arena_restore(CoyArenaMarker marker); /* Release everything pushed since the marker was saved. */
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                     Growable Array
+ *---------------------------------------------------------------------------------------------------------------------------
+ * A growable array that reserves address space for max_elements up front and commits more of it as the array grows. Growing
+ * never copies the data, and pointers into the array stay valid for its whole life. Reserving is cheap, so size max_elements
+ * for the worst case.
+ *
+ * Check the 'valid' member of the struct to check for errors! Functions that add elements return NULL if the array is full.
+ */
+typedef struct
+{
+    byte *data;
+    size elem_size;
+    size len;          /* Number of elements in the array.              */
+    size capacity;     /* Number of elements that fit in committed memory. */
+    size max_len;      /* Number of elements that fit in the reservation.  */
+    CoyMemoryBlock mem;
+    b32 valid;
+} CoyVec;
+
+static inline CoyVec coy_vec_create(size elem_size, size max_elements);
+static inline void coy_vec_destroy(CoyVec *vec); /* Must set valid member to false. */
+static inline b32 coy_vec_reserve(CoyVec *vec, size num_elements); /* Make sure capacity is at least num_elements. */
+static inline void *coy_vec_push(CoyVec *vec, void const *elem);   /* Copy elem onto the end, return a pointer to it. */
+static inline void *coy_vec_extend(CoyVec *vec, size num_elements); /* Add uninitialized elements, return the first.  */
+static inline void coy_vec_truncate(CoyVec *vec, size len);        /* Keeps the memory committed.                     */
+
+#define COY_VEC_CREATE(type, max_elements) coy_vec_create(sizeof(type), (max_elements))
+#define COY_VEC_PUSH(vec, type) ((type *)coy_vec_extend((vec), 1))
+#define COY_VEC_AT(vec, type, idx) (((type *)(vec)->data)[(idx)])
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                     Scratch Arenas
+ *---------------------------------------------------------------------------------------------------------------------------
+ * Each thread has COY_SCRATCH_NUM_ARENAS reserved arenas for temporary allocations. They're created the first time a thread
+ * asks for one, and only commit memory as they're used. Pass in any arenas you're already using (e.g. one your caller
+ * handed you for the results) as conflicts, and you'll get a scratch arena that isn't one of them. Everything pushed onto
+ * the scratch arena is released in O(1) by coy_scratch_end.
+ *
+ * WARNING: This is thread local global state. Threads started with coy_thread_create release their scratch arenas when they
+ * exit, any other thread should call coy_scratch_release before it exits.
+ */
+#define COY_SCRATCH_NUM_ARENAS 2
+#define COY_SCRATCH_SIZE COY_GiB(1)
+
+#if defined(_MSC_VER)
+#define COY_THREAD_LOCAL __declspec(thread)
+#else
+#define COY_THREAD_LOCAL _Thread_local
+#endif
+
+/* Returns a marker with a NULL arena if there is no scratch arena available. */
+static inline CoyArenaMarker coy_scratch_begin(i32 num_conflicts, CoyArena *const *conflicts);
+static inline void coy_scratch_end(CoyArenaMarker scratch);
+static inline void coy_scratch_release(void); /* Free this thread's scratch arenas. */
+
+#define COY_ARENA_PUSH(arena, type) ((type *)coy_arena_push((arena), sizeof(type), _Alignof(type)))
+#define COY_ARENA_PUSH_ZERO(arena, type) ((type *)coy_arena_push_zero((arena), sizeof(type), _Alignof(type)))
+#define COY_ARENA_PUSH_ARRAY(arena, type, count)                                                                            \
+    ((type *)coy_arena_push((arena), (size)sizeof(type) * (count), _Alignof(type)))
+#define COY_ARENA_PUSH_ARRAY_ZERO(arena, type, count)                                                                       \
+    ((type *)coy_arena_push_zero((arena), (size)sizeof(type) * (count), _Alignof(type)))
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                   Magic Ring Buffer
+ *---------------------------------------------------------------------------------------------------------------------------
+ * A ring buffer with the same memory mapped twice, back to back. Bytes that wrap around the end of the buffer also show up
+ * right after it, so up to capacity bytes can always be read (or written) as one contiguous span, without ever copying data
+ * to the front. The capacity is rounded up to the page size (the allocation granularity, 64 KiB, on Windows).
+ *
+ * Write into coy_ring_buffer_write_ptr, up to coy_ring_buffer_space bytes, then call coy_ring_buffer_produce. Read from
+ * coy_ring_buffer_read_ptr, up to coy_ring_buffer_bytes bytes, then call coy_ring_buffer_consume. Not thread safe.
+ */
+typedef struct
+{
+    byte *buf;        /* capacity bytes, and the same bytes again at buf + capacity. */
+    size capacity;
+    size read_offset; /* Always less than capacity.                                  */
+    size num_bytes;   /* Bytes produced but not consumed yet.                        */
+    iptr _internal;   /* Implementation specific data.                               */
+    b32 valid;
+} CoyRingBuffer;
+
+static inline CoyRingBuffer coy_ring_buffer_create(size minimum_capacity);
+static inline void coy_ring_buffer_destroy(CoyRingBuffer *ring); /* Must set valid member to false. */
+static inline size coy_ring_buffer_bytes(CoyRingBuffer const *ring); /* Bytes ready to read. */
+static inline size coy_ring_buffer_space(CoyRingBuffer const *ring); /* Bytes free to write. */
+static inline byte *coy_ring_buffer_read_ptr(CoyRingBuffer *ring);
+static inline byte *coy_ring_buffer_write_ptr(CoyRingBuffer *ring);
+static inline void coy_ring_buffer_produce(CoyRingBuffer *ring, size num_bytes);
+static inline void coy_ring_buffer_consume(CoyRingBuffer *ring, size num_bytes);
 
 /*---------------------------------------------------------------------------------------------------------------------------
  *                                                     Files & Paths
@@ -150,17 +409,92 @@ static inline b32 coy_path_append(size buf_len, char path_buffer[], char const *
 
 static inline size coy_file_size(char const *filename); /* size of a file in bytes, -1 on error. */
 
-#define COY_FILE_READER_BUF_SIZE COY_KiB(32)
+/* A piece of memory for the vectored (scatter / gather) reads and writes. */
+#define COY_FILE_MAX_IO_VECS 64
+typedef struct
+{
+    void *data;
+    size num_bytes;
+} CoyIoVec;
+
+/* Byte order of values in a file for the array reads and writes. NATIVE is this machine's order, no conversion. */
+typedef enum
+{
+    COY_BYTE_ORDER_NATIVE,
+    COY_BYTE_ORDER_LITTLE,
+    COY_BYTE_ORDER_BIG,
+} CoyByteOrder;
+
+#define COY_FILE_READER_BUF_SIZE COY_KiB(32) // buffer size used by coy_file_open_read
 typedef struct
 {
     iptr handle; // posix returns an int and windows a HANDLE (e.g. void*), this should work for all of them.
-    byte buffer[COY_FILE_READER_BUF_SIZE];
+    byte *buffer;
+    size buf_size;
     size buf_cursor;
     size bytes_remaining;
+    CoyMemoryBlock buffer_mem; // only valid if the reader allocated buffer itself, then close frees it.
+    CoyRingBuffer ring;        // only valid in ring mode, then it's used instead of buffer.
+    b32 streaming;             // drop pages behind the read position, see coy_file_set_streaming.
+    size dropped_through;      // file offset pages have been dropped up to in streaming mode.
+    size file_offset;          // bytes read from the file so far, where the next read from the OS starts.
     b32 valid;   // error indicator
 } CoyFileReader;
 
+typedef struct
+{
+    byte const *data;
+    size num_bytes; /* -1 on error. */
+} CoyByteView;
+
+/* Reads through a COY_FILE_READER_BUF_SIZE buffer of its own. It comes from coy_memory_allocate, so every open costs an
+ * mmap (VirtualAlloc on Windows), plus prefaulting the pages on Linux, and close unmaps it again. If you open lots of
+ * files, say one per record or many at once, use coy_file_open_read_with_buffer with buffers pushed on an arena.
+ */
 static inline CoyFileReader coy_file_open_read(char const *filename);
+
+/* Tell the OS how a file or mapping will be used. These are hints, where a platform can't act on one it's ignored and
+ * they return true, false means a real error. num_bytes == 0 means through the end of the file. WILLNEED starts reading
+ * the range in the background (readahead), DONTNEED drops its cached pages.
+ *
+ * Linux uses posix_fadvise / madvise. Apple only does read ahead on or off and WILLNEED for files, but all of them for
+ * mappings. Windows only does WILLNEED and DONTNEED for mappings.
+ */
+typedef enum
+{
+    COY_ACCESS_NORMAL,
+    COY_ACCESS_SEQUENTIAL,
+    COY_ACCESS_RANDOM,
+    COY_ACCESS_WILLNEED,
+    COY_ACCESS_DONTNEED,
+} CoyAccessHint;
+
+static inline b32 coy_file_advise(CoyFileReader *file, CoyAccessHint hint, size offset, size num_bytes);
+
+/* Streaming mode is for one pass scans. It reads ahead aggressively and drops the cached pages behind the read position
+ * every COY_FILE_DROP_BEHIND_BYTES, so a huge scan doesn't push everything else out of the page cache.
+ */
+#define COY_FILE_DROP_BEHIND_BYTES COY_MiB(8)
+static inline b32 coy_file_set_streaming(CoyFileReader *file, b32 streaming);
+
+/* Read through a caller provided buffer, e.g. from an arena, of any size. The reader does NOT take ownership of it, so it
+ * must outlive the reader. Big buffers for long sequential scans, small ones when lots of files are open at once.
+ */
+static inline CoyFileReader coy_file_open_read_with_buffer(char const *filename, size buf_size, byte *buffer);
+
+/* Ring mode reads through a magic ring buffer of at least ring_capacity bytes instead of the fixed buffer, so refilling
+ * never moves the leftover bytes, and a peek of up to the ring's capacity is contiguous even when it wraps around the end.
+ */
+static inline CoyFileReader coy_file_open_read_ring(char const *filename, size ring_capacity);
+
+/* Look at the buffered data in place, without copying it out. Refills the buffer if fewer than min_bytes are buffered, so
+ * the view has at least min_bytes in it unless the end of the file is near. min_bytes can't be more than the buffer size.
+ * The view is good until the next call on the reader. Call coy_file_consume when done with (some of) the bytes.
+ */
+static inline CoyByteView coy_file_peek(CoyFileReader *file, size min_bytes);
+static inline void coy_file_consume(CoyFileReader *file, size num_bytes);
+
+/* Reads of at least the buffer size go straight into buffer after handing over what was already buffered. */
 static inline size coy_file_read(CoyFileReader *file, size buf_size, byte *buffer); /* return nbytes read or -1 on error                           */
 static inline b32 coy_file_read_f64(CoyFileReader *file, f64 *val);
 static inline b32 coy_file_read_i8(CoyFileReader *file, i8 *val);
@@ -174,23 +508,79 @@ static inline b32 coy_file_read_u64(CoyFileReader *file, u64 *val);
 static inline b32 coy_file_read_str(CoyFileReader *file, size *len, char *str);     /* set len to buffer length, updated to actual size on return. */
 static inline void coy_file_reader_close(CoyFileReader *file);                      /* Must set valid member to false on success or failure!       */
 
+/* Read count values in one go instead of one call per value, converting from order as they come. Big arrays are read
+ * straight into vals, skipping the reader's buffer. Returns the number of whole values read, less than count only at
+ * the end of the file, or -1 on error.
+ */
+static inline size coy_file_read_f64_array(CoyFileReader *file, size count, f64 *vals, CoyByteOrder order);
+static inline size coy_file_read_i8_array(CoyFileReader *file, size count, i8 *vals, CoyByteOrder order);
+static inline size coy_file_read_i16_array(CoyFileReader *file, size count, i16 *vals, CoyByteOrder order);
+static inline size coy_file_read_i32_array(CoyFileReader *file, size count, i32 *vals, CoyByteOrder order);
+static inline size coy_file_read_i64_array(CoyFileReader *file, size count, i64 *vals, CoyByteOrder order);
+static inline size coy_file_read_u8_array(CoyFileReader *file, size count, u8 *vals, CoyByteOrder order);
+static inline size coy_file_read_u16_array(CoyFileReader *file, size count, u16 *vals, CoyByteOrder order);
+static inline size coy_file_read_u32_array(CoyFileReader *file, size count, u32 *vals, CoyByteOrder order);
+static inline size coy_file_read_u64_array(CoyFileReader *file, size count, u64 *vals, CoyByteOrder order);
+
+/* Scatter read into up to COY_FILE_MAX_IO_VECS pieces of memory, in order, as if by one big coy_file_read. Buffered data is
+ * handed over first. The rest is read with one readv that also refills the buffer. Returns the total number of bytes
+ * read, less than asked for only at the end of the file, or -1 on error.
+ */
+static inline size coy_file_readv(CoyFileReader *file, i32 num_vecs, CoyIoVec const *vecs);
+
 /* return size in bytes of the loaded data or -1 on error. If buffer is too small, load nothing and return -1 */
 static inline size coy_file_slurp(char const *filename, size buf_size, byte *buffer);
 
+/* Load a whole file onto an arena, exactly its size plus a zero terminator (not counted in num_bytes) so text can be used
+ * as a C string. num_bytes is -1 on error, and then nothing is left pushed on the arena.
+ */
+static inline CoyByteView coy_file_slurp_arena(char const *filename, CoyArena *arena);
+
+/* Load many files into one contiguous block pushed on the arena, each zero terminated like coy_file_slurp_arena. The
+ * files go in groups of COY_FILE_SLURP_MAX_OPEN, so no more than that are open at once. For each group num_threads
+ * threads (the calling thread is one of them) open and size a share of the files, then read them into place through
+ * the same handles. views[i] is filenames[i], with num_bytes -1 if it couldn't be read. Returns false if any failed.
+ */
+#define COY_FILE_SLURP_MAX_THREADS 32
+#define COY_FILE_SLURP_MAX_OPEN 256
+static inline b32 coy_file_slurp_batch(i32 num_files, char const *const *filenames, CoyArena *arena, i32 num_threads,
+                                       CoyByteView *views);
+
 
-#define COY_FILE_WRITER_BUF_SIZE COY_KiB(32)
+#define COY_FILE_WRITER_BUF_SIZE COY_KiB(32) // buffer size used by coy_file_create and coy_file_append
 typedef struct
 {
     iptr handle; // posix returns an int and windows a HANDLE (e.g. void*), this should work for all of them.
-    byte buffer[COY_FILE_WRITER_BUF_SIZE];
+    byte *buffer;
+    size buf_size;
     size buf_cursor;
+    CoyMemoryBlock buffer_mem; // only valid if the writer allocated buffer itself, then close frees it.
+    struct CoyFileWriterBackground *background; // only in background mode.
     b32 valid;   // error indicator
 } CoyFileWriter;
 
+/* Like coy_file_open_read these allocate their own COY_FILE_WRITER_BUF_SIZE buffer with coy_memory_allocate, an mmap
+ * (and a prefault on Linux) on every open and an munmap on close. Writing many files is cheaper with the _with_buffer
+ * versions below and an arena.
+ */
 static inline CoyFileWriter coy_file_create(char const *filename); // Truncate if it already exists, otherwise create it.
 static inline CoyFileWriter coy_file_append(char const *filename); // Create file if it doesn't exist yet, otherwise append.
+
+/* Same as above, but buffer through a caller provided buffer of any size. The writer does NOT take ownership of it. */
+static inline CoyFileWriter coy_file_create_with_buffer(char const *filename, size buf_size, byte *buffer);
+static inline CoyFileWriter coy_file_append_with_buffer(char const *filename, size buf_size, byte *buffer);
+
+/* Background mode hands each full buffer to a dedicated I/O thread and carries on in the next one, so the calling thread
+ * doesn't wait on the disk. Memory is bounded to num_buffers buffers of buf_size bytes, when they're all waiting to be
+ * written the caller blocks until one is free. A failed write shows up as an error from a later write or flush, or from
+ * close. Flush hands the buffer over without waiting for it to hit the file, close waits for everything.
+ */
+#define COY_FILE_WRITER_MAX_BACKGROUND_BUFFERS 16
+static inline CoyFileWriter coy_file_create_background(char const *filename, size buf_size, i32 num_buffers);
+static inline CoyFileWriter coy_file_append_background(char const *filename, size buf_size, i32 num_buffers);
+
 static inline size coy_file_writer_flush(CoyFileWriter *file); /* Close will also do this, only use if ALL you need is flush */
-static inline void coy_file_writer_close(CoyFileWriter *file); /* Must set valid member to false on success or failure! */
+static inline b32 coy_file_writer_close(CoyFileWriter *file); /* Must set valid member to false on success or failure! Returns false if buffered data was lost. */
 
 static inline size coy_file_write(CoyFileWriter *file, size nbytes_write, byte const *buffer); // return nbytes written or -1 on error
 static inline b32 coy_file_write_f64(CoyFileWriter *file, f64 val);
@@ -204,16 +594,113 @@ static inline b32 coy_file_write_u32(CoyFileWriter *file, u32 val);
 static inline b32 coy_file_write_u64(CoyFileWriter *file, u64 val);
 static inline b32 coy_file_write_str(CoyFileWriter *file, size len, char *str);
 
+/* Write count values in one go, converted to order on the way. Without a conversion big arrays skip the writer's
+ * buffer, with one they're swapped straight into it. Returns false on error.
+ */
+static inline b32 coy_file_write_f64_array(CoyFileWriter *file, size count, f64 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_i8_array(CoyFileWriter *file, size count, i8 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_i16_array(CoyFileWriter *file, size count, i16 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_i32_array(CoyFileWriter *file, size count, i32 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_i64_array(CoyFileWriter *file, size count, i64 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_u8_array(CoyFileWriter *file, size count, u8 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_u16_array(CoyFileWriter *file, size count, u16 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_u32_array(CoyFileWriter *file, size count, u32 const *vals, CoyByteOrder order);
+static inline b32 coy_file_write_u64_array(CoyFileWriter *file, size count, u64 const *vals, CoyByteOrder order);
+
+/* LEB128 varints, 7 bits per byte with the high bit set on all but the last byte, so small values take 1 byte instead
+ * of 8. The i64 versions zigzag encode first, so small negative values are small too. The delta arrays store the
+ * zigzagged difference from the previous value, good for sorted things like timestamps and IDs. *last is the value
+ * before vals[0], start it at 0 and pass it to every call to write or read one long sequence in pieces.
+ *
+ * Reads return false (or -1 for the arrays) on errors, at the end of the file, and on malformed data. The array reads
+ * return the number of values read, less than count only at the end of the file. They decode straight out of the
+ * reader's buffer, 8 bytes at a time while those hold all one byte values (8 of them) or all two byte values (4 of
+ * them, up to 16383). Anything else, including a mix of one and two byte values, is decoded one value at a time.
+ */
+#define COY_VARINT_MAX_BYTES 10
+static inline b32 coy_file_write_varint_u64(CoyFileWriter *file, u64 val);
+static inline b32 coy_file_write_varint_i64(CoyFileWriter *file, i64 val);
+static inline b32 coy_file_write_varint_u64_array(CoyFileWriter *file, size count, u64 const *vals);
+static inline b32 coy_file_write_delta_i64_array(CoyFileWriter *file, size count, i64 const *vals, i64 *last);
+static inline b32 coy_file_read_varint_u64(CoyFileReader *file, u64 *val);
+static inline b32 coy_file_read_varint_i64(CoyFileReader *file, i64 *val);
+static inline size coy_file_read_varint_u64_array(CoyFileReader *file, size count, u64 *vals);
+static inline size coy_file_read_delta_i64_array(CoyFileReader *file, size count, i64 *vals, i64 *last);
+
+/* Gather write up to COY_FILE_MAX_IO_VECS pieces of memory, in order, e.g. a record header and its payload. If they fit in
+ * the buffer they're copied there, otherwise the buffered data and all the pieces go out in one writev with no copies.
+ * Returns the number of bytes from vecs written, or -1 on error. After an error the buffer only holds what hasn't
+ * reached the file yet, and if some of vecs did reach it the writer is marked invalid, a retry would duplicate them.
+ */
+static inline size coy_file_writev(CoyFileWriter *file, i32 num_vecs, CoyIoVec const *vecs);
+
 typedef struct
 {
     size size_in_bytes;     // size of the file
-    byte const *data; 
+    union
+    {
+        byte const *data; 
+        byte *writable_data;  // only for writable mappings
+    };
+    size offset;            // where data starts in the file, only windows start anywhere but 0
     iptr _internal[2];      // implementation specific data
+    b32 writable;
     b32 valid;              // error indicator
 } CoyMemMappedFile;
 
+/* Mappings of at least COY_MEMMAP_HUGE_PAGE_THRESHOLD bytes ask the OS for transparent huge pages where it supports them. */
+#define COY_MEMMAP_HUGE_PAGE_THRESHOLD COY_MiB(64)
+
 static inline CoyMemMappedFile coy_memmap_read_only(char const *filename);
+
+/* Writable mappings are shared with the file, so writes through writable_data end up in it without any write calls.
+ * coy_memmap_create creates (or truncates) a file of num_bytes bytes, num_bytes must be more than 0. The disk space is
+ * allocated up front where the file system can, so running out of it is an error here instead of a crash later.
+ *
+ * coy_memmap_grow makes the file and the mapping bigger, the mapping may move so don't keep pointers into it across a
+ * call. coy_memmap_flush starts writing a range (num_bytes == 0 means through the end) back to the file, and with wait it
+ * also waits for it to be on disk. Closing unmaps without waiting, the OS still writes everything back eventually.
+ */
+static inline CoyMemMappedFile coy_memmap_create(char const *filename, size num_bytes);
+static inline CoyMemMappedFile coy_memmap_read_write(char const *filename);
+static inline b32 coy_memmap_grow(CoyMemMappedFile *file, size new_size);
+static inline b32 coy_memmap_flush(CoyMemMappedFile const *file, size offset, size num_bytes, b32 wait);
+
 static inline void coy_memmap_close(CoyMemMappedFile *file);
+static inline b32 coy_memmap_lock(CoyMemMappedFile const *file);   /* Fault in and lock in RAM, see coy_memory_lock. */
+static inline b32 coy_memmap_unlock(CoyMemMappedFile const *file);
+static inline b32 coy_memmap_advise(CoyMemMappedFile const *file, CoyAccessHint hint, size offset, size num_bytes); /* See coy_file_advise. */
+
+/* Map num_bytes of a file starting at offset (num_bytes == 0 means through the end), the window has to fit in the file.
+ * The offset doesn't have to be aligned, data points right at it. With populate all of the window is read in before this
+ * returns (MAP_POPULATE on Linux, a WILLNEED hint elsewhere), worth it for small hot files to skip the page faults.
+ * Close windows with coy_memmap_close like any other mapping.
+ */
+static inline CoyMemMappedFile coy_memmap_read_window(char const *filename, size offset, size num_bytes, b32 populate);
+
+/* Slide a read only window of window_size bytes over a file, only two windows are mapped at a time so the file can be
+ * bigger than the address space you want to spend on it. Each window starts window_size - overlap bytes after the one
+ * before it, so anything up to overlap bytes long that straddles the end of a window shows up whole in the next one.
+ *
+ * While you work on one window the next one is already mapped and the OS is reading it in the background. next returns
+ * NULL after the window that reaches the end of the file, or on error (then valid is false). A window is good until the
+ * next call to next or close.
+ */
+typedef struct
+{
+    CoyMemMappedFile window;    // current window, window.offset is where it is in the file
+    CoyMemMappedFile _next;     // mapped ahead of time
+    size file_size;
+    size window_size;
+    size step;
+    size _next_offset;
+    iptr _handle;
+    b32 valid;
+} CoyMemMapWindowIter;
+
+static inline CoyMemMapWindowIter coy_memmap_window_iterator_open(char const *filename, size window_size, size overlap);
+static inline CoyMemMappedFile const *coy_memmap_window_iterator_next(CoyMemMapWindowIter *iter);
+static inline void coy_memmap_window_iterator_close(CoyMemMapWindowIter *iter); /* Must set valid member to false. */
 
 /*---------------------------------------------------------------------------------------------------------------------------
  *                                                File System Interactions
@@ -298,6 +785,12 @@ static inline b32 coy_thread_create(CoyThread *thrd, CoyThreadFunc func, void *t
 static inline b32 coy_thread_join(CoyThread *thread); /* Returns false if there was an error. */
 static inline void coy_thread_destroy(CoyThread *thread);
 
+/* Fault in and lock the next num_bytes of the calling thread's stack (below the caller's frame), so a latency critical
+ * thread never faults on its stack. num_bytes must leave room in the stack for the functions the thread calls later.
+ * Returns false if the pages couldn't be locked, see coy_memory_lock.
+ */
+static inline b32 coy_thread_stack_prefault_lock(size num_bytes);
+
 static inline CoyMutex coy_mutex_create(void);
 static inline b32 coy_mutex_lock(CoyMutex *mutex);    /* Block, return false on failure. */
 static inline b32 coy_mutex_unlock(CoyMutex *mutex);  /* Return false on failure.        */
@@ -341,6 +834,252 @@ static inline void coy_channel_done_receiving(CoyChannel *chan);
 static inline b32 coy_channel_send(CoyChannel *chan, void *data);
 static inline b32 coy_channel_receive(CoyChannel *chan, void **out);
 
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                      Object Pool
+ *---------------------------------------------------------------------------------------------------------------------------
+ * Fixed size object allocator carved out of a CoyMemoryBlock. Allocating and freeing are O(1) using an intrusive free list,
+ * so a freed object must be at least as big as a pointer (object_size is rounded up if needed). The pool is threadsafe, it
+ * is guarded by a mutex. To avoid contention, each thread can keep its own CoyPoolCache, which moves objects to and from the
+ * pool COY_POOL_CACHE_SIZE / 2 at a time. Objects can be freed to a different cache than the one they came from.
+ *
+ * Occupancy counts objects that aren't on the pool's free list, so objects sitting in a cache count as in use until they
+ * are flushed back to the pool.
+ */
+typedef struct
+{
+    byte *buf;
+    size object_size;
+    size capacity;     /* Number of objects that fit in buf.                           */
+    size num_carved;   /* Objects handed out at least once, the rest have never been touched. */
+    void *free_list;
+    size in_use;
+    size high_water;
+    CoyMutex mtx;
+    b32 valid;
+} CoyPool;
+
+typedef struct
+{
+    size capacity;
+    size in_use;
+    size high_water;
+} CoyPoolStats;
+
+#define COY_POOL_CACHE_SIZE 64
+typedef struct
+{
+    CoyPool *pool;
+    i32 count;
+    void *objects[COY_POOL_CACHE_SIZE];
+} CoyPoolCache;
+
+static inline CoyPool coy_pool_create(CoyMemoryBlock *mem, size object_size, size alignment); /* Does NOT own mem. */
+static inline void coy_pool_destroy(CoyPool *pool); /* Must set valid member to false. */
+static inline void *coy_pool_alloc(CoyPool *pool);  /* NULL if the pool is exhausted.  */
+static inline void coy_pool_free(CoyPool *pool, void *object);
+static inline CoyPoolStats coy_pool_stats(CoyPool *pool);
+
+static inline CoyPoolCache coy_pool_cache_create(CoyPool *pool);
+static inline void *coy_pool_cache_alloc(CoyPoolCache *cache); /* NULL if the pool is exhausted. */
+static inline void coy_pool_cache_free(CoyPoolCache *cache, void *object);
+static inline void coy_pool_cache_flush(CoyPoolCache *cache); /* Return all cached objects to the pool. */
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                 Asynchronous File I/O
+ *---------------------------------------------------------------------------------------------------------------------------
+ * Keep many reads and writes at explicit offsets in flight on one file without blocking the calling thread. Queue up
+ * requests, submit them as a batch, and reap the completions later in any order. On Linux this uses io_uring (kernel 5.6+)
+ * through raw syscalls, everywhere else, or if io_uring isn't available, a pool of COY_ASYNC_NUM_WORKERS threads does
+ * blocking positional reads / writes. The using_io_uring member says which one you got.
+ *
+ * At most COY_ASYNC_QUEUE_DEPTH requests can be queued or in flight at once, the queue functions return false when it's
+ * full, so reap some completions first. A single request can't be more than 4 GiB - 1 bytes (UINT32_MAX), bigger ones
+ * fail to queue on every platform. Buffers must stay valid until their request is reaped. A completion's result is
+ * the number of bytes transferred, which is less than requested only at the end of the file, or -1 on error.
+ *
+ * CoyAsyncFile is big, so it's initialized in place. Not thread safe, use it from one thread. Closing waits for everything
+ * in flight to finish.
+ *
+ * COY_ASYNC_FLAG_DIRECT bypasses the OS page cache (O_DIRECT on Linux, F_NOCACHE on Apple, FILE_FLAG_NO_BUFFERING on
+ * Windows), so streaming a huge file once doesn't evict everything else and skips a copy. Then every offset, size, and
+ * buffer address must be a multiple of COY_FILE_DIRECT_ALIGNMENT, memory from coy_memory_allocate is aligned. Reading
+ * the unaligned tail of a file works, the read just comes up short. To write one, write the whole last block padded out
+ * and then trim the file with coy_async_file_set_size. If the file system doesn't do direct I/O the file is opened the
+ * normal way, the direct member says which one you got.
+ */
+#define COY_ASYNC_QUEUE_DEPTH 64
+#define COY_ASYNC_NUM_WORKERS 4
+#define COY_FILE_DIRECT_ALIGNMENT 4096
+
+typedef enum
+{
+    COY_ASYNC_FLAG_WRITE       = 1 << 0, /* Create or truncate the file, and open it for reading AND writing. */
+    COY_ASYNC_FLAG_NO_IO_URING = 1 << 1, /* Always use the thread pool.                                       */
+    COY_ASYNC_FLAG_DIRECT      = 1 << 2, /* Bypass the page cache, see above.                                 */
+} CoyAsyncFlags;
+
+typedef struct
+{
+    void *user_data; /* Whatever was passed in when the request was queued. */
+    size result;
+    b32 is_write;
+} CoyAsyncCompletion;
+
+typedef struct
+{
+    byte *buffer;
+    size offset;
+    size num_bytes;
+    size num_done;   /* io_uring can come up short, the rest is resubmitted. */
+    size result;
+    void *user_data;
+    b32 is_write;
+} CoyAsyncRequest;
+
+typedef struct
+{
+    iptr handle;
+    b32 using_io_uring;
+    b32 direct;
+
+    CoyAsyncRequest requests[COY_ASYNC_QUEUE_DEPTH];
+    i32 free_slots[COY_ASYNC_QUEUE_DEPTH];
+    i32 num_free;
+    i32 queued[COY_ASYNC_QUEUE_DEPTH];
+    i32 num_queued;
+    i32 num_in_flight;
+
+    _Alignas(16) byte uring[256];
+
+    CoyChannel pool_requests;
+    CoyMutex pool_mtx;
+    CoyCondVar pool_done;
+    i32 pool_completed[COY_ASYNC_QUEUE_DEPTH];
+    i32 pool_num_completed;
+    CoyThread pool_workers[COY_ASYNC_NUM_WORKERS];
+    i32 pool_num_workers;
+
+    b32 valid;
+} CoyAsyncFile;
+
+static inline b32 coy_async_file_open(CoyAsyncFile *file, char const *filename, u32 flags); /* CoyAsyncFlags */
+static inline b32 coy_async_file_queue_read(CoyAsyncFile *file, size offset, size num_bytes, byte *buffer, void *user_data);
+static inline b32 coy_async_file_queue_write(CoyAsyncFile *file, size offset, size num_bytes, byte const *buffer, void *user_data);
+/* Returns the number submitted or -1 on error. After an error the requests that were handed off are still in flight and
+ * get reaped as usual, the rest stay queued for the next submit.
+ */
+static inline i32 coy_async_file_submit(CoyAsyncFile *file);
+
+/* Returns the number of completions written to completions, or -1 on error. If wait is true, block until there's at
+ * least one completion, unless nothing is in flight.
+ */
+static inline i32 coy_async_file_reap(CoyAsyncFile *file, i32 max_completions, CoyAsyncCompletion *completions, b32 wait);
+static inline b32 coy_async_file_set_size(CoyAsyncFile *file, size num_bytes); /* Only with nothing in flight. */
+static inline void coy_async_file_close(CoyAsyncFile *file); /* Must set valid member to false. */
+
+/* Sequential scan of a whole file with direct I/O, keeping num_blocks reads of block_size bytes in flight on a
+ * CoyAsyncFile. block_size is rounded up to a multiple of COY_FILE_DIRECT_ALIGNMENT, and num_blocks can't be more than
+ * COY_ASYNC_QUEUE_DEPTH. Blocks come out in file order, every one is block_size bytes except the last. The view from
+ * coy_direct_reader_next is good until the next call, its num_bytes is 0 at the end of the file or -1 on error.
+ */
+typedef struct
+{
+    CoyAsyncFile file;
+    CoyMemoryBlock mem;
+    size block_size;
+    i32 num_blocks;
+    size file_size;
+    size next_read_offset;
+    size next_offset;       /* Offset of the next block handed out. */
+    i32 held;               /* Slot the caller is looking at, or -1. */
+    size results[COY_ASYNC_QUEUE_DEPTH];
+    b32 done[COY_ASYNC_QUEUE_DEPTH];
+    b32 error;
+    b32 valid;
+} CoyDirectReader;
+
+static inline b32 coy_direct_reader_open(CoyDirectReader *reader, char const *filename, size block_size, i32 num_blocks);
+static inline CoyByteView coy_direct_reader_next(CoyDirectReader *reader);
+static inline void coy_direct_reader_close(CoyDirectReader *reader); /* Must set valid member to false. */
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                  Parallel File Reader
+ *---------------------------------------------------------------------------------------------------------------------------
+ * Read one big file with several threads. The file is split into chunks of chunk_size bytes and worker threads read them
+ * concurrently with positional reads. Pull chunks with coy_parallel_reader_next, and hand each one back with
+ * coy_parallel_reader_release when you're done with it. With in_order the chunks come out in file order, otherwise they
+ * come out as soon as they're read. Don't hold on to more than num_threads chunks at once, the workers need buffers too.
+ *
+ * To keep records whole, pass a find_record function. Given bytes starting anywhere in the file, it returns how many bytes
+ * to skip to get to the start of the next record, or -1 if there isn't one in those bytes. E.g. for lines, the offset just
+ * past the first '\n'. Then every chunk starts and ends on a record boundary (the first starts at 0, the last ends at the
+ * end of the file), and a chunk can be longer than chunk_size by up to max_record_size. Records must not be longer than
+ * max_record_size. find_record is called from the worker threads, so it must be thread safe. Chunks with no records in
+ * them are skipped.
+ *
+ * CoyParallelReader is big, so it's initialized in place.
+ */
+#define COY_PARALLEL_READER_MAX_THREADS 32
+#define COY_PARALLEL_READER_MAX_BUFFERS (2 * COY_PARALLEL_READER_MAX_THREADS)
+
+typedef size (*CoyFindRecordFunc)(byte const *data, size num_bytes, void *ctx);
+
+typedef struct
+{
+    byte const *data;
+    size num_bytes;
+    size offset;      /* Position of data[0] in the file. */
+    i64 index;        /* Chunk number, in file order.     */
+    i32 _slot;        /* Internal use.                    */
+    b32 valid;        /* false when there are no more chunks, or on error. */
+} CoyFileChunk;
+
+typedef struct
+{
+    byte *buffer;
+    size start;       /* Where the chunk starts in buffer. */
+    size num_bytes;
+    i64 index;
+    i32 state;
+} CoyParallelReaderSlot;
+
+typedef struct
+{
+    iptr handle;
+    size file_size;
+    size chunk_size;
+    size max_record_size;
+    i64 num_chunks;
+    CoyFindRecordFunc find_record;
+    void *find_record_ctx;
+    b32 in_order;
+
+    CoyMemoryBlock mem;
+    CoyParallelReaderSlot slots[COY_PARALLEL_READER_MAX_BUFFERS];
+    i32 num_slots;
+
+    i64 next_to_read;
+    i64 next_to_deliver; /* Only used in_order. */
+    i64 num_delivered;
+    b32 error;
+    b32 closing;
+
+    CoyMutex mtx;
+    CoyCondVar slot_free;
+    CoyCondVar chunk_ready;
+    CoyThread workers[COY_PARALLEL_READER_MAX_THREADS];
+    i32 num_workers;
+
+    b32 valid;
+} CoyParallelReader;
+
+/* find_record may be NULL, then max_record_size is ignored. */
+static inline b32 coy_parallel_reader_open(CoyParallelReader *reader, char const *filename, size chunk_size, i32 num_threads,
+                                           b32 in_order, CoyFindRecordFunc find_record, size max_record_size, void *ctx);
+static inline CoyFileChunk coy_parallel_reader_next(CoyParallelReader *reader); /* Blocks until a chunk is ready. */
+static inline void coy_parallel_reader_release(CoyParallelReader *reader, CoyFileChunk *chunk);
+static inline b32 coy_parallel_reader_close(CoyParallelReader *reader); /* Returns false if there was a read error. */
+
 /*---------------------------------------------------------------------------------------------------------------------------
  *                                                    Profiling Tools
  *---------------------------------------------------------------------------------------------------------------------------
@@ -405,7 +1144,9 @@ static inline void coy_profile_end(void);
 static inline u64 coy_profile_read_cpu_timer(void);
 static inline u64 coy_profile_estimate_cpu_timer_freq(void);
 
-/* OS Counters (page faults, etc.) */
+/* OS Counters (page faults, etc.) If the OS won't hand out the counters (on Linux that depends on perf_event_paranoid)
+ * coy_global_os_metrics.initialized stays false, check it before reading them.
+ */
 static inline void coy_profile_initialize_os_metrics(void);
 static inline void coy_profile_finalize_os_metrics(void);
 static inline u64 coy_profile_read_os_page_fault_count(void);
@@ -421,6 +1162,77 @@ static inline u64 coy_profile_read_os_page_fault_count(void);
 #else
 #define COY_PROFILE_STATIC_CHECK
 #endif
+
+/*---------------------------------------------------------------------------------------------------------------------------
+ *                                                   Memory Usage Tags
+ *---------------------------------------------------------------------------------------------------------------------------
+ * Macro enabled accounting of which parts of a program own how much memory. Tags are small integers you choose (an enum
+ * works well), 0 to COY_MEMORY_NUM_TAGS - 1. Allocate and free through the _tagged functions with the same tag, and each tag
+ * keeps current and peak committed bytes plus allocation and free counts. A tag that still has allocations outstanding at
+ * the end of the program is leaking.
+ *
+ * Page faults are attributed to a tag two ways. The faults taken while allocating (Linux pre-faults) are counted
+ * automatically. Faults taken later, the first time the memory is touched, are counted between coy_memory_tag_begin and
+ * coy_memory_tag_end. Both need coy_profile_initialize_os_metrics to be called first, and the fault counter is process wide,
+ * so only faults from a single threaded section are attributed accurately. Nested tag sections each count the faults.
+ *
+ * Call coy_memory_tag_report to fill in the summary members of coy_global_memory_tags.tags, like coy_profile_end does for
+ * the profiler. Like the profiler, the counters are global and NOT thread safe, only tag allocations from one thread at a
+ * time. Without COY_MEMORY_TAGS the _tagged functions are just coy_memory_allocate and coy_memory_free.
+ */
+
+#ifndef COY_MEMORY_TAGS
+#define COY_MEMORY_TAGS 0
+#endif
+
+#if COY_MEMORY_TAGS
+#define COY_MEMORY_NUM_TAGS 32
+#else
+#define COY_MEMORY_NUM_TAGS 1
+#endif
+
+typedef struct
+{
+    char const *label;
+
+    size current_bytes;
+    size peak_bytes;
+    u64 allocation_count;
+    u64 free_count;
+    u64 page_faults;
+
+    /* Filled in by coy_memory_tag_report. */
+    u64 live_allocations;
+    f64 current_mib;
+    f64 peak_mib;
+    f64 faults_per_mib; /* Page faults per MiB of peak usage. */
+} CoyMemoryTagStats;
+
+typedef struct
+{
+    CoyMemoryTagStats tags[COY_MEMORY_NUM_TAGS];
+
+    size total_current_bytes;
+    size total_peak_bytes;
+} GlobalMemoryTags;
+
+static GlobalMemoryTags coy_global_memory_tags;
+
+#if COY_MEMORY_TAGS
+typedef struct
+{
+    u64 start_faults;
+    i32 tag;
+} CoyMemoryTagAnchor;
+#else
+typedef u32 CoyMemoryTagAnchor;
+#endif
+
+static inline CoyMemoryBlock coy_memory_allocate_tagged(size minimum_num_bytes, i32 tag, char const *label);
+static inline void coy_memory_free_tagged(CoyMemoryBlock *mem, i32 tag);
+static inline CoyMemoryTagAnchor coy_memory_tag_begin(i32 tag);
+static inline void coy_memory_tag_end(CoyMemoryTagAnchor *anchor);
+static inline void coy_memory_tag_report(void);
 /*---------------------------------------------------------------------------------------------------------------------------
  *
  *
@@ -470,439 +1282,2774 @@ coy_null_term_strings_equal(char const *left, char const *right)
     return true;
 }
 
-static inline b32 
-coy_file_write_f64(CoyFileWriter *file, f64 val)
+static inline void coy_memory_free_lazily(CoyMemoryBlock *mem);
+static inline size coy_memory_allocation_granularity(void); /* What coy_memory_allocate rounds big requests up to. */
+
+static inline size
+coy_memory_cache_class_size(size num_bytes)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    /* Round up to 1, 1.25, 1.5, or 1.75 times a power of 2 so at most 25% is wasted, but always whole pages. */
+    size const page_size = coy_memory_page_size();
+    if(num_bytes < page_size) { num_bytes = page_size; }
+
+    size power = page_size;
+    while(power * 2 <= num_bytes) { power *= 2; }
+
+    size step = power / 4 > page_size ? power / 4 : page_size;
+    size class_size = power;
+    while(class_size < num_bytes) { class_size += step; }
+
+    /* Past the allocation granularity (64 KiB on Windows) blocks come back rounded up to it, so the classes are too.
+     * Then a block's size is always its class and it can go back in the cache.
+     */
+    size const granularity = coy_memory_allocation_granularity();
+    if(class_size > granularity && class_size % granularity)
+    {
+        class_size += granularity - class_size % granularity;
+    }
+
+    return class_size;
 }
 
-static inline b32 
-coy_file_write_i8(CoyFileWriter *file, i8 val)
+static inline CoyMemoryCache
+coy_memory_cache_create(size max_bytes_cached)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    return (CoyMemoryCache){ .count = 0, .bytes_cached = 0, .max_bytes_cached = max_bytes_cached };
 }
 
-static inline b32 
-coy_file_write_i16(CoyFileWriter *file, i16 val)
+static inline void
+coy_memory_cache_destroy(CoyMemoryCache *cache)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    coy_memory_cache_trim(cache, 0);
 }
 
-static inline b32 
-coy_file_write_i32(CoyFileWriter *file, i32 val)
+static inline void
+coy_memory_cache_remove(CoyMemoryCache *cache, i32 idx)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    cache->bytes_cached -= cache->blocks[idx].size;
+    cache->count -= 1;
+    memmove(&cache->blocks[idx], &cache->blocks[idx + 1], (cache->count - idx) * sizeof(cache->blocks[0]));
 }
 
-static inline b32 
-coy_file_write_i64(CoyFileWriter *file, i64 val)
+static inline CoyMemoryBlock
+coy_memory_cache_allocate(CoyMemoryCache *cache, size minimum_num_bytes)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
-}
+    Assert(minimum_num_bytes > 0);
+    size class_size = coy_memory_cache_class_size(minimum_num_bytes);
 
-static inline b32 
-coy_file_write_u8(CoyFileWriter *file, u8 val)
+    /* Newest first, it is the most likely to still be resident. */
+    for(i32 i = cache->count - 1; i >= 0; --i)
+    {
+        if(cache->blocks[i].size == class_size)
+        {
+            CoyMemoryBlock mem = cache->blocks[i];
+            coy_memory_cache_remove(cache, i);
+            cache->hits += 1;
+
+            return mem;
+        }
+    }
+
+    cache->misses += 1;
+    return coy_memory_allocate(class_size);
+}
+
+static inline void
+coy_memory_cache_free(CoyMemoryCache *cache, CoyMemoryBlock *mem)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    StopIf(!mem->valid, return);
+
+    /* Only keep blocks that are exactly a size class and fit in the cache. */
+    if(mem->size != coy_memory_cache_class_size(mem->size) || mem->size > cache->max_bytes_cached ||
+       mem->committed != mem->size)
+    {
+        coy_memory_free(mem);
+        return;
+    }
+
+    /* Make room by evicting the oldest blocks. */
+    coy_memory_cache_trim(cache, cache->max_bytes_cached - mem->size);
+    if(cache->count == COY_MEMORY_CACHE_SLOTS)
+    {
+        CoyMemoryBlock oldest = cache->blocks[0];
+        coy_memory_cache_remove(cache, 0);
+        coy_memory_free(&oldest);
+    }
+
+    coy_memory_free_lazily(mem);
+    cache->blocks[cache->count] = *mem;
+    cache->count += 1;
+    cache->bytes_cached += mem->size;
+
+    mem->valid = false;
 }
 
-static inline b32 
-coy_file_write_u16(CoyFileWriter *file, u16 val)
+static inline void
+coy_memory_cache_trim(CoyMemoryCache *cache, size max_bytes_to_keep)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    while(cache->count > 0 && cache->bytes_cached > max_bytes_to_keep)
+    {
+        CoyMemoryBlock oldest = cache->blocks[0];
+        coy_memory_cache_remove(cache, 0);
+        coy_memory_free(&oldest);
+    }
 }
 
-static inline b32 
-coy_file_write_u32(CoyFileWriter *file, u32 val)
+static inline CoyArena
+coy_arena_create(size minimum_num_bytes)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    CoyMemoryBlock mem = coy_memory_allocate(minimum_num_bytes);
+    StopIf(!mem.valid, goto ERR_RETURN);
+
+    return (CoyArena){ .buf = mem.mem, .buf_size = mem.size, .offset = 0, .mem = mem, .valid = true };
+
+ERR_RETURN:
+    return (CoyArena){ .valid = false };
 }
 
-static inline b32 
-coy_file_write_u64(CoyFileWriter *file, u64 val)
+static inline CoyArena
+coy_arena_create_reserved(size maximum_num_bytes)
 {
-    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
-    if(nbytes != sizeof(val)) { return false; }
-    return true;
+    CoyMemoryBlock mem = coy_memory_reserve(maximum_num_bytes);
+    StopIf(!mem.valid, goto ERR_RETURN);
+
+    return (CoyArena){ .buf = mem.mem, .buf_size = mem.size, .offset = 0, .mem = mem, .valid = true };
+
+ERR_RETURN:
+    return (CoyArena){ .valid = false };
 }
 
-static inline b32 
-coy_file_write_str(CoyFileWriter *file, size len, char *str)
+static inline CoyArena
+coy_arena_create_from_buffer(size buf_size, byte *buffer)
 {
-    _Static_assert(sizeof(size) == sizeof(i64), "must not be on 64 bit!");
-    b32 success = coy_file_write_i64(file, len);
-    StopIf(!success, return false);
-    if(len > 0)
+    StopIf(!buffer || buf_size <= 0, return (CoyArena){ .valid = false });
+    return (CoyArena){ .buf = buffer, .buf_size = buf_size, .offset = 0, .mem = {0}, .valid = true };
+}
+
+static inline void
+coy_arena_destroy(CoyArena *arena)
+{
+    if(arena->mem.valid)
     {
-        size nbytes = coy_file_write(file, len, (byte *)str);
-        if(nbytes != len) { return false; }
+        coy_memory_free(&arena->mem);
     }
-    return true;
+
+    *arena = (CoyArena){ .valid = false };
 }
 
-static inline b32 
-coy_file_read_f64(CoyFileReader *file, f64 *val)
+static inline void *
+coy_arena_push(CoyArena *arena, size num_bytes, size alignment)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    Assert(num_bytes >= 0);
+    Assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    StopIf(!arena->valid, return NULL);
+
+    uptr ptr = (uptr)(arena->buf + arena->offset);
+    size padding = (size)(-ptr & (uptr)(alignment - 1));
+
+    StopIf(num_bytes > arena->buf_size - arena->offset - padding, return NULL);
+
+    size new_offset = arena->offset + padding + num_bytes;
+    if(arena->mem.valid && new_offset > arena->mem.committed)
+    {
+        /* Reserved arena, commit enough to cover this push. */
+        size commit_size = new_offset - arena->mem.committed;
+        commit_size += COY_ARENA_COMMIT_SIZE - 1;
+        commit_size -= commit_size % COY_ARENA_COMMIT_SIZE;
+        if(commit_size > arena->mem.size - arena->mem.committed)
+        {
+            commit_size = arena->mem.size - arena->mem.committed;
+        }
+
+        b32 success = coy_memory_commit(&arena->mem, arena->mem.committed, commit_size);
+        StopIf(!success, return NULL);
+    }
+
+    void *result = arena->buf + arena->offset + padding;
+    arena->offset = new_offset;
+
+    return result;
 }
 
-static inline b32 
-coy_file_read_i8(CoyFileReader *file, i8 *val)
+static inline void *
+coy_arena_push_zero(CoyArena *arena, size num_bytes, size alignment)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    void *result = coy_arena_push(arena, num_bytes, alignment);
+    if(result)
+    {
+        memset(result, 0, num_bytes);
+    }
+
+    return result;
 }
 
-static inline b32 
-coy_file_read_i16(CoyFileReader *file, i16 *val)
+static inline void
+coy_arena_reset(CoyArena *arena)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    arena->offset = 0;
 }
 
-static inline b32 
-coy_file_read_i32(CoyFileReader *file, i32 *val)
+static inline size
+coy_arena_bytes_remaining(CoyArena const *arena)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    return arena->buf_size - arena->offset;
 }
 
-static inline b32 
-coy_file_read_i64(CoyFileReader *file, i64 *val)
+static inline CoyArenaMarker
+coy_arena_save(CoyArena *arena)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    return (CoyArenaMarker){ .arena = arena, .offset = arena->offset };
 }
 
-static inline b32 
-coy_file_read_u8(CoyFileReader *file, u8 *val)
+static inline void
+coy_arena_restore(CoyArenaMarker marker)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    Assert(marker.offset <= marker.arena->offset);
+    marker.arena->offset = marker.offset;
 }
 
-static inline b32 
-coy_file_read_u16(CoyFileReader *file, u16 *val)
+static inline CoyVec
+coy_vec_create(size elem_size, size max_elements)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    Assert(elem_size > 0 && max_elements > 0);
+    StopIf(max_elements > INTPTR_MAX / elem_size, goto ERR_RETURN);
+
+    CoyMemoryBlock mem = coy_memory_reserve(elem_size * max_elements);
+    StopIf(!mem.valid, goto ERR_RETURN);
+
+    return (CoyVec)
+        {
+            .data = mem.mem,
+            .elem_size = elem_size,
+            .len = 0,
+            .capacity = 0,
+            .max_len = mem.size / elem_size,
+            .mem = mem,
+            .valid = true
+        };
+
+ERR_RETURN:
+    return (CoyVec){ .valid = false };
 }
 
-static inline b32 
-coy_file_read_u32(CoyFileReader *file, u32 *val)
+static inline void
+coy_vec_destroy(CoyVec *vec)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
-    return true;
+    if(vec->mem.valid)
+    {
+        coy_memory_free(&vec->mem);
+    }
+
+    *vec = (CoyVec){ .valid = false };
 }
 
-static inline b32 
-coy_file_read_u64(CoyFileReader *file, u64 *val)
+static inline b32
+coy_vec_reserve(CoyVec *vec, size num_elements)
 {
-    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
-    if(nbytes != sizeof(*val)) { return false; }
+    StopIf(!vec->valid || num_elements > vec->max_len, return false);
+    if(num_elements <= vec->capacity) { return true; }
+
+    /* Grow geometrically so pushing one at a time doesn't make a system call every page. */
+    size new_capacity = vec->capacity * 2;
+    if(new_capacity < num_elements) { new_capacity = num_elements; }
+    if(new_capacity > vec->max_len) { new_capacity = vec->max_len; }
+
+    size committed = vec->mem.committed;
+    b32 success = coy_memory_commit(&vec->mem, committed, new_capacity * vec->elem_size - committed);
+    StopIf(!success, return false);
+
+    vec->capacity = vec->mem.committed / vec->elem_size;
+
     return true;
 }
 
-static inline b32 
-coy_file_read_str(CoyFileReader *file, size *len, char *str)
+static inline void *
+coy_vec_extend(CoyVec *vec, size num_elements)
 {
-    i64 str_len = 0;
-    b32 success = coy_file_read_i64(file, &str_len);
-    StopIf(!success || str_len > *len, return false);
+    Assert(num_elements >= 0);
+    StopIf(!vec->valid || num_elements > vec->max_len - vec->len, return NULL);
 
-    if(str_len > 0)
+    b32 success = coy_vec_reserve(vec, vec->len + num_elements);
+    StopIf(!success, return NULL);
+
+    void *first = vec->data + vec->len * vec->elem_size;
+    vec->len += num_elements;
+
+    return first;
+}
+
+static inline void *
+coy_vec_push(CoyVec *vec, void const *elem)
+{
+    void *dest = coy_vec_extend(vec, 1);
+    if(dest)
     {
-        success = coy_file_read(file, str_len, (byte *)str) > 0;
-        StopIf(!success, return false);
+        memcpy(dest, elem, vec->elem_size);
     }
-    else
+
+    return dest;
+}
+
+static inline void
+coy_vec_truncate(CoyVec *vec, size len)
+{
+    Assert(len >= 0);
+    if(len < vec->len)
     {
-        /* Clear the provided buffer. */
-        memset(str, 0, *len);
+        vec->len = len;
     }
-
-    *len = str_len;
-    return true;
 }
 
-static inline CoyChannel 
-coy_channel_create(void)
+static COY_THREAD_LOCAL CoyArena coy_scratch_arenas[COY_SCRATCH_NUM_ARENAS];
+
+static inline CoyArenaMarker
+coy_scratch_begin(i32 num_conflicts, CoyArena *const *conflicts)
 {
-    CoyChannel chan = 
+    for(i32 i = 0; i < COY_SCRATCH_NUM_ARENAS; ++i)
+    {
+        CoyArena *scratch = &coy_scratch_arenas[i];
+
+        b32 conflicted = false;
+        for(i32 j = 0; j < num_conflicts; ++j)
         {
-            .head = 0,
-            .tail = 0,
-            .count = 0,
-            .mtx = coy_mutex_create(),
-            .space_available = coy_condvar_create(),
-            .data_available = coy_condvar_create(),
-            .num_producers_started = 0,
-            .num_producers_finished = 0,
-            .num_consumers_started = 0,
-            .num_consumers_finished = 0,
-            .buf = {0},
-        };
+            if(conflicts[j] == scratch)
+            {
+                conflicted = true;
+                break;
+            }
+        }
 
-    Assert(chan.mtx.valid);
-    Assert(chan.space_available.valid);
-    Assert(chan.data_available.valid);
+        if(!conflicted)
+        {
+            if(!scratch->valid)
+            {
+                *scratch = coy_arena_create_reserved(COY_SCRATCH_SIZE);
+                StopIf(!scratch->valid, break);
+            }
 
-    return chan;
+            return coy_arena_save(scratch);
+        }
+    }
+
+    return (CoyArenaMarker){ .arena = NULL, .offset = 0 };
 }
 
-static inline void 
-coy_channel_destroy(CoyChannel *chan, void(*free_func)(void *ptr, void *ctx), void *free_ctx)
+static inline void
+coy_scratch_end(CoyArenaMarker scratch)
 {
-    Assert(chan->num_producers_started == chan->num_producers_finished);
-    Assert(chan->num_consumers_started == chan->num_consumers_finished);
-    if(free_func)
+    if(scratch.arena)
     {
-        while(chan->count > 0)
+        coy_arena_restore(scratch);
+    }
+}
+
+static inline void
+coy_scratch_release(void)
+{
+    for(i32 i = 0; i < COY_SCRATCH_NUM_ARENAS; ++i)
+    {
+        if(coy_scratch_arenas[i].valid)
         {
-            free_func(chan->buf[chan->head % COYOTE_CHANNEL_SIZE], free_ctx);
-            chan->head += 1;
-            chan->count -= 1;
+            coy_arena_destroy(&coy_scratch_arenas[i]);
         }
-
-        Assert(chan->head == chan->tail && chan->count == 0);
     }
+}
 
-    coy_mutex_destroy(&chan->mtx);
-    coy_condvar_destroy(&chan->space_available);
-    coy_condvar_destroy(&chan->data_available);
-    *chan = (CoyChannel){0};
+static inline size
+coy_ring_buffer_bytes(CoyRingBuffer const *ring)
+{
+    return ring->num_bytes;
 }
 
-static inline void 
-coy_channel_wait_until_ready_to_receive(CoyChannel *chan)
+static inline size
+coy_ring_buffer_space(CoyRingBuffer const *ring)
 {
-    b32 success = coy_mutex_lock(&chan->mtx);
-    Assert(success);
+    return ring->capacity - ring->num_bytes;
+}
 
-    while(chan->num_producers_started == 0) 
-    {
-        coy_condvar_sleep(&chan->data_available, &chan->mtx); 
-    }
+static inline byte *
+coy_ring_buffer_read_ptr(CoyRingBuffer *ring)
+{
+    return ring->buf + ring->read_offset;
+}
 
-    success = coy_mutex_unlock(&chan->mtx);
-    Assert(success);
+static inline byte *
+coy_ring_buffer_write_ptr(CoyRingBuffer *ring)
+{
+    /* Might be in the second mapping, that's the point. */
+    return ring->buf + ring->read_offset + ring->num_bytes;
 }
 
-static inline void 
-coy_channel_wait_until_ready_to_send(CoyChannel *chan)
+static inline void
+coy_ring_buffer_produce(CoyRingBuffer *ring, size num_bytes)
 {
-    b32 success = coy_mutex_lock(&chan->mtx);
-    Assert(success);
-    while(chan->num_consumers_started == 0) { coy_condvar_sleep(&chan->space_available, &chan->mtx); }
-    success = coy_mutex_unlock(&chan->mtx);
-    Assert(success);
+    Assert(num_bytes >= 0 && num_bytes <= coy_ring_buffer_space(ring));
+    ring->num_bytes += num_bytes;
+}
+
+static inline void
+coy_ring_buffer_consume(CoyRingBuffer *ring, size num_bytes)
+{
+    Assert(num_bytes >= 0 && num_bytes <= ring->num_bytes);
+    ring->num_bytes -= num_bytes;
+    ring->read_offset += num_bytes;
+    if(ring->read_offset >= ring->capacity) { ring->read_offset -= ring->capacity; }
+}
+
+static inline CoyFileReader
+coy_file_open_read(char const *filename)
+{
+    CoyFileReader file = { .handle = -1, .valid = false };
+    CoyMemoryBlock mem = coy_memory_allocate(COY_FILE_READER_BUF_SIZE);
+    StopIf(!mem.valid, return file);
+
+    file = coy_file_open_read_with_buffer(filename, mem.size, mem.mem);
+    if(file.valid) { file.buffer_mem = mem; }
+    else { coy_memory_free(&mem); }
+
+    return file;
+}
+
+static inline b32
+coy_file_set_streaming(CoyFileReader *file, b32 streaming)
+{
+    StopIf(!file->valid, return false);
+    file->streaming = streaming;
+    return coy_file_advise(file, streaming ? COY_ACCESS_SEQUENTIAL : COY_ACCESS_NORMAL, 0, 0);
+}
+
+static inline CoyFileWriter
+coy_file_create(char const *filename)
+{
+    CoyFileWriter file = { .handle = -1, .valid = false };
+    CoyMemoryBlock mem = coy_memory_allocate(COY_FILE_WRITER_BUF_SIZE);
+    StopIf(!mem.valid, return file);
+
+    file = coy_file_create_with_buffer(filename, mem.size, mem.mem);
+    if(file.valid) { file.buffer_mem = mem; }
+    else { coy_memory_free(&mem); }
+
+    return file;
+}
+
+static inline CoyFileWriter
+coy_file_append(char const *filename)
+{
+    CoyFileWriter file = { .handle = -1, .valid = false };
+    CoyMemoryBlock mem = coy_memory_allocate(COY_FILE_WRITER_BUF_SIZE);
+    StopIf(!mem.valid, return file);
+
+    file = coy_file_append_with_buffer(filename, mem.size, mem.mem);
+    if(file.valid) { file.buffer_mem = mem; }
+    else { coy_memory_free(&mem); }
+
+    return file;
+}
+
+struct CoyFileWriterBackground
+{
+    iptr handle;
+    byte *buffers[COY_FILE_WRITER_MAX_BACKGROUND_BUFFERS];
+    size lengths[COY_FILE_WRITER_MAX_BACKGROUND_BUFFERS];
+    i32 num_buffers;
+    i32 head;       /* Oldest buffer waiting to be written.                          */
+    i32 num_queued; /* Buffers waiting to be written, including the one being written. */
+    b32 error;
+    b32 done;
+    CoyMutex mtx;
+    CoyCondVar buffer_free;
+    CoyCondVar buffer_queued;
+    CoyThread thread;
+};
+
+static inline size coy_file_write_all(iptr handle, size num_bytes, byte const *buffer); /* -1 on error */
+
+static inline void
+coy_file_writer_background_thread(void *data)
+{
+    struct CoyFileWriterBackground *bg = data;
+
+    b32 success = coy_mutex_lock(&bg->mtx);
+    Assert(success);
+
+    while(true)
+    {
+        while(bg->num_queued == 0 && !bg->done)
+        {
+            success = coy_condvar_sleep(&bg->buffer_queued, &bg->mtx);
+            Assert(success);
+        }
+        if(bg->num_queued == 0) { break; }
+
+        byte const *buffer = bg->buffers[bg->head];
+        size num_bytes = bg->lengths[bg->head];
+        b32 skip = bg->error;
+
+        success = coy_mutex_unlock(&bg->mtx);
+        Assert(success);
+
+        /* After an error keep emptying the queue so the writer never gets stuck, but don't write anything out of order. */
+        b32 written = skip || coy_file_write_all(bg->handle, num_bytes, buffer) == num_bytes;
+
+        success = coy_mutex_lock(&bg->mtx);
+        Assert(success);
+
+        if(!written) { bg->error = true; }
+        bg->head = (bg->head + 1) % bg->num_buffers;
+        bg->num_queued--;
+        success = coy_condvar_wake(&bg->buffer_free);
+        Assert(success);
+    }
+
+    success = coy_mutex_unlock(&bg->mtx);
+    Assert(success);
+}
+
+static inline CoyFileWriter
+coy_file_open_background(char const *filename, size buf_size, i32 num_buffers, b32 append)
+{
+    Assert(buf_size > 0);
+    Assert(num_buffers >= 2 && num_buffers <= COY_FILE_WRITER_MAX_BACKGROUND_BUFFERS);
+
+    /* One block for the bookkeeping and all the buffers, the writer frees it on close. */
+    size header_size = (sizeof(struct CoyFileWriterBackground) + 63) & ~63;
+    CoyMemoryBlock mem = coy_memory_allocate(header_size + num_buffers * buf_size);
+    StopIf(!mem.valid, goto ERR_RETURN);
+
+    struct CoyFileWriterBackground *bg = mem.mem;
+    *bg = (struct CoyFileWriterBackground){ .num_buffers = num_buffers };
+    for(i32 i = 0; i < num_buffers; ++i) { bg->buffers[i] = (byte *)mem.mem + header_size + i * buf_size; }
+
+    CoyFileWriter file = append ? coy_file_append_with_buffer(filename, buf_size, bg->buffers[0])
+                                : coy_file_create_with_buffer(filename, buf_size, bg->buffers[0]);
+    StopIf(!file.valid, goto ERR_FREE);
+
+    bg->handle = file.handle;
+    bg->mtx = coy_mutex_create();
+    bg->buffer_free = coy_condvar_create();
+    bg->buffer_queued = coy_condvar_create();
+    StopIf(!bg->mtx.valid || !bg->buffer_free.valid || !bg->buffer_queued.valid, goto ERR_CLOSE);
+    StopIf(!coy_thread_create(&bg->thread, coy_file_writer_background_thread, bg), goto ERR_CLOSE);
+
+    file.buffer_mem = mem;
+    file.background = bg;
+    return file;
+
+ERR_CLOSE:
+    coy_mutex_destroy(&bg->mtx);
+    coy_condvar_destroy(&bg->buffer_free);
+    coy_condvar_destroy(&bg->buffer_queued);
+    coy_file_writer_close(&file);
+ERR_FREE:
+    coy_memory_free(&mem);
+ERR_RETURN:
+    return (CoyFileWriter){ .handle = -1, .valid = false };
+}
+
+static inline CoyFileWriter
+coy_file_create_background(char const *filename, size buf_size, i32 num_buffers)
+{
+    return coy_file_open_background(filename, buf_size, num_buffers, false);
+}
+
+static inline CoyFileWriter
+coy_file_append_background(char const *filename, size buf_size, i32 num_buffers)
+{
+    return coy_file_open_background(filename, buf_size, num_buffers, true);
+}
+
+static inline size
+coy_file_writer_flush_background(CoyFileWriter *file)
+{
+    struct CoyFileWriterBackground *bg = file->background;
+
+    b32 success = coy_mutex_lock(&bg->mtx);
+    Assert(success);
+
+    b32 error = bg->error;
+    size num_bytes_handed_over = file->buf_cursor;
+    if(!error && file->buf_cursor > 0)
+    {
+        i32 filled = (bg->head + bg->num_queued) % bg->num_buffers;
+        Assert(bg->buffers[filled] == file->buffer);
+        bg->lengths[filled] = file->buf_cursor;
+        bg->num_queued++;
+        success = coy_condvar_wake(&bg->buffer_queued);
+        Assert(success);
+
+        /* Back pressure, wait until there's a free buffer to carry on in. */
+        while(bg->num_queued == bg->num_buffers)
+        {
+            success = coy_condvar_sleep(&bg->buffer_free, &bg->mtx);
+            Assert(success);
+        }
+
+        file->buffer = bg->buffers[(bg->head + bg->num_queued) % bg->num_buffers];
+        file->buf_cursor = 0;
+    }
+
+    success = coy_mutex_unlock(&bg->mtx);
+    Assert(success);
+
+    return error ? -1 : num_bytes_handed_over;
+}
+
+static inline size
+coy_file_write_background(CoyFileWriter *file, size nbytes_to_write, byte const *buffer)
+{
+    /* Big writes can't skip the buffers like they do normally, they'd pass the queued data on the way to the file. */
+    size total_num_bytes_written = 0;
+    while(total_num_bytes_written < nbytes_to_write)
+    {
+        if(file->buf_cursor == file->buf_size)
+        {
+            StopIf(coy_file_writer_flush_background(file) < 0, return -1);
+        }
+
+        size space_available = file->buf_size - file->buf_cursor;
+        size remaining = nbytes_to_write - total_num_bytes_written;
+        size size_to_copy = remaining > space_available ? space_available : remaining;
+        memcpy(file->buffer + file->buf_cursor, buffer + total_num_bytes_written, size_to_copy);
+        file->buf_cursor += size_to_copy;
+        total_num_bytes_written += size_to_copy;
+    }
+
+    return total_num_bytes_written;
+}
+
+static inline b32
+coy_file_writer_finish_background(CoyFileWriter *file)
+{
+    /* Wait for the I/O thread to write everything that was handed over. */
+    struct CoyFileWriterBackground *bg = file->background;
+
+    b32 success = coy_mutex_lock(&bg->mtx);
+    Assert(success);
+    bg->done = true;
+    success = coy_condvar_wake_all(&bg->buffer_queued);
+    Assert(success);
+    success = coy_mutex_unlock(&bg->mtx);
+    Assert(success);
+
+    success = coy_thread_join(&bg->thread);
+    Assert(success);
+    coy_thread_destroy(&bg->thread);
+    coy_mutex_destroy(&bg->mtx);
+    coy_condvar_destroy(&bg->buffer_free);
+    coy_condvar_destroy(&bg->buffer_queued);
+
+    file->background = NULL;
+    return !bg->error;
+}
+
+static inline CoyFileReader
+coy_file_open_read_ring(char const *filename, size ring_capacity)
+{
+    /* The ring is the buffer. */
+    CoyFileReader file = coy_file_open_read_with_buffer(filename, 0, NULL);
+    StopIf(!file.valid, return file);
+
+    file.ring = coy_ring_buffer_create(ring_capacity);
+    if(!file.ring.valid)
+    {
+        coy_file_reader_close(&file);
+    }
+
+    return file;
+}
+
+static inline size coy_file_fill_buffer(CoyFileReader *file);
+
+static inline CoyByteView
+coy_file_peek(CoyFileReader *file, size min_bytes)
+{
+    Assert(min_bytes >= 0);
+    StopIf(!file->valid, goto ERR_RETURN);
+
+    if(file->ring.valid)
+    {
+        Assert(min_bytes <= file->ring.capacity);
+        if(coy_ring_buffer_bytes(&file->ring) < min_bytes)
+        {
+            size bytes_read = coy_file_fill_buffer(file);
+            StopIf(bytes_read < 0, goto ERR_RETURN);
+        }
+
+        return (CoyByteView){ .data = coy_ring_buffer_read_ptr(&file->ring), .num_bytes = coy_ring_buffer_bytes(&file->ring) };
+    }
+
+    Assert(min_bytes <= file->buf_size);
+    while(file->bytes_remaining < min_bytes)
+    {
+        size bytes_read = coy_file_fill_buffer(file);
+        StopIf(bytes_read < 0, goto ERR_RETURN);
+        if(bytes_read == 0) { break; }
+    }
+
+    return (CoyByteView){ .data = file->buffer + file->buf_cursor, .num_bytes = file->bytes_remaining };
+
+ERR_RETURN:
+    return (CoyByteView){ .data = NULL, .num_bytes = -1 };
+}
+
+static inline void
+coy_file_consume(CoyFileReader *file, size num_bytes)
+{
+    if(file->ring.valid)
+    {
+        coy_ring_buffer_consume(&file->ring, num_bytes);
+        return;
+    }
+
+    Assert(num_bytes >= 0 && num_bytes <= file->bytes_remaining);
+    file->buf_cursor += num_bytes;
+    file->bytes_remaining -= num_bytes;
+}
+
+static inline b32 
+coy_file_write_f64(CoyFileWriter *file, f64 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_i8(CoyFileWriter *file, i8 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_i16(CoyFileWriter *file, i16 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_i32(CoyFileWriter *file, i32 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_i64(CoyFileWriter *file, i64 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_u8(CoyFileWriter *file, u8 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_u16(CoyFileWriter *file, u16 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_u32(CoyFileWriter *file, u32 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_u64(CoyFileWriter *file, u64 val)
+{
+    size nbytes = coy_file_write(file, sizeof(val), (byte *)&val);
+    if(nbytes != sizeof(val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_write_str(CoyFileWriter *file, size len, char *str)
+{
+    _Static_assert(sizeof(size) == sizeof(i64), "must not be on 64 bit!");
+    b32 success = coy_file_write_i64(file, len);
+    StopIf(!success, return false);
+    if(len > 0)
+    {
+        size nbytes = coy_file_write(file, len, (byte *)str);
+        if(nbytes != len) { return false; }
+    }
+    return true;
+}
+
+static inline b32 
+coy_file_read_f64(CoyFileReader *file, f64 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_i8(CoyFileReader *file, i8 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_i16(CoyFileReader *file, i16 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_i32(CoyFileReader *file, i32 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_i64(CoyFileReader *file, i64 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_u8(CoyFileReader *file, u8 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_u16(CoyFileReader *file, u16 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_u32(CoyFileReader *file, u32 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_u64(CoyFileReader *file, u64 *val)
+{
+    size nbytes = coy_file_read(file, sizeof(*val), (byte *)val);
+    if(nbytes != sizeof(*val)) { return false; }
+    return true;
+}
+
+static inline b32 
+coy_file_read_str(CoyFileReader *file, size *len, char *str)
+{
+    i64 str_len = 0;
+    b32 success = coy_file_read_i64(file, &str_len);
+    StopIf(!success || str_len > *len, return false);
+
+    if(str_len > 0)
+    {
+        success = coy_file_read(file, str_len, (byte *)str) > 0;
+        StopIf(!success, return false);
+    }
+    else
+    {
+        /* Clear the provided buffer. */
+        memset(str, 0, *len);
+    }
+
+    *len = str_len;
+    return true;
+}
+
+static inline b32
+coy_byte_order_swaps(CoyByteOrder order)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return order == COY_BYTE_ORDER_LITTLE;
+#else
+    /* Windows is little endian everywhere it runs. */
+    return order == COY_BYTE_ORDER_BIG;
+#endif
+}
+
+#if COY_HAVE_SSSE3
+static inline b32
+coy_cpu_has_ssse3(void)
+{
+#if defined(_MSC_VER)
+    /* cpuid is slow (it traps in some VMs), ask once. Racing threads all store the same answer. */
+    static i32 has_ssse3 = -1;
+    if(has_ssse3 < 0)
+    {
+        int info[4] = {0};
+        __cpuid(info, 1);
+        has_ssse3 = (info[2] >> 9) & 1;
+    }
+    return has_ssse3;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+/* Reverses whole 16 byte blocks with one pshufb each, returns how many values it did. */
+static inline size COY_TARGET_SSSE3
+coy_byte_swap_copy_ssse3(size count, size elem_size, byte const *src, byte *dest)
+{
+    /* Each output byte picks the mirror image byte from the same element. */
+    u8 mask_bytes[16];
+    for(i32 i = 0; i < 16; ++i) { mask_bytes[i] = (u8)(i - i % elem_size + elem_size - 1 - i % elem_size); }
+    __m128i mask = _mm_loadu_si128((__m128i const *)mask_bytes);
+
+    size num_blocks = count * elem_size / 16;
+    for(size i = 0; i < num_blocks; ++i)
+    {
+        __m128i v = _mm_loadu_si128((__m128i const *)(src + i * 16));
+        _mm_storeu_si128((__m128i *)(dest + i * 16), _mm_shuffle_epi8(v, mask));
+    }
+
+    return num_blocks * 16 / elem_size;
+}
+#endif
+
+/* Copy count values of elem_size bytes reversing the bytes in each, src and dest can be the same. On x86-64 CPUs with
+ * SSSE3, checked at run time, it reverses 16 bytes at a time with one pshufb. The byte loops handle the tail and every
+ * other machine, compilers often vectorize them at higher optimization levels but there's no guarantee.
+ */
+static inline void
+coy_byte_swap_copy(size count, size elem_size, byte const *src, byte *dest)
+{
+#if COY_HAVE_SSSE3
+    if((elem_size == 2 || elem_size == 4 || elem_size == 8) && coy_cpu_has_ssse3())
+    {
+        size num_done = coy_byte_swap_copy_ssse3(count, elem_size, src, dest);
+        count -= num_done;
+        src += num_done * elem_size;
+        dest += num_done * elem_size;
+    }
+#endif
+
+    switch(elem_size)
+    {
+        case 2:
+        {
+            for(size i = 0; i < count; ++i)
+            {
+                byte v[2];
+                for(i32 j = 0; j < 2; ++j) { v[j] = src[i * 2 + j]; }
+                for(i32 j = 0; j < 2; ++j) { dest[i * 2 + j] = v[1 - j]; }
+            }
+        } break;
+
+        case 4:
+        {
+            for(size i = 0; i < count; ++i)
+            {
+                byte v[4];
+                for(i32 j = 0; j < 4; ++j) { v[j] = src[i * 4 + j]; }
+                for(i32 j = 0; j < 4; ++j) { dest[i * 4 + j] = v[3 - j]; }
+            }
+        } break;
+
+        case 8:
+        {
+            for(size i = 0; i < count; ++i)
+            {
+                byte v[8];
+                for(i32 j = 0; j < 8; ++j) { v[j] = src[i * 8 + j]; }
+                for(i32 j = 0; j < 8; ++j) { dest[i * 8 + j] = v[7 - j]; }
+            }
+        } break;
+
+        default: Assert(false); /* Single bytes never need swapping. */
+    }
+}
+
+static inline size
+coy_file_read_array(CoyFileReader *file, size count, size elem_size, byte *vals, CoyByteOrder order)
+{
+    Assert(count >= 0);
+    size num_bytes = count * elem_size;
+
+    /* coy_file_read reads big requests straight into vals. */
+    size total_num_bytes_read = 0;
+    while(total_num_bytes_read < num_bytes)
+    {
+        size num_bytes_read = coy_file_read(file, num_bytes - total_num_bytes_read, vals + total_num_bytes_read);
+        StopIf(num_bytes_read < 0, return -1);
+        if(num_bytes_read == 0) { break; } /* End of file. */
+
+        total_num_bytes_read += num_bytes_read;
+    }
+
+    /* A value cut off by the end of the file doesn't count. */
+    size num_read = total_num_bytes_read / elem_size;
+    if(elem_size > 1 && coy_byte_order_swaps(order))
+    {
+        coy_byte_swap_copy(num_read, elem_size, vals, vals);
+    }
+
+    return num_read;
+}
+
+static inline b32
+coy_file_write_array(CoyFileWriter *file, size count, size elem_size, byte const *vals, CoyByteOrder order)
+{
+    Assert(count >= 0);
+    size num_bytes = count * elem_size;
+    if(num_bytes == 0) { return true; }
+
+    if(elem_size == 1 || !coy_byte_order_swaps(order))
+    {
+        /* coy_file_write skips the buffer for big writes. */
+        return coy_file_write(file, num_bytes, vals) == num_bytes;
+    }
+
+    StopIf(!file->valid || file->buf_size < elem_size, return false);
+
+    /* Swap straight into the buffer instead of a temporary copy, a buffer full at a time. */
+    size num_written = 0;
+    while(num_written < count)
+    {
+        size space_available = (file->buf_size - file->buf_cursor) / elem_size;
+        if(space_available == 0)
+        {
+            StopIf(coy_file_writer_flush(file) < 0, return false);
+            continue;
+        }
+
+        size remaining = count - num_written;
+        size num_to_copy = remaining > space_available ? space_available : remaining;
+        coy_byte_swap_copy(num_to_copy, elem_size, vals + num_written * elem_size, file->buffer + file->buf_cursor);
+        file->buf_cursor += num_to_copy * elem_size;
+        num_written += num_to_copy;
+    }
+
+    return true;
+}
+
+static inline size
+coy_file_read_f64_array(CoyFileReader *file, size count, f64 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_i8_array(CoyFileReader *file, size count, i8 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_i16_array(CoyFileReader *file, size count, i16 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_i32_array(CoyFileReader *file, size count, i32 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_i64_array(CoyFileReader *file, size count, i64 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_u8_array(CoyFileReader *file, size count, u8 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_u16_array(CoyFileReader *file, size count, u16 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_u32_array(CoyFileReader *file, size count, u32 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline size
+coy_file_read_u64_array(CoyFileReader *file, size count, u64 *vals, CoyByteOrder order)
+{
+    return coy_file_read_array(file, count, sizeof(*vals), (byte *)vals, order);
+}
+
+static inline b32
+coy_file_write_f64_array(CoyFileWriter *file, size count, f64 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_i8_array(CoyFileWriter *file, size count, i8 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_i16_array(CoyFileWriter *file, size count, i16 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_i32_array(CoyFileWriter *file, size count, i32 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_i64_array(CoyFileWriter *file, size count, i64 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_u8_array(CoyFileWriter *file, size count, u8 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_u16_array(CoyFileWriter *file, size count, u16 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_u32_array(CoyFileWriter *file, size count, u32 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline b32
+coy_file_write_u64_array(CoyFileWriter *file, size count, u64 const *vals, CoyByteOrder order)
+{
+    return coy_file_write_array(file, count, sizeof(*vals), (byte const *)vals, order);
+}
+
+static inline u64
+coy_zigzag_encode(u64 val)
+{
+    /* Sign bit to the bottom, in unsigned math so there's no overflow. */
+    return (val << 1) ^ (0 - (val >> 63));
+}
+
+static inline u64
+coy_zigzag_decode(u64 val)
+{
+    return (val >> 1) ^ (0 - (val & 1));
+}
+
+static inline size
+coy_varint_encode(u64 val, byte *out)
+{
+    size num_bytes = 0;
+    while(val >= 0x80)
+    {
+        out[num_bytes++] = (byte)((val & 0x7F) | 0x80);
+        val >>= 7;
+    }
+    out[num_bytes++] = (byte)val;
+
+    return num_bytes;
+}
+
+/* Returns the number of bytes used, 0 if data ends in the middle of the value, or -1 if it's malformed. */
+static inline size
+coy_varint_decode(byte const *data, size num_bytes, u64 *val)
+{
+    u64 result = 0;
+    size max_bytes = num_bytes < COY_VARINT_MAX_BYTES ? num_bytes : COY_VARINT_MAX_BYTES;
+    for(size i = 0; i < max_bytes; ++i)
+    {
+        u8 b = (u8)data[i];
+        result |= (u64)(b & 0x7F) << (7 * i);
+        if(!(b & 0x80))
+        {
+            StopIf(i == COY_VARINT_MAX_BYTES - 1 && b > 1, return -1); /* Too big for 64 bits. */
+            *val = result;
+            return i + 1;
+        }
+    }
+
+    return num_bytes >= COY_VARINT_MAX_BYTES ? -1 : 0;
+}
+
+static inline b32
+coy_file_write_varint_u64(CoyFileWriter *file, u64 val)
+{
+    byte encoded[COY_VARINT_MAX_BYTES];
+    size num_bytes = coy_varint_encode(val, encoded);
+    return coy_file_write(file, num_bytes, encoded) == num_bytes;
+}
+
+static inline b32
+coy_file_write_varint_i64(CoyFileWriter *file, i64 val)
+{
+    return coy_file_write_varint_u64(file, coy_zigzag_encode((u64)val));
+}
+
+static inline b32
+coy_file_write_varints(CoyFileWriter *file, size count, u64 const *vals, b32 delta, i64 *last)
+{
+    Assert(count >= 0);
+    StopIf(!file->valid, return false);
+
+    u64 prev = delta ? (u64)*last : 0;
+    for(size i = 0; i < count; ++i)
+    {
+        u64 val = vals[i];
+        if(delta)
+        {
+            u64 diff = coy_zigzag_encode(val - prev);
+            prev = val;
+            val = diff;
+        }
+
+        /* Encode straight into the buffer, unless it's too small to ever hold a whole value. */
+        if(file->buf_size < COY_VARINT_MAX_BYTES)
+        {
+            StopIf(!coy_file_write_varint_u64(file, val), return false);
+            continue;
+        }
+
+        if(file->buf_size - file->buf_cursor < COY_VARINT_MAX_BYTES)
+        {
+            StopIf(coy_file_writer_flush(file) < 0, return false);
+        }
+        file->buf_cursor += coy_varint_encode(val, file->buffer + file->buf_cursor);
+    }
+
+    if(delta) { *last = (i64)prev; }
+    return true;
+}
+
+static inline b32
+coy_file_write_varint_u64_array(CoyFileWriter *file, size count, u64 const *vals)
+{
+    return coy_file_write_varints(file, count, vals, false, NULL);
+}
+
+static inline b32
+coy_file_write_delta_i64_array(CoyFileWriter *file, size count, i64 const *vals, i64 *last)
+{
+    return coy_file_write_varints(file, count, (u64 const *)vals, true, last);
+}
+
+static inline b32
+coy_file_read_varint_u64(CoyFileReader *file, u64 *val)
+{
+    /* Usually the whole value is buffered and it's decoded in place. */
+    size min_bytes = COY_VARINT_MAX_BYTES;
+    if(!file->ring.valid && file->buf_size < min_bytes) { min_bytes = file->buf_size; }
+
+    CoyByteView view = coy_file_peek(file, min_bytes);
+    StopIf(view.num_bytes < 0, return false);
+
+    size num_bytes = coy_varint_decode(view.data, view.num_bytes, val);
+    StopIf(num_bytes < 0, return false);
+    if(num_bytes > 0)
+    {
+        coy_file_consume(file, num_bytes);
+        return true;
+    }
+
+    /* Cut off by the end of the file or a buffer smaller than a value, take it a byte at a time. */
+    u64 result = 0;
+    for(i32 i = 0; i < COY_VARINT_MAX_BYTES; ++i)
+    {
+        u8 b = 0;
+        StopIf(!coy_file_read_u8(file, &b), return false);
+        result |= (u64)(b & 0x7F) << (7 * i);
+        if(!(b & 0x80))
+        {
+            StopIf(i == COY_VARINT_MAX_BYTES - 1 && b > 1, return false);
+            *val = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline b32
+coy_file_read_varint_i64(CoyFileReader *file, i64 *val)
+{
+    u64 zigzag = 0;
+    StopIf(!coy_file_read_varint_u64(file, &zigzag), return false);
+    *val = (i64)coy_zigzag_decode(zigzag);
+    return true;
+}
+
+static inline size
+coy_file_read_varint_u64_array(CoyFileReader *file, size count, u64 *vals)
+{
+    Assert(count >= 0);
+
+    size num_read = 0;
+    while(num_read < count)
+    {
+        /* Only refills when the buffer is empty, nothing buffered after that is the end of the file. */
+        CoyByteView view = coy_file_peek(file, 1);
+        StopIf(view.num_bytes < 0, return -1);
+        if(view.num_bytes == 0) { break; }
+
+        byte const *data = view.data;
+        size pos = 0;
+        while(num_read < count)
+        {
+            if(view.num_bytes - pos >= 8 && count - num_read >= 4)
+            {
+                u64 word = 0;
+                memcpy(&word, data + pos, sizeof(word));
+                if(coy_byte_order_swaps(COY_BYTE_ORDER_LITTLE))
+                {
+                    coy_byte_swap_copy(1, 8, (byte const *)&word, (byte *)&word);
+                }
+                u64 continuation = word & UINT64_C(0x8080808080808080);
+
+                /* No continuation bits, 8 one byte values. The common case for small numbers and deltas. */
+                if(continuation == 0 && count - num_read >= 8)
+                {
+                    for(i32 i = 0; i < 8; ++i) { vals[num_read + i] = (u8)data[pos + i]; }
+                    num_read += 8;
+                    pos += 8;
+                    continue;
+                }
+
+                /* Continuation bits on every other byte, 4 two byte values. Squeeze out the continuation bits so each
+                 * 16 bit lane holds one value.
+                 */
+                if(continuation == UINT64_C(0x0080008000800080))
+                {
+                    u64 lanes = (word & UINT64_C(0x007F007F007F007F)) | ((word & UINT64_C(0x7F007F007F007F00)) >> 1);
+                    for(i32 i = 0; i < 4; ++i) { vals[num_read + i] = (lanes >> (16 * i)) & 0xFFFF; }
+                    num_read += 4;
+                    pos += 8;
+                    continue;
+                }
+            }
+
+            /* Mixed lengths and longer values go one at a time. */
+
+            size num_bytes = coy_varint_decode(data + pos, view.num_bytes - pos, vals + num_read);
+            StopIf(num_bytes < 0, return -1);
+            if(num_bytes == 0) { break; } /* The rest of the value isn't buffered yet. */
+
+            num_read += 1;
+            pos += num_bytes;
+        }
+        coy_file_consume(file, pos);
+
+        /* A value split across a refill goes through the single value read. */
+        if(pos == 0 && num_read < count)
+        {
+            StopIf(!coy_file_read_varint_u64(file, vals + num_read), return -1);
+            num_read += 1;
+        }
+    }
+
+    return num_read;
+}
+
+static inline size
+coy_file_read_delta_i64_array(CoyFileReader *file, size count, i64 *vals, i64 *last)
+{
+    size num_read = coy_file_read_varint_u64_array(file, count, (u64 *)vals);
+    StopIf(num_read < 0, return -1);
+
+    u64 prev = (u64)*last;
+    for(size i = 0; i < num_read; ++i)
+    {
+        prev += coy_zigzag_decode((u64)vals[i]);
+        vals[i] = (i64)prev;
+    }
+
+    *last = (i64)prev;
+    return num_read;
+}
+
+/* Map a read only window from an open file (a mapping object on Windows), the mapping doesn't hang on to the handle. */
+static inline CoyMemMappedFile coy_memmap_map_range(iptr handle, size offset, size num_bytes, b32 populate);
+
+static inline CoyMemMappedFile const *
+coy_memmap_window_iterator_next(CoyMemMapWindowIter *iter)
+{
+    StopIf(!iter->valid, return NULL);
+
+    if(iter->window.valid) { coy_memmap_close(&iter->window); }
+    if(iter->_next_offset >= iter->file_size) { return NULL; }
+
+    if(iter->_next.valid)
+    {
+        iter->window = iter->_next;
+        iter->_next.valid = false;
+    }
+    else
+    {
+        size num_bytes = iter->file_size - iter->_next_offset;
+        if(num_bytes > iter->window_size) { num_bytes = iter->window_size; }
+
+        iter->window = coy_memmap_map_range(iter->_handle, iter->_next_offset, num_bytes, false);
+        StopIf(!iter->window.valid, goto ERR_RETURN);
+    }
+
+    /* The window that reaches the end of the file is the last one. */
+    size window_end = iter->window.offset + iter->window.size_in_bytes;
+    iter->_next_offset = window_end >= iter->file_size ? iter->file_size : iter->window.offset + iter->step;
+
+    if(iter->_next_offset < iter->file_size)
+    {
+        size num_bytes = iter->file_size - iter->_next_offset;
+        if(num_bytes > iter->window_size) { num_bytes = iter->window_size; }
+
+        /* If mapping ahead fails the next call tries again, so that's not an error yet. */
+        iter->_next = coy_memmap_map_range(iter->_handle, iter->_next_offset, num_bytes, false);
+        if(iter->_next.valid) { coy_memmap_advise(&iter->_next, COY_ACCESS_WILLNEED, 0, 0); }
+    }
+
+    return &iter->window;
+
+ERR_RETURN:
+    iter->valid = false;
+    return NULL;
+}
+
+static inline CoyChannel 
+coy_channel_create(void)
+{
+    CoyChannel chan = 
+        {
+            .head = 0,
+            .tail = 0,
+            .count = 0,
+            .mtx = coy_mutex_create(),
+            .space_available = coy_condvar_create(),
+            .data_available = coy_condvar_create(),
+            .num_producers_started = 0,
+            .num_producers_finished = 0,
+            .num_consumers_started = 0,
+            .num_consumers_finished = 0,
+            .buf = {0},
+        };
+
+    Assert(chan.mtx.valid);
+    Assert(chan.space_available.valid);
+    Assert(chan.data_available.valid);
+
+    return chan;
+}
+
+static inline void 
+coy_channel_destroy(CoyChannel *chan, void(*free_func)(void *ptr, void *ctx), void *free_ctx)
+{
+    Assert(chan->num_producers_started == chan->num_producers_finished);
+    Assert(chan->num_consumers_started == chan->num_consumers_finished);
+    if(free_func)
+    {
+        while(chan->count > 0)
+        {
+            free_func(chan->buf[chan->head % COYOTE_CHANNEL_SIZE], free_ctx);
+            chan->head += 1;
+            chan->count -= 1;
+        }
+
+        Assert(chan->head == chan->tail && chan->count == 0);
+    }
+
+    coy_mutex_destroy(&chan->mtx);
+    coy_condvar_destroy(&chan->space_available);
+    coy_condvar_destroy(&chan->data_available);
+    *chan = (CoyChannel){0};
+}
+
+static inline void 
+coy_channel_wait_until_ready_to_receive(CoyChannel *chan)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+
+    while(chan->num_producers_started == 0) 
+    {
+        coy_condvar_sleep(&chan->data_available, &chan->mtx); 
+    }
+
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+}
+
+static inline void 
+coy_channel_wait_until_ready_to_send(CoyChannel *chan)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+    while(chan->num_consumers_started == 0) { coy_condvar_sleep(&chan->space_available, &chan->mtx); }
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+}
+
+static inline void 
+coy_channel_register_sender(CoyChannel *chan)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+    chan->num_producers_started += 1;
+
+    if(chan->num_producers_started == 1)
+    {
+        /* Broadcast here so any threads blocked on coy_channel_wait_until_ready_to_receive can progress. If the number of
+         * producers is greater than 1, then this was already sent.
+         */
+        success = coy_condvar_wake_all(&chan->data_available);
+        Assert(success);
+    }
+
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+}
+
+static inline void 
+coy_channel_register_receiver(CoyChannel *chan)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+
+    chan->num_consumers_started += 1;
+
+    if(chan->num_consumers_started == 1)
+    {
+        /* Broadcast here so any threads blocked on coy_channel_wait_until_ready_to_send can progress. If the number of
+         * consumers is greater than 1, then this was already sent.
+         */
+        success = coy_condvar_wake_all(&chan->space_available);
+        Assert(success);
+    }
+
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+}
+
+static inline void 
+coy_channel_done_sending(CoyChannel *chan)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+    Assert(chan->num_producers_started > 0);
+
+    chan->num_producers_finished += 1;
+
+    if(chan->num_producers_started == chan->num_producers_finished)
+    {
+        /* Broadcast in case any thread is waiting for data to become available that won't because there are no more
+         * producers running. This will let them check the number of producers started/finished and realize nothing is
+         * coming so they too can quit.
+         */
+        success = coy_condvar_wake_all(&chan->data_available);
+        Assert(success);
+    }
+    else
+    {
+        /* Deadlock may occur if I don't do this. This thread got signaled when others should have. */
+        success = coy_condvar_wake_all(&chan->space_available);
+        Assert(success);
+    }
+
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+}
+
+static inline void 
+coy_channel_done_receiving(CoyChannel *chan)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+    Assert(chan->num_consumers_started > 0);
+
+    chan->num_consumers_finished += 1;
+
+    if(chan->num_consumers_started == chan->num_consumers_finished)
+    {
+        /* Broadcast in case any thread is waiting to send data that they will never be able to send because there are no
+         * consumers to receive it! This will let them check the number of consumers started/finished and realize space 
+         * will never become available.
+         */
+        success = coy_condvar_wake_all(&chan->space_available);
+        Assert(success);
+    }
+    else
+    {
+        /* Deadlock may occur if I don't do this. This thread got signaled when others should have. */
+        success = coy_condvar_wake_all(&chan->data_available);
+        Assert(success);
+    }
+
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+}
+
+static inline b32 
+coy_channel_send(CoyChannel *chan, void *data)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+    Assert(chan->num_producers_started > 0);
+
+    while(chan->count == COYOTE_CHANNEL_SIZE && chan->num_consumers_started != chan->num_consumers_finished)
+    {
+        success = coy_condvar_sleep(&chan->space_available, &chan->mtx);
+        Assert(success);
+    }
+
+    Assert(chan->count < COYOTE_CHANNEL_SIZE || chan->num_consumers_started == chan->num_consumers_finished);
+
+    if(chan->num_consumers_started > chan->num_consumers_finished)
+    {
+        chan->buf[(chan->tail) % COYOTE_CHANNEL_SIZE] = data;
+        chan->tail += 1;
+        chan->count += 1;
+
+        /* If the count was increased to 1, then someone may have been waiting to be notified! */
+        if(chan->count == 1)
+        {
+            success = coy_condvar_wake_all(&chan->data_available);
+            Assert(success);
+        }
+
+        success = coy_mutex_unlock(&chan->mtx);
+        Assert(success);
+        return true;
+    }
+    else
+    {
+        /* Space will never become available. */
+        success = coy_mutex_unlock(&chan->mtx);
+        Assert(success);
+        return false;
+    }
+}
+
+static inline b32 
+coy_channel_receive(CoyChannel *chan, void **out)
+{
+    b32 success = coy_mutex_lock(&chan->mtx);
+    Assert(success);
+
+    while(chan->count == 0 && chan->num_producers_started > chan->num_producers_finished)
+    {
+        success = coy_condvar_sleep(&chan->data_available, &chan->mtx);
+        Assert(success);
+    }
+
+    Assert(chan->count > 0 || chan->num_producers_started == chan->num_producers_finished);
+
+    *out = NULL;
+    if(chan->count > 0)
+    {
+        *out = chan->buf[(chan->head) % COYOTE_CHANNEL_SIZE];
+        chan->head += 1;
+        chan->count -= 1;
+    }
+    else
+    {
+        /* Nothing more is coming, to get here num_producers_started must num_producers_finished. */
+        success = coy_mutex_unlock(&chan->mtx);
+        Assert(success);
+        return false;
+    }
+
+    /* If the queue was full before, send a signal to let other's know there is room now. */
+    if( chan->count + 1 == COYOTE_CHANNEL_SIZE)
+    {
+        success = coy_condvar_wake_all(&chan->space_available);
+        Assert(success);
+    }
+    
+    success = coy_mutex_unlock(&chan->mtx);
+    Assert(success);
+
+    return true;
+}
+
+static inline CoyPool
+coy_pool_create(CoyMemoryBlock *mem, size object_size, size alignment)
+{
+    Assert(object_size > 0);
+    Assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    StopIf(!mem->valid, goto ERR_RETURN);
+
+    /* Objects double as free list nodes, so they must be able to hold a pointer. */
+    if(object_size < (size)sizeof(void *)) { object_size = sizeof(void *); }
+    if(alignment < (size)_Alignof(void *)) { alignment = _Alignof(void *); }
+    object_size = (object_size + alignment - 1) & ~(alignment - 1);
+
+    uptr start = ((uptr)mem->mem + alignment - 1) & ~(uptr)(alignment - 1);
+    size usable = mem->size - (size)(start - (uptr)mem->mem);
+    StopIf(usable < object_size, goto ERR_RETURN);
+
+    CoyPool pool =
+        {
+            .buf = (byte *)start,
+            .object_size = object_size,
+            .capacity = usable / object_size,
+            .num_carved = 0,
+            .free_list = NULL,
+            .in_use = 0,
+            .high_water = 0,
+            .mtx = coy_mutex_create(),
+            .valid = true,
+        };
+
+    StopIf(!pool.mtx.valid, goto ERR_RETURN);
+    return pool;
+
+ERR_RETURN:
+    return (CoyPool){ .valid = false };
+}
+
+static inline void
+coy_pool_destroy(CoyPool *pool)
+{
+    coy_mutex_destroy(&pool->mtx);
+    *pool = (CoyPool){ .valid = false };
+}
+
+/* Must hold the lock. Returns the number of objects actually taken from the pool. */
+static inline i32
+coy_pool_take_locked(CoyPool *pool, i32 count, void **objects)
+{
+    i32 num_taken = 0;
+    while(num_taken < count && pool->free_list)
+    {
+        objects[num_taken++] = pool->free_list;
+        pool->free_list = *(void **)pool->free_list;
+    }
+
+    /* Only touch fresh memory once the free list is empty. */
+    while(num_taken < count && pool->num_carved < pool->capacity)
+    {
+        objects[num_taken++] = pool->buf + pool->num_carved * pool->object_size;
+        pool->num_carved += 1;
+    }
+
+    pool->in_use += num_taken;
+    if(pool->in_use > pool->high_water) { pool->high_water = pool->in_use; }
+
+    return num_taken;
+}
+
+/* Must hold the lock. */
+static inline void
+coy_pool_give_locked(CoyPool *pool, i32 count, void **objects)
+{
+    for(i32 i = 0; i < count; ++i)
+    {
+        Assert((byte *)objects[i] >= pool->buf && (byte *)objects[i] < pool->buf + pool->num_carved * pool->object_size);
+        *(void **)objects[i] = pool->free_list;
+        pool->free_list = objects[i];
+    }
+
+    pool->in_use -= count;
+    Assert(pool->in_use >= 0);
+}
+
+static inline void *
+coy_pool_alloc(CoyPool *pool)
+{
+    void *object = NULL;
+
+    b32 success = coy_mutex_lock(&pool->mtx);
+    Assert(success);
+    coy_pool_take_locked(pool, 1, &object);
+    success = coy_mutex_unlock(&pool->mtx);
+    Assert(success);
+
+    return object;
+}
+
+static inline void
+coy_pool_free(CoyPool *pool, void *object)
+{
+    b32 success = coy_mutex_lock(&pool->mtx);
+    Assert(success);
+    coy_pool_give_locked(pool, 1, &object);
+    success = coy_mutex_unlock(&pool->mtx);
+    Assert(success);
+}
+
+static inline CoyPoolStats
+coy_pool_stats(CoyPool *pool)
+{
+    b32 success = coy_mutex_lock(&pool->mtx);
+    Assert(success);
+    CoyPoolStats stats = { .capacity = pool->capacity, .in_use = pool->in_use, .high_water = pool->high_water };
+    success = coy_mutex_unlock(&pool->mtx);
+    Assert(success);
+
+    return stats;
+}
+
+static inline CoyPoolCache
+coy_pool_cache_create(CoyPool *pool)
+{
+    return (CoyPoolCache){ .pool = pool, .count = 0, .objects = {0} };
+}
+
+static inline void *
+coy_pool_cache_alloc(CoyPoolCache *cache)
+{
+    if(cache->count == 0)
+    {
+        b32 success = coy_mutex_lock(&cache->pool->mtx);
+        Assert(success);
+        cache->count = coy_pool_take_locked(cache->pool, COY_POOL_CACHE_SIZE / 2, cache->objects);
+        success = coy_mutex_unlock(&cache->pool->mtx);
+        Assert(success);
+
+        StopIf(cache->count == 0, return NULL);
+    }
+
+    cache->count -= 1;
+    return cache->objects[cache->count];
+}
+
+static inline void
+coy_pool_cache_free(CoyPoolCache *cache, void *object)
+{
+    if(cache->count == COY_POOL_CACHE_SIZE)
+    {
+        /* Give back the oldest half, keep the most recently used (cache hot) objects. */
+        i32 const num_to_give = COY_POOL_CACHE_SIZE / 2;
+
+        b32 success = coy_mutex_lock(&cache->pool->mtx);
+        Assert(success);
+        coy_pool_give_locked(cache->pool, num_to_give, cache->objects);
+        success = coy_mutex_unlock(&cache->pool->mtx);
+        Assert(success);
+
+        memmove(cache->objects, cache->objects + num_to_give, (COY_POOL_CACHE_SIZE - num_to_give) * sizeof(void *));
+        cache->count -= num_to_give;
+    }
+
+    cache->objects[cache->count] = object;
+    cache->count += 1;
+}
+
+static inline void
+coy_pool_cache_flush(CoyPoolCache *cache)
+{
+    if(cache->count > 0)
+    {
+        b32 success = coy_mutex_lock(&cache->pool->mtx);
+        Assert(success);
+        coy_pool_give_locked(cache->pool, cache->count, cache->objects);
+        success = coy_mutex_unlock(&cache->pool->mtx);
+        Assert(success);
+
+        cache->count = 0;
+    }
+}
+
+/* Positional I/O and io_uring are implemented per platform. The io_uring functions return false / -1 where it's missing. */
+static inline iptr coy_file_open_handle(char const *filename, b32 create, b32 direct); /* -1 on error, create means read / write. */
+static inline void coy_file_close_handle(iptr handle);
+static inline size coy_file_size_handle(iptr handle); /* -1 on error */
+static inline b32 coy_file_set_size_handle(iptr handle, size num_bytes);
+static inline size coy_file_read_at(iptr handle, size offset, size num_bytes, byte *buffer);
+static inline size coy_file_write_at(iptr handle, size offset, size num_bytes, byte const *buffer);
+static inline b32 coy_async_uring_create(CoyAsyncFile *file);
+static inline i32 coy_async_uring_submit(CoyAsyncFile *file); /* How many of queued, in order, the kernel took. */
+static inline i32 coy_async_uring_reap(CoyAsyncFile *file, i32 max_slots, i32 *slots, b32 wait);
+static inline void coy_async_uring_destroy(CoyAsyncFile *file);
+
+static inline void
+coy_async_file_worker(void *data)
+{
+    CoyAsyncFile *file = data;
+
+    void *ptr = NULL;
+    while(coy_channel_receive(&file->pool_requests, &ptr))
+    {
+        CoyAsyncRequest *req = ptr;
+        if(req->is_write)
+        {
+            req->result = coy_file_write_at(file->handle, req->offset, req->num_bytes, req->buffer);
+        }
+        else
+        {
+            req->result = coy_file_read_at(file->handle, req->offset, req->num_bytes, req->buffer);
+        }
+
+        b32 success = coy_mutex_lock(&file->pool_mtx);
+        Assert(success);
+        file->pool_completed[file->pool_num_completed++] = (i32)(req - file->requests);
+        success = coy_condvar_wake(&file->pool_done);
+        Assert(success);
+        success = coy_mutex_unlock(&file->pool_mtx);
+        Assert(success);
+    }
+
+    coy_channel_done_receiving(&file->pool_requests);
+}
+
+static inline b32
+coy_async_file_open(CoyAsyncFile *file, char const *filename, u32 flags)
+{
+    *file = (CoyAsyncFile){ .handle = -1, .valid = false };
+
+    b32 create = (flags & COY_ASYNC_FLAG_WRITE) != 0;
+    if(flags & COY_ASYNC_FLAG_DIRECT)
+    {
+        file->handle = coy_file_open_handle(filename, create, true);
+        file->direct = file->handle != -1;
+    }
+    if(file->handle == -1) { file->handle = coy_file_open_handle(filename, create, false); }
+    StopIf(file->handle == -1, return false);
+
+    for(i32 i = 0; i < COY_ASYNC_QUEUE_DEPTH; ++i) { file->free_slots[i] = COY_ASYNC_QUEUE_DEPTH - 1 - i; }
+    file->num_free = COY_ASYNC_QUEUE_DEPTH;
+
+    if(!(flags & COY_ASYNC_FLAG_NO_IO_URING) && coy_async_uring_create(file))
+    {
+        file->using_io_uring = true;
+        file->valid = true;
+        return true;
+    }
+
+    /* Fall back to a thread pool. This thread is the only sender, the workers are the receivers. */
+    file->pool_requests = coy_channel_create();
+    file->pool_mtx = coy_mutex_create();
+    file->pool_done = coy_condvar_create();
+    coy_channel_register_sender(&file->pool_requests);
+
+    for(i32 i = 0; i < COY_ASYNC_NUM_WORKERS; ++i)
+    {
+        coy_channel_register_receiver(&file->pool_requests);
+        if(!coy_thread_create(&file->pool_workers[i], coy_async_file_worker, file))
+        {
+            coy_channel_done_receiving(&file->pool_requests);
+            break;
+        }
+        file->pool_num_workers++;
+    }
+
+    file->valid = true;
+    if(file->pool_num_workers == 0)
+    {
+        coy_async_file_close(file);
+        return false;
+    }
+
+    return true;
+}
+
+static inline b32
+coy_async_file_queue(CoyAsyncFile *file, size offset, size num_bytes, byte *buffer, void *user_data, b32 is_write)
+{
+    Assert(offset >= 0 && num_bytes >= 0);
+    Assert(!file->direct || (offset % COY_FILE_DIRECT_ALIGNMENT == 0 && num_bytes % COY_FILE_DIRECT_ALIGNMENT == 0 &&
+                             (uptr)buffer % COY_FILE_DIRECT_ALIGNMENT == 0));
+    StopIf(!file->valid || file->num_free == 0, return false);
+    StopIf(num_bytes > UINT32_MAX, return false); /* An io_uring request holds a u32 length. */
+
+    i32 slot = file->free_slots[--file->num_free];
+    file->requests[slot] = (CoyAsyncRequest)
+        {
+            .buffer = buffer,
+            .offset = offset,
+            .num_bytes = num_bytes,
+            .num_done = 0,
+            .result = -1,
+            .user_data = user_data,
+            .is_write = is_write
+        };
+    file->queued[file->num_queued++] = slot;
+
+    return true;
+}
+
+static inline b32
+coy_async_file_queue_read(CoyAsyncFile *file, size offset, size num_bytes, byte *buffer, void *user_data)
+{
+    return coy_async_file_queue(file, offset, num_bytes, buffer, user_data, false);
+}
+
+static inline b32
+coy_async_file_queue_write(CoyAsyncFile *file, size offset, size num_bytes, byte const *buffer, void *user_data)
+{
+    /* Cast away const, it's never written through for a write. */
+    return coy_async_file_queue(file, offset, num_bytes, (byte *)buffer, user_data, true);
+}
+
+static inline i32
+coy_async_file_submit(CoyAsyncFile *file)
+{
+    StopIf(!file->valid, return -1);
+
+    i32 num_submitted = 0;
+    if(file->using_io_uring)
+    {
+        num_submitted = coy_async_uring_submit(file);
+    }
+    else
+    {
+        while(num_submitted < file->num_queued &&
+              coy_channel_send(&file->pool_requests, &file->requests[file->queued[num_submitted]]))
+        {
+            ++num_submitted;
+        }
+    }
+
+    /* Whatever was handed off is in flight even if the rest failed, close has to wait for it. The rest stay queued. */
+    file->num_in_flight += num_submitted;
+    i32 num_left = file->num_queued - num_submitted;
+    memmove(file->queued, file->queued + num_submitted, num_left * sizeof(file->queued[0]));
+    file->num_queued = num_left;
+
+    StopIf(num_left > 0, return -1);
+    return num_submitted;
+}
+
+static inline i32
+coy_async_file_reap(CoyAsyncFile *file, i32 max_completions, CoyAsyncCompletion *completions, b32 wait)
+{
+    StopIf(!file->valid, return -1);
+    if(max_completions > COY_ASYNC_QUEUE_DEPTH) { max_completions = COY_ASYNC_QUEUE_DEPTH; }
+    wait = wait && file->num_in_flight > 0;
+
+    i32 slots[COY_ASYNC_QUEUE_DEPTH];
+    i32 num_reaped = 0;
+    if(file->using_io_uring)
+    {
+        num_reaped = coy_async_uring_reap(file, max_completions, slots, wait);
+        StopIf(num_reaped < 0, return -1);
+    }
+    else
+    {
+        b32 success = coy_mutex_lock(&file->pool_mtx);
+        Assert(success);
+
+        while(wait && file->pool_num_completed == 0) { coy_condvar_sleep(&file->pool_done, &file->pool_mtx); }
+
+        /* Take them off the end, order doesn't matter. */
+        while(num_reaped < max_completions && file->pool_num_completed > 0)
+        {
+            slots[num_reaped++] = file->pool_completed[--file->pool_num_completed];
+        }
+
+        success = coy_mutex_unlock(&file->pool_mtx);
+        Assert(success);
+    }
+
+    for(i32 i = 0; i < num_reaped; ++i)
+    {
+        CoyAsyncRequest *req = &file->requests[slots[i]];
+        completions[i] = (CoyAsyncCompletion){ .user_data = req->user_data, .result = req->result, .is_write = req->is_write };
+        file->free_slots[file->num_free++] = slots[i];
+    }
+    file->num_in_flight -= num_reaped;
+
+    return num_reaped;
+}
+
+static inline b32
+coy_async_file_set_size(CoyAsyncFile *file, size num_bytes)
+{
+    Assert(num_bytes >= 0);
+    StopIf(!file->valid || file->num_queued > 0 || file->num_in_flight > 0, return false);
+    return coy_file_set_size_handle(file->handle, num_bytes);
+}
+
+static inline void
+coy_async_file_close(CoyAsyncFile *file)
+{
+    if(file->valid)
+    {
+        /* Wait for everything in flight, the buffers might go away as soon as this returns. */
+        CoyAsyncCompletion completions[COY_ASYNC_QUEUE_DEPTH];
+        while(file->num_in_flight > 0)
+        {
+            i32 num_reaped = coy_async_file_reap(file, COY_ASYNC_QUEUE_DEPTH, completions, true);
+            StopIf(num_reaped < 0, break);
+        }
+
+        if(file->using_io_uring)
+        {
+            coy_async_uring_destroy(file);
+        }
+        else
+        {
+            coy_channel_done_sending(&file->pool_requests);
+            for(i32 i = 0; i < file->pool_num_workers; ++i)
+            {
+                b32 success = coy_thread_join(&file->pool_workers[i]);
+                Assert(success);
+                coy_thread_destroy(&file->pool_workers[i]);
+            }
+
+            coy_channel_destroy(&file->pool_requests, NULL, NULL);
+            coy_mutex_destroy(&file->pool_mtx);
+            coy_condvar_destroy(&file->pool_done);
+        }
+
+        coy_file_close_handle(file->handle);
+    }
+
+    file->valid = false;
+}
+
+static inline b32
+coy_direct_reader_queue_block(CoyDirectReader *reader, i32 slot)
+{
+    /* Blocks always land in the same slot, (offset / block_size) % num_blocks, so they can be found in order. */
+    if(reader->next_read_offset >= reader->file_size) { return true; }
+
+    byte *buffer = (byte *)reader->mem.mem + slot * reader->block_size;
+    reader->done[slot] = false;
+    b32 success = coy_async_file_queue_read(&reader->file, reader->next_read_offset, reader->block_size, buffer, (void *)(iptr)slot);
+    StopIf(!success, return false);
+
+    reader->next_read_offset += reader->block_size;
+    return true;
+}
+
+static inline b32
+coy_direct_reader_open(CoyDirectReader *reader, char const *filename, size block_size, i32 num_blocks)
+{
+    Assert(block_size > 0);
+    Assert(num_blocks > 0 && num_blocks <= COY_ASYNC_QUEUE_DEPTH);
+
+    *reader = (CoyDirectReader){ .held = -1, .valid = false };
+
+    block_size += COY_FILE_DIRECT_ALIGNMENT - 1;
+    block_size -= block_size % COY_FILE_DIRECT_ALIGNMENT;
+
+    size file_size = coy_file_size(filename);
+    StopIf(file_size < 0, goto ERR_RETURN);
+
+    /* Page aligned, so every block is aligned too. */
+    CoyMemoryBlock mem = coy_memory_allocate(block_size * num_blocks);
+    StopIf(!mem.valid, goto ERR_RETURN);
+
+    b32 success = coy_async_file_open(&reader->file, filename, COY_ASYNC_FLAG_DIRECT);
+    StopIf(!success, goto ERR_FREE);
+
+    reader->mem = mem;
+    reader->block_size = block_size;
+    reader->num_blocks = num_blocks;
+    reader->file_size = file_size;
+    reader->valid = true;
+
+    for(i32 i = 0; i < num_blocks; ++i)
+    {
+        StopIf(!coy_direct_reader_queue_block(reader, i), goto ERR_CLOSE);
+    }
+    StopIf(coy_async_file_submit(&reader->file) < 0, goto ERR_CLOSE);
+
+    return true;
+
+ERR_CLOSE:
+    coy_direct_reader_close(reader);
+    return false;
+ERR_FREE:
+    coy_memory_free(&mem);
+ERR_RETURN:
+    return false;
+}
+
+static inline CoyByteView
+coy_direct_reader_next(CoyDirectReader *reader)
+{
+    StopIf(!reader->valid || reader->error, goto ERR_RETURN);
+
+    /* The caller is done with the last block, so its slot can go read further ahead. */
+    if(reader->held >= 0)
+    {
+        StopIf(!coy_direct_reader_queue_block(reader, reader->held), goto ERR_RETURN);
+        StopIf(coy_async_file_submit(&reader->file) < 0, goto ERR_RETURN);
+        reader->held = -1;
+    }
+
+    if(reader->next_offset >= reader->file_size) { return (CoyByteView){ .data = NULL, .num_bytes = 0 }; }
+
+    i32 slot = (i32)((reader->next_offset / reader->block_size) % reader->num_blocks);
+    while(!reader->done[slot])
+    {
+        CoyAsyncCompletion completions[COY_ASYNC_QUEUE_DEPTH];
+        i32 num_reaped = coy_async_file_reap(&reader->file, COY_ASYNC_QUEUE_DEPTH, completions, true);
+        StopIf(num_reaped <= 0, goto ERR_RETURN);
+
+        for(i32 i = 0; i < num_reaped; ++i)
+        {
+            i32 done_slot = (i32)(iptr)completions[i].user_data;
+            reader->done[done_slot] = true;
+            reader->results[done_slot] = completions[i].result;
+        }
+    }
+
+    /* Only the last block comes up short. */
+    size expected = reader->file_size - reader->next_offset;
+    if(expected > reader->block_size) { expected = reader->block_size; }
+    StopIf(reader->results[slot] != expected, goto ERR_RETURN);
+
+    reader->held = slot;
+    reader->next_offset += reader->block_size;
+
+    return (CoyByteView){ .data = (byte *)reader->mem.mem + slot * reader->block_size, .num_bytes = expected };
+
+ERR_RETURN:
+    reader->error = true;
+    return (CoyByteView){ .data = NULL, .num_bytes = -1 };
+}
+
+static inline void
+coy_direct_reader_close(CoyDirectReader *reader)
+{
+    if(reader->valid)
+    {
+        /* Waits for the reads in flight before the memory goes away. */
+        coy_async_file_close(&reader->file);
+        coy_memory_free(&reader->mem);
+    }
+
+    reader->valid = false;
+}
+
+static inline size 
+coy_file_slurp(char const *filename, size buf_size, byte *buffer)
+{
+    iptr handle = coy_file_open_handle(filename, false, false);
+    StopIf(handle == -1, goto ERR_RETURN);
+
+    /* Size the open file, a second lookup by name could find a different file. */
+    size file_size = coy_file_size_handle(handle);
+    StopIf(file_size < 1 || file_size > buf_size, goto CLOSE_AND_ERR);
+
+    size num_bytes_read = coy_file_read_at(handle, 0, file_size, buffer);
+    StopIf(num_bytes_read < 0, goto CLOSE_AND_ERR);
+
+    coy_file_close_handle(handle);
+    return num_bytes_read;
+
+CLOSE_AND_ERR:
+    coy_file_close_handle(handle);
+ERR_RETURN:
+    return -1;
+}
+
+static inline CoyByteView
+coy_file_slurp_arena(char const *filename, CoyArena *arena)
+{
+    CoyArenaMarker marker = coy_arena_save(arena);
+
+    iptr handle = coy_file_open_handle(filename, false, false);
+    StopIf(handle == -1, goto ERR_RETURN);
+
+    size file_size = coy_file_size_handle(handle);
+    StopIf(file_size < 0, goto CLOSE_AND_ERR);
+
+    byte *data = coy_arena_push(arena, file_size + 1, 1);
+    StopIf(!data, goto CLOSE_AND_ERR);
+
+    /* Short means the file shrank since the size was checked. */
+    size num_bytes_read = coy_file_read_at(handle, 0, file_size, data);
+    StopIf(num_bytes_read != file_size, goto CLOSE_AND_ERR);
+    data[file_size] = 0;
+
+    coy_file_close_handle(handle);
+    return (CoyByteView){ .data = data, .num_bytes = file_size };
+
+CLOSE_AND_ERR:
+    coy_file_close_handle(handle);
+    coy_arena_restore(marker);
+ERR_RETURN:
+    return (CoyByteView){ .data = NULL, .num_bytes = -1 };
+}
+
+typedef struct
+{
+    char const *const *filenames;
+    iptr *handles;          /* Opened in the first pass, read and closed in the second. -1 if it couldn't be opened.  */
+    CoyByteView *views;     /* Where each file goes and how big it should be, laid out between the two passes.        */
+    i32 group_start;        /* handles[0] is the file at this index.                                                  */
+    i32 num_files;          /* End of the group.                                                                      */
+    i32 first;
+    i32 stride;
+    b32 success;
+} CoyFileSlurpShare;
+
+static inline void
+coy_file_slurp_open_share(void *data)
+{
+    CoyFileSlurpShare *share = data;
+    share->success = true;
+
+    /* Every stride'th file, so a few big files in a row don't all land on one thread. */
+    for(i32 i = share->first; i < share->num_files; i += share->stride)
+    {
+        size file_size = -1;
+        iptr handle = coy_file_open_handle(share->filenames[i], false, false);
+        if(handle != -1)
+        {
+            file_size = coy_file_size_handle(handle);
+            if(file_size < 0)
+            {
+                coy_file_close_handle(handle);
+                handle = -1;
+            }
+        }
+
+        share->handles[i - share->group_start] = handle;
+        share->views[i] = (CoyByteView){ .data = NULL, .num_bytes = file_size };
+        share->success = handle != -1 && share->success;
+    }
+}
+
+static inline void
+coy_file_slurp_read_share(void *data)
+{
+    CoyFileSlurpShare *share = data;
+    share->success = true;
+
+    for(i32 i = share->first; i < share->num_files; i += share->stride)
+    {
+        iptr handle = share->handles[i - share->group_start];
+        if(handle == -1) { share->success = false; continue; }
+
+        /* Short means the file shrank since it was sized. */
+        size expected = share->views[i].num_bytes;
+        byte *dest = (byte *)share->views[i].data;
+        size num_bytes_read = coy_file_read_at(handle, 0, expected, dest);
+        coy_file_close_handle(handle);
+        share->handles[i - share->group_start] = -1;
+
+        if(num_bytes_read == expected)
+        {
+            dest[expected] = 0;
+        }
+        else
+        {
+            share->views[i] = (CoyByteView){ .data = NULL, .num_bytes = -1 };
+            share->success = false;
+        }
+    }
+}
+
+/* Run func on every share, the calling thread takes the first one and any share a thread couldn't start for. */
+static inline b32
+coy_file_slurp_run(i32 num_threads, CoyFileSlurpShare *shares, CoyThreadFunc func)
+{
+    CoyThread threads[COY_FILE_SLURP_MAX_THREADS];
+    b32 started[COY_FILE_SLURP_MAX_THREADS] = {0};
+    for(i32 i = 1; i < num_threads; ++i) { started[i] = coy_thread_create(&threads[i], func, &shares[i]); }
+
+    func(&shares[0]);
+    b32 success = shares[0].success;
+    for(i32 i = 1; i < num_threads; ++i)
+    {
+        if(started[i])
+        {
+            b32 joined = coy_thread_join(&threads[i]);
+            Assert(joined);
+            coy_thread_destroy(&threads[i]);
+        }
+        else
+        {
+            func(&shares[i]);
+        }
+
+        success = shares[i].success && success;
+    }
+
+    return success;
+}
+
+static inline b32
+coy_file_slurp_batch(i32 num_files, char const *const *filenames, CoyArena *arena, i32 num_threads, CoyByteView *views)
+{
+    Assert(num_files >= 0);
+    if(num_files == 0) { return true; }
+
+    if(num_threads > COY_FILE_SLURP_MAX_THREADS) { num_threads = COY_FILE_SLURP_MAX_THREADS; }
+    if(num_threads > COY_FILE_SLURP_MAX_OPEN) { num_threads = COY_FILE_SLURP_MAX_OPEN; }
+    if(num_threads > num_files) { num_threads = num_files; }
+    if(num_threads < 1) { num_threads = 1; }
+
+    /* Groups of at most COY_FILE_SLURP_MAX_OPEN files, so thousands of files don't run into the open file limit. Each
+     * group's pushes land right after the last group's, so the whole batch is still one block.
+     */
+    CoyArenaMarker marker = coy_arena_save(arena);
+    iptr handles[COY_FILE_SLURP_MAX_OPEN];
+    b32 success = true;
+    for(i32 group_start = 0; group_start < num_files; group_start += COY_FILE_SLURP_MAX_OPEN)
+    {
+        i32 group_end = num_files - group_start > COY_FILE_SLURP_MAX_OPEN ? group_start + COY_FILE_SLURP_MAX_OPEN
+                                                                           : num_files;
+
+        CoyFileSlurpShare shares[COY_FILE_SLURP_MAX_THREADS];
+        for(i32 i = 0; i < num_threads; ++i)
+        {
+            shares[i] = (CoyFileSlurpShare)
+                {
+                    .filenames = filenames,
+                    .handles = handles,
+                    .views = views,
+                    .group_start = group_start,
+                    .num_files = group_end,
+                    .first = group_start + i,
+                    .stride = num_threads
+                };
+        }
+
+        /* Open and size each file once, then lay them out back to back, each followed by its zero terminator. */
+        success = coy_file_slurp_run(num_threads, shares, coy_file_slurp_open_share) && success;
+
+        size group_size = 0;
+        for(i32 i = group_start; i < group_end; ++i)
+        {
+            if(views[i].num_bytes >= 0) { group_size += views[i].num_bytes + 1; }
+        }
+
+        byte *next = coy_arena_push(arena, group_size, 1);
+        if(!next)
+        {
+            for(i32 i = group_start; i < group_end; ++i)
+            {
+                if(handles[i - group_start] != -1) { coy_file_close_handle(handles[i - group_start]); }
+            }
+            goto ERR_RESTORE;
+        }
+
+        for(i32 i = group_start; i < group_end; ++i)
+        {
+            if(views[i].num_bytes < 0) { continue; }
+            views[i].data = next;
+            next += views[i].num_bytes + 1;
+        }
+
+        success = coy_file_slurp_run(num_threads, shares, coy_file_slurp_read_share) && success;
+    }
+
+    return success;
+
+ERR_RESTORE:
+    coy_arena_restore(marker);
+    for(i32 i = 0; i < num_files; ++i) { views[i] = (CoyByteView){ .data = NULL, .num_bytes = -1 }; }
+    return false;
 }
 
-static inline void 
-coy_channel_register_sender(CoyChannel *chan)
+enum
 {
-    b32 success = coy_mutex_lock(&chan->mtx);
-    Assert(success);
-    chan->num_producers_started += 1;
+    COY_PARALLEL_SLOT_FREE = 0,
+    COY_PARALLEL_SLOT_READING,
+    COY_PARALLEL_SLOT_READY,
+    COY_PARALLEL_SLOT_HELD,
+};
 
-    if(chan->num_producers_started == 1)
+static inline b32
+coy_parallel_reader_read_chunk(CoyParallelReader *reader, CoyParallelReaderSlot *slot)
+{
+    size nominal_start = slot->index * reader->chunk_size;
+    size overlap = reader->find_record ? reader->max_record_size : 0;
+    size to_read = reader->chunk_size + overlap;
+    if(to_read > reader->file_size - nominal_start) { to_read = reader->file_size - nominal_start; }
+    b32 reached_eof = nominal_start + to_read == reader->file_size;
+
+    size num_read = coy_file_read_at(reader->handle, nominal_start, to_read, slot->buffer);
+    StopIf(num_read != to_read, return false);
+
+    size start = 0;
+    size end = num_read < reader->chunk_size ? num_read : reader->chunk_size;
+    if(reader->find_record)
     {
-        /* Broadcast here so any threads blocked on coy_channel_wait_until_ready_to_receive can progress. If the number of
-         * producers is greater than 1, then this was already sent.
-         */
-        success = coy_condvar_wake_all(&chan->data_available);
-        Assert(success);
+        /* Both neighbors find the same boundary, since they call find_record on the same bytes. */
+        if(slot->index > 0)
+        {
+            start = reader->find_record(slot->buffer, num_read, reader->find_record_ctx);
+            if(start < 0)
+            {
+                /* A record runs past the end of this read. Fine if it's the last one in the file. */
+                StopIf(!reached_eof, return false);
+                start = num_read;
+            }
+        }
+
+        if(slot->index < reader->num_chunks - 1)
+        {
+            size skip = reader->find_record(slot->buffer + end, num_read - end, reader->find_record_ctx);
+            if(skip < 0)
+            {
+                StopIf(!reached_eof, return false);
+                skip = num_read - end;
+            }
+            end += skip;
+        }
+        else
+        {
+            end = num_read;
+        }
+
+        if(start > end) { start = end; }
     }
 
-    success = coy_mutex_unlock(&chan->mtx);
-    Assert(success);
+    slot->start = start;
+    slot->num_bytes = end - start;
+    return true;
 }
 
-static inline void 
-coy_channel_register_receiver(CoyChannel *chan)
+static inline void
+coy_parallel_reader_worker(void *data)
 {
-    b32 success = coy_mutex_lock(&chan->mtx);
-    Assert(success);
+    CoyParallelReader *reader = data;
 
-    chan->num_consumers_started += 1;
+    b32 success = coy_mutex_lock(&reader->mtx);
+    Assert(success);
 
-    if(chan->num_consumers_started == 1)
+    while(true)
     {
-        /* Broadcast here so any threads blocked on coy_channel_wait_until_ready_to_send can progress. If the number of
-         * consumers is greater than 1, then this was already sent.
-         */
-        success = coy_condvar_wake_all(&chan->space_available);
-        Assert(success);
-    }
+        /* Get a buffer before taking a chunk number, so the next chunk in order always has a buffer to read into. */
+        CoyParallelReaderSlot *slot = NULL;
+        while(!reader->closing && !reader->error && reader->next_to_read < reader->num_chunks)
+        {
+            for(i32 i = 0; i < reader->num_slots; ++i)
+            {
+                if(reader->slots[i].state == COY_PARALLEL_SLOT_FREE) { slot = &reader->slots[i]; break; }
+            }
+            if(slot) { break; }
 
-    success = coy_mutex_unlock(&chan->mtx);
-    Assert(success);
-}
+            coy_condvar_sleep(&reader->slot_free, &reader->mtx);
+        }
 
-static inline void 
-coy_channel_done_sending(CoyChannel *chan)
-{
-    b32 success = coy_mutex_lock(&chan->mtx);
-    Assert(success);
-    Assert(chan->num_producers_started > 0);
+        if(!slot) { break; }
 
-    chan->num_producers_finished += 1;
+        slot->state = COY_PARALLEL_SLOT_READING;
+        slot->index = reader->next_to_read++;
 
-    if(chan->num_producers_started == chan->num_producers_finished)
-    {
-        /* Broadcast in case any thread is waiting for data to become available that won't because there are no more
-         * producers running. This will let them check the number of producers started/finished and realize nothing is
-         * coming so they too can quit.
-         */
-        success = coy_condvar_wake_all(&chan->data_available);
+        success = coy_mutex_unlock(&reader->mtx);
         Assert(success);
-    }
-    else
-    {
-        /* Deadlock may occur if I don't do this. This thread got signaled when others should have. */
-        success = coy_condvar_wake_all(&chan->space_available);
+
+        b32 read_ok = coy_parallel_reader_read_chunk(reader, slot);
+
+        success = coy_mutex_lock(&reader->mtx);
+        Assert(success);
+
+        slot->state = COY_PARALLEL_SLOT_READY;
+        if(!read_ok) { reader->error = true; }
+        success = coy_condvar_wake_all(&reader->chunk_ready);
         Assert(success);
     }
 
-    success = coy_mutex_unlock(&chan->mtx);
+    /* Anyone waiting on a chunk that will never come needs to find out. */
+    success = coy_condvar_wake_all(&reader->chunk_ready);
+    Assert(success);
+    success = coy_mutex_unlock(&reader->mtx);
     Assert(success);
 }
 
-static inline void 
-coy_channel_done_receiving(CoyChannel *chan)
+static inline b32
+coy_parallel_reader_open(CoyParallelReader *reader, char const *filename, size chunk_size, i32 num_threads,
+                         b32 in_order, CoyFindRecordFunc find_record, size max_record_size, void *ctx)
 {
-    b32 success = coy_mutex_lock(&chan->mtx);
-    Assert(success);
-    Assert(chan->num_consumers_started > 0);
+    Assert(chunk_size > 0);
+    Assert(!find_record || max_record_size > 0);
+
+    *reader = (CoyParallelReader){ .valid = false };
+    if(num_threads < 1) { num_threads = 1; }
+    if(num_threads > COY_PARALLEL_READER_MAX_THREADS) { num_threads = COY_PARALLEL_READER_MAX_THREADS; }
+
+    size file_size = coy_file_size(filename);
+    StopIf(file_size < 0, goto ERR_RETURN);
+    iptr handle = coy_file_open_handle(filename, false, false);
+    StopIf(handle == -1, goto ERR_RETURN);
+
+    size buffer_size = chunk_size + (find_record ? max_record_size : 0);
+    i32 num_slots = 2 * num_threads;
+    CoyMemoryBlock mem = coy_memory_allocate(buffer_size * num_slots);
+    StopIf(!mem.valid, goto ERR_CLOSE);
+
+    reader->handle = handle;
+    reader->file_size = file_size;
+    reader->chunk_size = chunk_size;
+    reader->max_record_size = max_record_size;
+    reader->num_chunks = (file_size + chunk_size - 1) / chunk_size;
+    reader->find_record = find_record;
+    reader->find_record_ctx = ctx;
+    reader->in_order = in_order;
+    reader->mem = mem;
+    reader->num_slots = num_slots;
+    for(i32 i = 0; i < num_slots; ++i)
+    {
+        reader->slots[i] = (CoyParallelReaderSlot){ .buffer = (byte *)mem.mem + i * buffer_size };
+    }
 
-    chan->num_consumers_finished += 1;
+    reader->mtx = coy_mutex_create();
+    reader->slot_free = coy_condvar_create();
+    reader->chunk_ready = coy_condvar_create();
+    reader->valid = true;
 
-    if(chan->num_consumers_started == chan->num_consumers_finished)
+    for(i32 i = 0; i < num_threads; ++i)
     {
-        /* Broadcast in case any thread is waiting to send data that they will never be able to send because there are no
-         * consumers to receive it! This will let them check the number of consumers started/finished and realize space 
-         * will never become available.
-         */
-        success = coy_condvar_wake_all(&chan->space_available);
-        Assert(success);
+        if(!coy_thread_create(&reader->workers[i], coy_parallel_reader_worker, reader)) { break; }
+        reader->num_workers++;
     }
-    else
+
+    if(reader->num_workers == 0)
     {
-        /* Deadlock may occur if I don't do this. This thread got signaled when others should have. */
-        success = coy_condvar_wake_all(&chan->data_available);
-        Assert(success);
+        coy_parallel_reader_close(reader);
+        return false;
     }
 
-    success = coy_mutex_unlock(&chan->mtx);
-    Assert(success);
+    return true;
+
+ERR_CLOSE:
+    coy_file_close_handle(handle);
+ERR_RETURN:
+    return false;
 }
 
-static inline b32 
-coy_channel_send(CoyChannel *chan, void *data)
+static inline CoyFileChunk
+coy_parallel_reader_next(CoyParallelReader *reader)
 {
-    b32 success = coy_mutex_lock(&chan->mtx);
+    StopIf(!reader->valid, return (CoyFileChunk){ .valid = false });
+
+    b32 success = coy_mutex_lock(&reader->mtx);
     Assert(success);
-    Assert(chan->num_producers_started > 0);
 
-    while(chan->count == COYOTE_CHANNEL_SIZE && chan->num_consumers_started != chan->num_consumers_finished)
+    CoyFileChunk chunk = { .valid = false };
+    while(!reader->error && reader->num_delivered < reader->num_chunks)
     {
-        success = coy_condvar_sleep(&chan->space_available, &chan->mtx);
-        Assert(success);
-    }
+        CoyParallelReaderSlot *slot = NULL;
+        for(i32 i = 0; i < reader->num_slots; ++i)
+        {
+            CoyParallelReaderSlot *s = &reader->slots[i];
+            if(s->state == COY_PARALLEL_SLOT_READY && (!reader->in_order || s->index == reader->next_to_deliver))
+            {
+                slot = s;
+                break;
+            }
+        }
 
-    Assert(chan->count < COYOTE_CHANNEL_SIZE || chan->num_consumers_started == chan->num_consumers_finished);
+        if(!slot)
+        {
+            coy_condvar_sleep(&reader->chunk_ready, &reader->mtx);
+            continue;
+        }
 
-    if(chan->num_consumers_started > chan->num_consumers_finished)
-    {
-        chan->buf[(chan->tail) % COYOTE_CHANNEL_SIZE] = data;
-        chan->tail += 1;
-        chan->count += 1;
+        reader->num_delivered++;
+        reader->next_to_deliver++;
 
-        /* If the count was increased to 1, then someone may have been waiting to be notified! */
-        if(chan->count == 1)
+        if(slot->num_bytes == 0)
         {
-            success = coy_condvar_wake_all(&chan->data_available);
+            /* Nothing but the middle of a record, skip it. */
+            slot->state = COY_PARALLEL_SLOT_FREE;
+            success = coy_condvar_wake(&reader->slot_free);
             Assert(success);
+            continue;
         }
 
-        success = coy_mutex_unlock(&chan->mtx);
-        Assert(success);
-        return true;
-    }
-    else
-    {
-        /* Space will never become available. */
-        success = coy_mutex_unlock(&chan->mtx);
-        Assert(success);
-        return false;
+        slot->state = COY_PARALLEL_SLOT_HELD;
+        chunk = (CoyFileChunk)
+            {
+                .data = slot->buffer + slot->start,
+                .num_bytes = slot->num_bytes,
+                .offset = slot->index * reader->chunk_size + slot->start,
+                .index = slot->index,
+                ._slot = (i32)(slot - reader->slots),
+                .valid = true
+            };
+        break;
     }
-}
 
-static inline b32 
-coy_channel_receive(CoyChannel *chan, void **out)
-{
-    b32 success = coy_mutex_lock(&chan->mtx);
+    success = coy_mutex_unlock(&reader->mtx);
     Assert(success);
 
-    while(chan->count == 0 && chan->num_producers_started > chan->num_producers_finished)
+    return chunk;
+}
+
+static inline void
+coy_parallel_reader_release(CoyParallelReader *reader, CoyFileChunk *chunk)
+{
+    if(chunk->valid)
     {
-        success = coy_condvar_sleep(&chan->data_available, &chan->mtx);
+        b32 success = coy_mutex_lock(&reader->mtx);
         Assert(success);
-    }
 
-    Assert(chan->count > 0 || chan->num_producers_started == chan->num_producers_finished);
+        Assert(reader->slots[chunk->_slot].state == COY_PARALLEL_SLOT_HELD);
+        reader->slots[chunk->_slot].state = COY_PARALLEL_SLOT_FREE;
+        success = coy_condvar_wake(&reader->slot_free);
+        Assert(success);
 
-    *out = NULL;
-    if(chan->count > 0)
-    {
-        *out = chan->buf[(chan->head) % COYOTE_CHANNEL_SIZE];
-        chan->head += 1;
-        chan->count -= 1;
-    }
-    else
-    {
-        /* Nothing more is coming, to get here num_producers_started must num_producers_finished. */
-        success = coy_mutex_unlock(&chan->mtx);
+        success = coy_mutex_unlock(&reader->mtx);
         Assert(success);
-        return false;
     }
 
-    /* If the queue was full before, send a signal to let other's know there is room now. */
-    if( chan->count + 1 == COYOTE_CHANNEL_SIZE)
+    chunk->valid = false;
+}
+
+static inline b32
+coy_parallel_reader_close(CoyParallelReader *reader)
+{
+    b32 no_errors = false;
+    if(reader->valid)
     {
-        success = coy_condvar_wake_all(&chan->space_available);
+        b32 success = coy_mutex_lock(&reader->mtx);
+        Assert(success);
+        reader->closing = true;
+        success = coy_condvar_wake_all(&reader->slot_free);
         Assert(success);
+        success = coy_mutex_unlock(&reader->mtx);
+        Assert(success);
+
+        for(i32 i = 0; i < reader->num_workers; ++i)
+        {
+            success = coy_thread_join(&reader->workers[i]);
+            Assert(success);
+            coy_thread_destroy(&reader->workers[i]);
+        }
+
+        no_errors = !reader->error;
+
+        coy_mutex_destroy(&reader->mtx);
+        coy_condvar_destroy(&reader->slot_free);
+        coy_condvar_destroy(&reader->chunk_ready);
+        coy_memory_free(&reader->mem);
+        coy_file_close_handle(reader->handle);
     }
-    
-    success = coy_mutex_unlock(&chan->mtx);
-    Assert(success);
 
-    return true;
+    reader->valid = false;
+    return no_errors;
 }
 
 typedef struct
@@ -1060,6 +4207,190 @@ coy_profile_end_block(CoyProfileAnchor *anchor)
 #endif
 }
 
+static inline u64
+coy_memory_tag_read_faults(void)
+{
+    return coy_global_os_metrics.initialized ? coy_profile_read_os_page_fault_count() : 0;
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_tagged(size minimum_num_bytes, i32 tag, char const *label)
+{
+#if COY_MEMORY_TAGS
+    Assert(tag >= 0 && tag < COY_MEMORY_NUM_TAGS);
+
+    u64 start_faults = coy_memory_tag_read_faults();
+    CoyMemoryBlock mem = coy_memory_allocate(minimum_num_bytes);
+    u64 end_faults = coy_memory_tag_read_faults();
+    StopIf(!mem.valid, return mem);
+
+    CoyMemoryTagStats *stats = coy_global_memory_tags.tags + tag;
+    stats->label = label; /* gotta do it every time */
+    stats->allocation_count++;
+    stats->page_faults += end_faults - start_faults;
+    stats->current_bytes += mem.committed;
+    if(stats->current_bytes > stats->peak_bytes) { stats->peak_bytes = stats->current_bytes; }
+
+    coy_global_memory_tags.total_current_bytes += mem.committed;
+    if(coy_global_memory_tags.total_current_bytes > coy_global_memory_tags.total_peak_bytes)
+    {
+        coy_global_memory_tags.total_peak_bytes = coy_global_memory_tags.total_current_bytes;
+    }
+
+    return mem;
+#else
+    return coy_memory_allocate(minimum_num_bytes);
+#endif
+}
+
+static inline void
+coy_memory_free_tagged(CoyMemoryBlock *mem, i32 tag)
+{
+#if COY_MEMORY_TAGS
+    Assert(tag >= 0 && tag < COY_MEMORY_NUM_TAGS);
+
+    if(mem->valid)
+    {
+        CoyMemoryTagStats *stats = coy_global_memory_tags.tags + tag;
+        Assert(stats->current_bytes >= mem->committed);
+        stats->free_count++;
+        stats->current_bytes -= mem->committed;
+        coy_global_memory_tags.total_current_bytes -= mem->committed;
+    }
+#endif
+    coy_memory_free(mem);
+}
+
+static inline CoyMemoryTagAnchor
+coy_memory_tag_begin(i32 tag)
+{
+#if COY_MEMORY_TAGS
+    Assert(tag >= 0 && tag < COY_MEMORY_NUM_TAGS);
+    return (CoyMemoryTagAnchor){ .tag = tag, .start_faults = coy_memory_tag_read_faults() };
+#else
+    return 0;
+#endif
+}
+
+static inline void
+coy_memory_tag_end(CoyMemoryTagAnchor *anchor)
+{
+#if COY_MEMORY_TAGS
+    u64 end_faults = coy_memory_tag_read_faults();
+    coy_global_memory_tags.tags[anchor->tag].page_faults += end_faults - anchor->start_faults;
+#endif
+}
+
+static inline void
+coy_memory_tag_report(void)
+{
+    f64 const mib = (f64)COY_MiB(1);
+    for(i32 i = 0; i < COY_ARRAY_SIZE(coy_global_memory_tags.tags); ++i)
+    {
+        CoyMemoryTagStats *stats = coy_global_memory_tags.tags + i;
+        stats->live_allocations = stats->allocation_count - stats->free_count;
+        stats->current_mib = (f64)stats->current_bytes / mib;
+        stats->peak_mib = (f64)stats->peak_bytes / mib;
+        stats->faults_per_mib = stats->peak_bytes ? (f64)stats->page_faults / stats->peak_mib : 0.0;
+    }
+}
+
+typedef struct
+{
+    byte *start;
+    size num_bytes;
+    size page_size;
+} CoyPrefaultSlice;
+
+static inline void
+coy_memory_prefault_slice(void *data)
+{
+    CoyPrefaultSlice *slice = data;
+    for(size i = 0; i < slice->num_bytes; i += slice->page_size)
+    {
+        ((byte volatile *)slice->start)[i] = 0;
+    }
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_prefault_parallel(size minimum_num_bytes, i32 num_threads, CoyPrefaultStats *stats)
+{
+    size page_size = coy_memory_page_size();
+
+    CoyMemoryBlock mem = coy_memory_reserve(minimum_num_bytes);
+    StopIf(!mem.valid, goto ERR_RETURN);
+    b32 success = coy_memory_commit(&mem, 0, mem.size);
+    StopIf(!success, goto FREE_AND_ERR);
+
+    size num_pages = mem.size / page_size;
+    if(num_threads > COY_PREFAULT_MAX_THREADS) { num_threads = COY_PREFAULT_MAX_THREADS; }
+    if(num_threads > num_pages) { num_threads = (i32)num_pages; }
+    if(num_threads < 1) { num_threads = 1; }
+
+    CoyThread threads[COY_PREFAULT_MAX_THREADS];
+    CoyPrefaultSlice slices[COY_PREFAULT_MAX_THREADS];
+    b32 started[COY_PREFAULT_MAX_THREADS] = {0};
+
+    u64 start_faults = coy_global_os_metrics.initialized ? coy_profile_read_os_page_fault_count() : 0;
+    u64 start_time = coy_profile_read_os_timer();
+
+    size pages_per_thread = num_pages / num_threads;
+    size extra_pages = num_pages % num_threads;
+    size next_page = 0;
+    for(i32 i = 0; i < num_threads; ++i)
+    {
+        size slice_pages = pages_per_thread + (i < extra_pages ? 1 : 0);
+        slices[i] = (CoyPrefaultSlice)
+            {
+                .start = (byte *)mem.mem + next_page * page_size,
+                .num_bytes = slice_pages * page_size,
+                .page_size = page_size
+            };
+        next_page += slice_pages;
+
+        /* The calling thread takes the first slice. */
+        if(i > 0)
+        {
+            started[i] = coy_thread_create(&threads[i], coy_memory_prefault_slice, &slices[i]);
+        }
+    }
+
+    coy_memory_prefault_slice(&slices[0]);
+    for(i32 i = 1; i < num_threads; ++i)
+    {
+        if(started[i])
+        {
+            success = coy_thread_join(&threads[i]);
+            Assert(success);
+            coy_thread_destroy(&threads[i]);
+        }
+        else
+        {
+            /* Couldn't start a thread, do it here. */
+            coy_memory_prefault_slice(&slices[i]);
+        }
+    }
+
+    u64 end_time = coy_profile_read_os_timer();
+    u64 end_faults = coy_global_os_metrics.initialized ? coy_profile_read_os_page_fault_count() : 0;
+
+    if(stats)
+    {
+        *stats = (CoyPrefaultStats)
+            {
+                .seconds = (f64)(end_time - start_time) / (f64)coy_profile_get_os_timer_freq(),
+                .page_faults = end_faults - start_faults,
+                .num_threads = num_threads
+            };
+    }
+
+    return mem;
+
+FREE_AND_ERR:
+    coy_memory_free(&mem);
+ERR_RETURN:
+    return (CoyMemoryBlock){ .valid = false };
+}
 
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -4,8 +4,11 @@
  *                                               Apple/MacOSX Implementation
  *-------------------------------------------------------------------------------------------------------------------------*/
 // Apple / BSD specific implementation goes here - things NOT in common with Linux
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/syslimits.h>
 #include <unistd.h>
 
@@ -14,6 +17,42 @@
  * gives far LESS control over allocation.
  */
 
+static inline size
+coy_memory_page_size(void)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    StopIf(page_size == -1, return -1);
+    return (size)page_size;
+}
+
+static inline size
+coy_memory_allocation_granularity(void)
+{
+    /* mmap hands out whole pages, however big the request. */
+    return coy_memory_page_size();
+}
+
+static inline void
+coy_memory_hint_huge_pages(void *mem, size num_bytes)
+{
+    /* No transparent huge pages on Apple. */
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_with_flags(size minimum_num_bytes, u32 flags)
+{
+    /* Apple only offers superpages through the Mach VM API, and only on Intel. Just use normal pages. */
+    CoyMemoryBlock mem = coy_memory_allocate(minimum_num_bytes);
+
+    if(mem.valid && (flags & COY_MEMORY_FLAG_LOCKED) && !coy_memory_lock(&mem, false))
+    {
+        coy_memory_free(&mem);
+        return (CoyMemoryBlock){ .valid = false };
+    }
+
+    return mem;
+}
+
 static inline CoyMemoryBlock 
 coy_memory_allocate(size minimum_num_bytes)
 {
@@ -21,7 +60,8 @@ coy_memory_allocate(size minimum_num_bytes)
 
     long page_size = sysconf(_SC_PAGESIZE);
     StopIf(page_size == -1, goto ERR_RETURN);
-    usize nbytes = minimum_num_bytes + page_size - (minimum_num_bytes % page_size);
+    usize nbytes = minimum_num_bytes + page_size - 1;
+    nbytes -= nbytes % page_size;
 
     void *ptr = mmap(NULL,                     // the starting address, NULL = don't care
                      nbytes,                   // the amount of memory to allocate
@@ -32,7 +72,7 @@ coy_memory_allocate(size minimum_num_bytes)
 
     StopIf(ptr == MAP_FAILED, goto ERR_RETURN);
 
-    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .valid = true };
+    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .committed = nbytes, .valid = true };
 
 ERR_RETURN:
     return (CoyMemoryBlock){ .mem = NULL, .size = 0, .valid = false};
@@ -44,10 +84,295 @@ coy_memory_free(CoyMemoryBlock *mem)
     /* int success = */ munmap(mem->mem, (size_t)mem->size);
     mem->mem = NULL;
     mem->size = 0;
+    mem->committed = 0;
     mem->valid = false;
     return;
 }
 
+static inline void
+coy_memory_free_lazily(CoyMemoryBlock *mem)
+{
+    /* The kernel may take the pages back under memory pressure, otherwise they stay mapped and faulted in. */
+    /* int err_code = */ madvise(mem->mem, mem->size, MADV_FREE);
+}
+
+static inline CoyMemoryBlock
+coy_memory_reserve(size minimum_num_bytes)
+{
+    Assert(minimum_num_bytes > 0);
+
+    size page_size = coy_memory_page_size();
+    StopIf(page_size == -1, goto ERR_RETURN);
+    size nbytes = minimum_num_bytes + page_size - 1;
+    nbytes -= nbytes % page_size;
+
+    void *ptr = mmap(NULL,                                    // the starting address, NULL = don't care
+                     nbytes,                                  // the amount of address space to reserve
+                     PROT_NONE,                               // no access until it is committed
+                     MAP_PRIVATE | MAP_ANON | MAP_NORESERVE,  // no backing file, and don't reserve swap space for it
+                     -1,                                      // recommended file descriptor for portability
+                     0);                                      // offset into what? this isn't a file, so should be zero
+
+    StopIf(ptr == MAP_FAILED, goto ERR_RETURN);
+
+    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .committed = 0, .valid = true };
+
+ERR_RETURN:
+    return (CoyMemoryBlock){ .mem = NULL, .size = 0, .valid = false};
+}
+
+static inline b32
+coy_memory_commit(CoyMemoryBlock *mem, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= mem->size);
+    StopIf(!mem->valid, return false);
+
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size end = offset + num_bytes + page_size - 1;
+    end -= end % page_size;
+
+    int err_code = mprotect((byte *)mem->mem + start, end - start, PROT_READ | PROT_WRITE);
+    StopIf(err_code != 0, return false);
+
+    /* Clamped, committing pages that are already committed would count them twice. */
+    mem->committed = mem->committed + (end - start) < mem->size ? mem->committed + (end - start) : mem->size;
+    return true;
+}
+
+static inline b32
+coy_memory_decommit(CoyMemoryBlock *mem, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= mem->size);
+    StopIf(!mem->valid, return false);
+
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size end = offset + num_bytes + page_size - 1;
+    end -= end % page_size;
+
+    /* MADV_DONTNEED doesn't release anything on Apple, so map fresh pages over the range instead. This releases the old
+     * pages and guarantees the range reads back as zeros if it's committed again.
+     */
+    void *ptr = mmap((byte *)mem->mem + start,
+                     end - start,
+                     PROT_NONE,
+                     MAP_FIXED | MAP_PRIVATE | MAP_ANON | MAP_NORESERVE,
+                     -1,
+                     0);
+    StopIf(ptr == MAP_FAILED, return false);
+
+    /* Clamped, decommitting pages that aren't committed would take the count below zero. */
+    mem->committed = mem->committed > end - start ? mem->committed - (end - start) : 0;
+    return true;
+}
+
+static inline b32
+coy_memory_lock(CoyMemoryBlock const *mem, b32 on_fault)
+{
+    /* No lock on fault on Apple, lock it all now. */
+    StopIf(!mem->valid, return false);
+    int err_code = mlock(mem->mem, mem->size);
+    return err_code == 0;
+}
+
+static inline b32
+coy_memory_unlock(CoyMemoryBlock const *mem)
+{
+    StopIf(!mem->valid, return false);
+    int err_code = munlock(mem->mem, mem->size);
+    return err_code == 0;
+}
+
+static inline i32
+coy_numa_node_count(void)
+{
+    /* Macs are all single node. */
+    return 1;
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_numa(size minimum_num_bytes, i32 node)
+{
+    StopIf(node != 0 && node != COY_NUMA_INTERLEAVE, return (CoyMemoryBlock){ .valid = false });
+    return coy_memory_allocate(minimum_num_bytes);
+}
+
+static inline i32
+coy_memory_node(CoyMemoryBlock const *mem)
+{
+    StopIf(!mem->valid || mem->committed == 0, return -1);
+    return 0;
+}
+
+static inline b32
+coy_numa_bind_current_thread(i32 node)
+{
+    return node == 0;
+}
+
+static inline CoyRingBuffer
+coy_ring_buffer_create(size minimum_capacity)
+{
+    Assert(minimum_capacity > 0);
+
+    size page_size = coy_memory_page_size();
+    StopIf(page_size == -1, goto ERR_RETURN);
+    size capacity = minimum_capacity + page_size - 1;
+    capacity -= capacity % page_size;
+
+    /* No memfd on Apple, use a shared memory object with a unique name and unlink it right away. Every thread shares
+     * the counter, and a stale object from an earlier process with the same pid can still hold a name, so try a few.
+     */
+    static u32 counter = 0;
+    int fd = -1;
+    for(i32 attempt = 0; attempt < 8 && fd == -1; ++attempt)
+    {
+        char name[32] = "/coy_ring_";
+        char *c = name + sizeof("/coy_ring_") - 1;
+        u64 unique = ((u64)getpid() << 32) | __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+        for(i32 i = 0; i < 16; ++i) { *c++ = "0123456789abcdef"[(unique >> (60 - 4 * i)) & 0xF]; }
+
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        StopIf(fd == -1 && errno != EEXIST, goto ERR_RETURN);
+        if(fd != -1) { shm_unlink(name); }
+    }
+    StopIf(fd == -1, goto ERR_RETURN);
+
+    int err_code = ftruncate(fd, capacity);
+    StopIf(err_code != 0, goto ERR_CLOSE);
+
+    /* Reserve room for both copies, then map the object over each half. */
+    byte *buf = mmap(NULL, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    StopIf(buf == MAP_FAILED, goto ERR_CLOSE);
+
+    void *first = mmap(buf, capacity, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0);
+    StopIf(first == MAP_FAILED, goto ERR_UNMAP);
+    void *second = mmap(buf + capacity, capacity, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0);
+    StopIf(second == MAP_FAILED, goto ERR_UNMAP);
+
+    /* The mappings keep the memory alive. */
+    close(fd);
+
+    return (CoyRingBuffer){ .buf = buf, .capacity = capacity, .valid = true };
+
+ERR_UNMAP:
+    munmap(buf, 2 * capacity);
+ERR_CLOSE:
+    close(fd);
+ERR_RETURN:
+    return (CoyRingBuffer){ .valid = false };
+}
+
+static inline void
+coy_ring_buffer_destroy(CoyRingBuffer *ring)
+{
+    /* int err_code = */ munmap(ring->buf, 2 * ring->capacity);
+    ring->valid = false;
+}
+
+static inline b32
+coy_file_allocate_handle(iptr handle, size num_bytes)
+{
+    /* Try to get contiguous space first, then just set the size. */
+    struct stat statbuf = {0};
+    StopIf(fstat((int)handle, &statbuf) != 0, return false);
+    if(num_bytes > statbuf.st_size)
+    {
+        fstore_t store = { .fst_flags = F_ALLOCATECONTIG, .fst_posmode = F_PEOFPOSMODE, .fst_length = num_bytes - statbuf.st_size };
+        if(fcntl((int)handle, F_PREALLOCATE, &store) == -1)
+        {
+            store.fst_flags = F_ALLOCATEALL;
+            fcntl((int)handle, F_PREALLOCATE, &store);
+        }
+    }
+
+    int err_code = ftruncate((int)handle, (off_t)num_bytes);
+    return err_code == 0;
+}
+
+static inline b32
+coy_memmap_grow(CoyMemMappedFile *file, size new_size)
+{
+    Assert(new_size >= file->size_in_bytes);
+    StopIf(!file->valid || !file->writable, return false);
+    if(new_size == file->size_in_bytes) { return true; }
+
+    StopIf(!coy_file_allocate_handle(file->_internal[0], new_size), return false);
+
+    /* No mremap on Apple, map the bigger file and drop the old mapping. The data lives in the file, nothing is copied. */
+    byte *data = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, (int)file->_internal[0], 0);
+    StopIf(data == MAP_FAILED, return false);
+    munmap(file->writable_data, file->size_in_bytes);
+
+    file->writable_data = data;
+    file->size_in_bytes = new_size;
+    return true;
+}
+
+static inline b32
+coy_file_advise(CoyFileReader *file, CoyAccessHint hint, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0);
+    StopIf(!file->valid, return false);
+
+    /* No posix_fadvise on Apple, but fcntl can turn read ahead on and off, and read ahead a range. */
+    int err_code = 0;
+    switch(hint)
+    {
+        case COY_ACCESS_NORMAL:
+        case COY_ACCESS_SEQUENTIAL: { err_code = fcntl((int)file->handle, F_RDAHEAD, 1); } break;
+        case COY_ACCESS_RANDOM:     { err_code = fcntl((int)file->handle, F_RDAHEAD, 0); } break;
+        case COY_ACCESS_DONTNEED:   { /* Nothing to do it with. */ } break;
+
+        case COY_ACCESS_WILLNEED:
+        {
+            if(num_bytes == 0)
+            {
+                struct stat statbuf = {0};
+                StopIf(fstat((int)file->handle, &statbuf) != 0, return false);
+                num_bytes = statbuf.st_size > offset ? statbuf.st_size - offset : 0;
+            }
+
+            /* ra_count is an int, so do it in pieces. */
+            while(num_bytes > 0 && err_code != -1)
+            {
+                int count = num_bytes > INT32_MAX ? INT32_MAX : (int)num_bytes;
+                struct radvisory advice = { .ra_offset = (off_t)offset, .ra_count = count };
+                err_code = fcntl((int)file->handle, F_RDADVISE, &advice);
+                offset += count;
+                num_bytes -= count;
+            }
+        } break;
+    }
+
+    return err_code != -1;
+}
+
+static inline b32
+coy_async_uring_create(CoyAsyncFile *file)
+{
+    /* No io_uring on Apple, the thread pool does all the work. */
+    return false;
+}
+
+static inline i32
+coy_async_uring_submit(CoyAsyncFile *file)
+{
+    return 0;
+}
+
+static inline i32
+coy_async_uring_reap(CoyAsyncFile *file, i32 max_slots, i32 *slots, b32 wait)
+{
+    return -1;
+}
+
+static inline void
+coy_async_uring_destroy(CoyAsyncFile *file)
+{
+}
+
 static inline void 
 coy_profile_initialize_os_metrics(void)
 {
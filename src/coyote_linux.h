@@ -4,7 +4,17 @@
  *                                                  Linux Implementation
  *-------------------------------------------------------------------------------------------------------------------------*/
 // Linux specific implementation goes here - things NOT in common with Apple / BSD
+#include <errno.h>
 #include <fcntl.h>
+#if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    define COY_HAVE_IO_URING 1
+#  endif
+#else
+#  include <linux/io_uring.h>
+#  define COY_HAVE_IO_URING 1
+#endif
 #include <linux/perf_event.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -18,6 +28,148 @@
  * Apple. This flag pre-faults all the pages, so you don't have to worry about page faults slowing down the program.
  */
 
+/* Older headers may not have these. */
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#ifndef MLOCK_ONFAULT
+#define MLOCK_ONFAULT 0x01
+#endif
+
+/* The kernel header can be newer than the C library's syscall list. */
+#ifndef SYS_io_uring_setup
+#define SYS_io_uring_setup 425
+#define SYS_io_uring_enter 426
+#endif
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifndef MREMAP_MAYMOVE
+#define MREMAP_MAYMOVE 1
+#endif
+
+static inline size
+coy_memory_page_size(void)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    StopIf(page_size == -1, return -1);
+    return (size)page_size;
+}
+
+static inline size
+coy_memory_allocation_granularity(void)
+{
+    /* mmap hands out whole pages, however big the request. */
+    return coy_memory_page_size();
+}
+
+static inline void
+coy_memory_hint_huge_pages(void *mem, size num_bytes)
+{
+    /* Just a hint, if the kernel doesn't support it for this mapping that's ok. */
+    /* int err_code = */ madvise(mem, num_bytes, MADV_HUGEPAGE);
+}
+
+static inline void
+coy_memory_populate(void *mem, usize num_bytes)
+{
+    int err_code = madvise(mem, num_bytes, MADV_POPULATE_WRITE);
+    if(err_code != 0)
+    {
+        /* Kernel older than 5.14, touch the pages by hand. */
+        size page_size = coy_memory_page_size();
+        for(usize i = 0; i < num_bytes; i += page_size) { ((byte volatile *)mem)[i] = 0; }
+    }
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_huge_explicit(size minimum_num_bytes, size huge_page_size, int huge_flag)
+{
+    usize nbytes = minimum_num_bytes + huge_page_size - 1;
+    nbytes -= nbytes % huge_page_size;
+
+    void *ptr = mmap(NULL,                                                         // OS chooses
+                     nbytes,                                                       // multiple of the huge page size
+                     PROT_READ | PROT_WRITE,                                       // read / write access
+                     MAP_PRIVATE | MAP_ANON | MAP_POPULATE | MAP_HUGETLB | huge_flag, // from the huge page pool
+                     -1,                                                           // no file
+                     0);                                                           // no offset
+
+    StopIf(ptr == MAP_FAILED, return (CoyMemoryBlock){ .valid = false });
+
+    CoyMemoryPageKind kind = huge_page_size == COY_GiB(1) ? COY_MEMORY_PAGES_HUGE_1GiB : COY_MEMORY_PAGES_HUGE_2MiB;
+    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .committed = nbytes, .page_kind = kind, .valid = true };
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_huge_transparent(size minimum_num_bytes)
+{
+    size const huge_page_size = COY_MiB(2);
+    usize nbytes = minimum_num_bytes + huge_page_size - 1;
+    nbytes -= nbytes % huge_page_size;
+
+    /* Over allocate so the block can be aligned to a huge page boundary, THP only works on aligned ranges. */
+    usize map_size = nbytes + huge_page_size;
+    byte *ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    StopIf(ptr == MAP_FAILED, goto ERR_RETURN);
+
+    byte *aligned = (byte *)(((uptr)ptr + huge_page_size - 1) & ~(uptr)(huge_page_size - 1));
+    usize front = aligned - ptr;
+    usize back = map_size - front - nbytes;
+    if(front) { munmap(ptr, front); }
+    if(back) { munmap(aligned + nbytes, back); }
+
+    CoyMemoryPageKind kind = COY_MEMORY_PAGES_TRANSPARENT_HUGE;
+    int err_code = madvise(aligned, nbytes, MADV_HUGEPAGE);
+    if(err_code != 0) { kind = COY_MEMORY_PAGES_NORMAL; }
+
+    /* Pre-fault now that the kernel knows it can use huge pages, MAP_POPULATE would have used small pages. */
+    coy_memory_populate(aligned, nbytes);
+
+    return (CoyMemoryBlock){ .mem = aligned, .size = nbytes, .committed = nbytes, .page_kind = kind, .valid = true };
+
+ERR_RETURN:
+    return (CoyMemoryBlock){ .mem = NULL, .size = 0, .valid = false};
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_with_flags(size minimum_num_bytes, u32 flags)
+{
+    Assert(minimum_num_bytes > 0);
+
+    CoyMemoryBlock mem = { .valid = false };
+    b32 huge = (flags & (COY_MEMORY_FLAG_HUGE_PAGES | COY_MEMORY_FLAG_HUGE_PAGES_1GiB)) != 0;
+
+    if(flags & COY_MEMORY_FLAG_HUGE_PAGES_1GiB)
+    {
+        mem = coy_memory_allocate_huge_explicit(minimum_num_bytes, COY_GiB(1), MAP_HUGE_1GB);
+    }
+
+    if(huge && !mem.valid) { mem = coy_memory_allocate_huge_explicit(minimum_num_bytes, COY_MiB(2), MAP_HUGE_2MB); }
+    if(huge && !mem.valid) { mem = coy_memory_allocate_huge_transparent(minimum_num_bytes); }
+    if(!huge) { mem = coy_memory_allocate(minimum_num_bytes); }
+
+    /* Not MAP_LOCKED, it silently ignores hitting the lock limit. */
+    if(mem.valid && (flags & COY_MEMORY_FLAG_LOCKED) && !coy_memory_lock(&mem, false))
+    {
+        coy_memory_free(&mem);
+        return (CoyMemoryBlock){ .valid = false };
+    }
+
+    return mem;
+}
+
 static inline CoyMemoryBlock 
 coy_memory_allocate(size minimum_num_bytes)
 {
@@ -25,7 +177,8 @@ coy_memory_allocate(size minimum_num_bytes)
 
     long page_size = sysconf(_SC_PAGESIZE);
     StopIf(page_size == -1, goto ERR_RETURN);
-    usize nbytes = minimum_num_bytes + page_size - (minimum_num_bytes % page_size);
+    usize nbytes = minimum_num_bytes + page_size - 1;
+    nbytes -= nbytes % page_size;
 
     void *ptr = mmap(NULL,                                    // the starting address, NULL = don't care
                      nbytes,                                  // the amount of memory to allocate
@@ -36,7 +189,7 @@ coy_memory_allocate(size minimum_num_bytes)
 
     StopIf(ptr == MAP_FAILED, goto ERR_RETURN);
 
-    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .valid = true };
+    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .committed = nbytes, .valid = true };
 
 ERR_RETURN:
     return (CoyMemoryBlock){ .mem = NULL, .size = 0, .valid = false};
@@ -50,6 +203,617 @@ coy_memory_free(CoyMemoryBlock *mem)
     return;
 }
 
+static inline void
+coy_memory_free_lazily(CoyMemoryBlock *mem)
+{
+    /* The kernel may take the pages back under memory pressure, otherwise they stay mapped and faulted in. */
+    int err_code = madvise(mem->mem, mem->size, MADV_FREE);
+    if(err_code != 0)
+    {
+        /* Kernel older than 4.5, nothing lazy about it. */
+        madvise(mem->mem, mem->size, MADV_DONTNEED);
+    }
+}
+
+static inline CoyMemoryBlock
+coy_memory_reserve(size minimum_num_bytes)
+{
+    Assert(minimum_num_bytes > 0);
+
+    size page_size = coy_memory_page_size();
+    StopIf(page_size == -1, goto ERR_RETURN);
+    size nbytes = minimum_num_bytes + page_size - 1;
+    nbytes -= nbytes % page_size;
+
+    void *ptr = mmap(NULL,                                    // the starting address, NULL = don't care
+                     nbytes,                                  // the amount of address space to reserve
+                     PROT_NONE,                               // no access until it is committed
+                     MAP_PRIVATE | MAP_ANON | MAP_NORESERVE,  // no backing file, and don't reserve swap space for it
+                     -1,                                      // recommended file descriptor for portability
+                     0);                                      // offset into what? this isn't a file, so should be zero
+
+    StopIf(ptr == MAP_FAILED, goto ERR_RETURN);
+
+    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .committed = 0, .valid = true };
+
+ERR_RETURN:
+    return (CoyMemoryBlock){ .mem = NULL, .size = 0, .valid = false};
+}
+
+static inline b32
+coy_memory_commit(CoyMemoryBlock *mem, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= mem->size);
+    StopIf(!mem->valid, return false);
+
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size end = offset + num_bytes + page_size - 1;
+    end -= end % page_size;
+
+    int err_code = mprotect((byte *)mem->mem + start, end - start, PROT_READ | PROT_WRITE);
+    StopIf(err_code != 0, return false);
+
+    /* Clamped, committing pages that are already committed would count them twice. */
+    mem->committed = mem->committed + (end - start) < mem->size ? mem->committed + (end - start) : mem->size;
+    return true;
+}
+
+static inline b32
+coy_memory_decommit(CoyMemoryBlock *mem, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= mem->size);
+    StopIf(!mem->valid, return false);
+
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size end = offset + num_bytes + page_size - 1;
+    end -= end % page_size;
+
+    /* Give the pages back to the OS first, private anonymous pages read back as zeros after MADV_DONTNEED. */
+    int err_code = madvise((byte *)mem->mem + start, end - start, MADV_DONTNEED);
+    StopIf(err_code != 0, return false);
+    err_code = mprotect((byte *)mem->mem + start, end - start, PROT_NONE);
+    StopIf(err_code != 0, return false);
+
+    /* Clamped, decommitting pages that aren't committed would take the count below zero. */
+    mem->committed = mem->committed > end - start ? mem->committed - (end - start) : 0;
+    return true;
+}
+
+static inline b32
+coy_memory_lock(CoyMemoryBlock const *mem, b32 on_fault)
+{
+    StopIf(!mem->valid, return false);
+
+    if(on_fault)
+    {
+        long err_code = syscall(SYS_mlock2, mem->mem, mem->size, MLOCK_ONFAULT);
+        if(err_code == 0) { return true; }
+
+        /* Kernel older than 4.4 (or over the limit, and this fails too), lock it all now. */
+    }
+
+    int err_code = mlock(mem->mem, mem->size);
+    return err_code == 0;
+}
+
+static inline b32
+coy_memory_unlock(CoyMemoryBlock const *mem)
+{
+    StopIf(!mem->valid, return false);
+    int err_code = munlock(mem->mem, mem->size);
+    return err_code == 0;
+}
+
+/* From linux/mempolicy.h, which is an enum so it can't be checked with #ifndef. */
+#define COY_MPOL_PREFERRED 1
+#define COY_MPOL_INTERLEAVE 3
+#define COY_MPOL_F_NODE (1 << 0)
+#define COY_MPOL_F_ADDR (1 << 1)
+#define COY_MPOL_F_MEMS_ALLOWED (1 << 2)
+
+/* Big enough for any kernel config, CONFIG_NODES_SHIFT tops out at 10. Also used for the CPU mask. */
+#define COY_NUMA_MAX_NODES 1024
+#define COY_NUMA_MASK_WORDS (COY_NUMA_MAX_NODES / 64)
+
+/* The kernel drops the last bit of maxnode (libnuma passes + 1 too), so pass one more than the bits in the mask. */
+#define COY_NUMA_MAXNODE_ARG (COY_NUMA_MAX_NODES + 1)
+
+static inline b32
+coy_numa_allowed_nodes(u64 mask[COY_NUMA_MASK_WORDS])
+{
+    long err_code = syscall(SYS_get_mempolicy, NULL, mask, COY_NUMA_MAXNODE_ARG, NULL, COY_MPOL_F_MEMS_ALLOWED);
+    return err_code == 0;
+}
+
+static inline i32
+coy_numa_node_count(void)
+{
+    u64 mask[COY_NUMA_MASK_WORDS] = {0};
+
+    /* Fails with ENOSYS on kernels built without NUMA support, that's a single node. */
+    if(!coy_numa_allowed_nodes(mask)) { return 1; }
+
+    i32 count = 1;
+    for(i32 node = 0; node < COY_NUMA_MAX_NODES; ++node)
+    {
+        if(mask[node / 64] & (UINT64_C(1) << (node % 64))) { count = node + 1; }
+    }
+
+    return count;
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_numa(size minimum_num_bytes, i32 node)
+{
+    Assert(minimum_num_bytes > 0);
+
+    i32 num_nodes = coy_numa_node_count();
+    StopIf(node < COY_NUMA_INTERLEAVE || node >= num_nodes, goto ERR_RETURN);
+    if(num_nodes == 1) { return coy_memory_allocate(minimum_num_bytes); }
+
+    size page_size = coy_memory_page_size();
+    StopIf(page_size == -1, goto ERR_RETURN);
+    usize nbytes = minimum_num_bytes + page_size - 1;
+    nbytes -= nbytes % page_size;
+
+    /* No MAP_POPULATE, the policy has to be set before the pages are faulted in. */
+    void *ptr = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    StopIf(ptr == MAP_FAILED, goto ERR_RETURN);
+
+    u64 mask[COY_NUMA_MASK_WORDS] = {0};
+    int mode = COY_MPOL_PREFERRED;
+    if(node == COY_NUMA_INTERLEAVE)
+    {
+        mode = COY_MPOL_INTERLEAVE;
+        StopIf(!coy_numa_allowed_nodes(mask), goto ERR_UNMAP);
+    }
+    else
+    {
+        mask[node / 64] = UINT64_C(1) << (node % 64);
+    }
+
+    long err_code = syscall(SYS_mbind, ptr, nbytes, mode, mask, COY_NUMA_MAXNODE_ARG, 0);
+    StopIf(err_code != 0, goto ERR_UNMAP);
+
+    coy_memory_populate(ptr, nbytes);
+
+    return (CoyMemoryBlock){ .mem = ptr, .size = nbytes, .committed = nbytes, .valid = true };
+
+ERR_UNMAP:
+    munmap(ptr, nbytes);
+ERR_RETURN:
+    return (CoyMemoryBlock){ .mem = NULL, .size = 0, .valid = false};
+}
+
+static inline i32
+coy_memory_node(CoyMemoryBlock const *mem)
+{
+    StopIf(!mem->valid || mem->committed == 0, return -1);
+
+    int node = -1;
+    long err_code = syscall(SYS_get_mempolicy, &node, NULL, 0, mem->mem, COY_MPOL_F_NODE | COY_MPOL_F_ADDR);
+    if(err_code != 0)
+    {
+        /* No NUMA support in the kernel means everything is on node 0. */
+        return coy_numa_node_count() == 1 ? 0 : -1;
+    }
+
+    return node;
+}
+
+static inline b32
+coy_numa_bind_current_thread(i32 node)
+{
+    i32 num_nodes = coy_numa_node_count();
+    StopIf(node < 0 || node >= num_nodes, return false);
+    if(num_nodes == 1) { return true; }
+
+    /* Build "/sys/devices/system/node/node<N>/cpulist" back to front. */
+    char path[64] = {0};
+    char *p = path + sizeof(path) - 1;
+    char const suffix[] = "/cpulist";
+    p -= sizeof(suffix) - 1;
+    memcpy(p, suffix, sizeof(suffix) - 1);
+    i32 n = node;
+    do { *--p = '0' + n % 10; n /= 10; } while(n > 0);
+    char const prefix[] = "/sys/devices/system/node/node";
+    p -= sizeof(prefix) - 1;
+    memcpy(p, prefix, sizeof(prefix) - 1);
+
+    /* The CPUs on the node are listed as ranges, e.g. "0-7,16-23". */
+    char cpulist[1024] = {0};
+    int fd = open(p, O_RDONLY);
+    StopIf(fd == -1, return false);
+    ssize_t nbytes = read(fd, cpulist, sizeof(cpulist) - 1);
+    close(fd);
+    StopIf(nbytes <= 0, return false);
+
+    u64 cpus[COY_NUMA_MASK_WORDS] = {0};
+    char const *c = cpulist;
+    while(*c >= '0' && *c <= '9')
+    {
+        i32 first = 0;
+        while(*c >= '0' && *c <= '9') { first = first * 10 + (*c++ - '0'); }
+
+        i32 last = first;
+        if(*c == '-')
+        {
+            ++c;
+            last = 0;
+            while(*c >= '0' && *c <= '9') { last = last * 10 + (*c++ - '0'); }
+        }
+
+        for(i32 cpu = first; cpu <= last && cpu < COY_NUMA_MAX_NODES; ++cpu)
+        {
+            cpus[cpu / 64] |= UINT64_C(1) << (cpu % 64);
+        }
+
+        if(*c == ',') { ++c; }
+    }
+
+    /* pid 0 means the calling thread for both of these. */
+    long err_code = syscall(SYS_sched_setaffinity, 0, sizeof(cpus), cpus);
+    StopIf(err_code != 0, return false);
+
+    u64 mask[COY_NUMA_MASK_WORDS] = {0};
+    mask[node / 64] = UINT64_C(1) << (node % 64);
+    err_code = syscall(SYS_set_mempolicy, COY_MPOL_PREFERRED, mask, COY_NUMA_MAXNODE_ARG);
+    StopIf(err_code != 0, return false);
+
+    return true;
+}
+
+static inline CoyRingBuffer
+coy_ring_buffer_create(size minimum_capacity)
+{
+    Assert(minimum_capacity > 0);
+
+    size page_size = coy_memory_page_size();
+    StopIf(page_size == -1, goto ERR_RETURN);
+    size capacity = minimum_capacity + page_size - 1;
+    capacity -= capacity % page_size;
+
+    /* Anonymous memory that can be mapped more than once. */
+    int fd = syscall(SYS_memfd_create, "coyote_ring_buffer", MFD_CLOEXEC);
+    StopIf(fd == -1, goto ERR_RETURN);
+    int err_code = ftruncate(fd, capacity);
+    StopIf(err_code != 0, goto ERR_CLOSE);
+
+    /* Reserve room for both copies, then map the file over each half. */
+    byte *buf = mmap(NULL, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+    StopIf(buf == MAP_FAILED, goto ERR_CLOSE);
+
+    void *first = mmap(buf, capacity, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0);
+    StopIf(first == MAP_FAILED, goto ERR_UNMAP);
+    void *second = mmap(buf + capacity, capacity, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0);
+    StopIf(second == MAP_FAILED, goto ERR_UNMAP);
+
+    /* The mappings keep the memory alive. */
+    close(fd);
+
+    return (CoyRingBuffer){ .buf = buf, .capacity = capacity, .valid = true };
+
+ERR_UNMAP:
+    munmap(buf, 2 * capacity);
+ERR_CLOSE:
+    close(fd);
+ERR_RETURN:
+    return (CoyRingBuffer){ .valid = false };
+}
+
+static inline void
+coy_ring_buffer_destroy(CoyRingBuffer *ring)
+{
+    /* int err_code = */ munmap(ring->buf, 2 * ring->capacity);
+    ring->valid = false;
+}
+
+typedef struct
+{
+    int fd;
+
+    u32 *sq_head;
+    u32 *sq_tail;
+    u32 *sq_mask;
+    u32 *sq_array;
+    struct io_uring_sqe *sqes;
+
+    u32 *cq_head;
+    u32 *cq_tail;
+    u32 *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size sq_ring_size;
+    void *cq_ring;
+    size cq_ring_size;
+    size sqes_size;
+} CoyIoUring;
+
+_Static_assert(sizeof(CoyIoUring) <= sizeof(((CoyAsyncFile *)0)->uring), "CoyIoUring doesn't fit in CoyAsyncFile");
+
+static inline b32
+coy_file_allocate_handle(iptr handle, size num_bytes)
+{
+    /* Really allocate the blocks, so running out of disk space fails here instead of with a SIGBUS in a mapping. Not
+     * every file system can, fall back to a sparse file on those.
+     */
+    long err_code = syscall(SYS_fallocate, (int)handle, 0, (off_t)0, (off_t)num_bytes);
+    if(err_code != 0 && errno == EOPNOTSUPP) { err_code = ftruncate((int)handle, (off_t)num_bytes); }
+    return err_code == 0;
+}
+
+static inline b32
+coy_memmap_grow(CoyMemMappedFile *file, size new_size)
+{
+    Assert(new_size >= file->size_in_bytes);
+    StopIf(!file->valid || !file->writable, return false);
+    if(new_size == file->size_in_bytes) { return true; }
+
+    StopIf(!coy_file_allocate_handle(file->_internal[0], new_size), return false);
+
+    /* Grows in place if it can, otherwise moves the mapping without copying anything. */
+    void *data = (void *)syscall(SYS_mremap, file->writable_data, file->size_in_bytes, new_size, MREMAP_MAYMOVE);
+    StopIf(data == MAP_FAILED, return false);
+
+    file->writable_data = data;
+    file->size_in_bytes = new_size;
+    return true;
+}
+
+static inline b32
+coy_file_advise(CoyFileReader *file, CoyAccessHint hint, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0);
+    StopIf(!file->valid, return false);
+
+    int advice = POSIX_FADV_NORMAL;
+    switch(hint)
+    {
+        case COY_ACCESS_NORMAL:     advice = POSIX_FADV_NORMAL;     break;
+        case COY_ACCESS_SEQUENTIAL: advice = POSIX_FADV_SEQUENTIAL; break;
+        case COY_ACCESS_RANDOM:     advice = POSIX_FADV_RANDOM;     break;
+        case COY_ACCESS_WILLNEED:   advice = POSIX_FADV_WILLNEED;   break;
+        case COY_ACCESS_DONTNEED:   advice = POSIX_FADV_DONTNEED;   break;
+    }
+
+    /* Returns the error code instead of setting errno. */
+    int err_code = posix_fadvise((int)file->handle, (off_t)offset, (off_t)num_bytes, advice);
+    return err_code == 0;
+}
+
+#if COY_HAVE_IO_URING
+
+static inline b32
+coy_async_uring_create(CoyAsyncFile *file)
+{
+    CoyIoUring *ring = (CoyIoUring *)file->uring;
+
+    struct io_uring_params params = {0};
+    int fd = syscall(SYS_io_uring_setup, COY_ASYNC_QUEUE_DEPTH, &params);
+    StopIf(fd < 0, return false); /* Old kernel, or disabled by the admin or a seccomp filter. */
+
+    /* IORING_OP_READ and IORING_OP_WRITE came in the same release (5.6) as this feature bit. */
+    StopIf(!(params.features & IORING_FEAT_RW_CUR_POS), goto ERR_CLOSE);
+
+    size sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    size cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    b32 single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single_mmap)
+    {
+        if(cq_ring_size > sq_ring_size) { sq_ring_size = cq_ring_size; }
+        cq_ring_size = sq_ring_size;
+    }
+
+    byte *sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    StopIf(sq_ring == MAP_FAILED, goto ERR_CLOSE);
+
+    byte *cq_ring = sq_ring;
+    if(!single_mmap)
+    {
+        cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        StopIf(cq_ring == MAP_FAILED, goto ERR_UNMAP_SQ);
+    }
+
+    size sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    struct io_uring_sqe *sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    StopIf(sqes == MAP_FAILED, goto ERR_UNMAP_CQ);
+
+    *ring = (CoyIoUring)
+        {
+            .fd = fd,
+            .sq_head = (u32 *)(sq_ring + params.sq_off.head),
+            .sq_tail = (u32 *)(sq_ring + params.sq_off.tail),
+            .sq_mask = (u32 *)(sq_ring + params.sq_off.ring_mask),
+            .sq_array = (u32 *)(sq_ring + params.sq_off.array),
+            .sqes = sqes,
+            .cq_head = (u32 *)(cq_ring + params.cq_off.head),
+            .cq_tail = (u32 *)(cq_ring + params.cq_off.tail),
+            .cq_mask = (u32 *)(cq_ring + params.cq_off.ring_mask),
+            .cqes = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes),
+            .sq_ring = sq_ring,
+            .sq_ring_size = sq_ring_size,
+            .cq_ring = cq_ring,
+            .cq_ring_size = single_mmap ? 0 : cq_ring_size,
+            .sqes_size = sqes_size
+        };
+
+    return true;
+
+ERR_UNMAP_CQ:
+    if(!single_mmap) { munmap(cq_ring, cq_ring_size); }
+ERR_UNMAP_SQ:
+    munmap(sq_ring, sq_ring_size);
+ERR_CLOSE:
+    close(fd);
+    return false;
+}
+
+static inline void
+coy_async_uring_push(CoyAsyncFile *file, u32 tail, i32 slot)
+{
+    CoyIoUring *ring = (CoyIoUring *)file->uring;
+    CoyAsyncRequest *req = &file->requests[slot];
+
+    /* Picks up after whatever part of the request is already done. */
+    u32 idx = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = (int)file->handle;
+    sqe->off = (u64)(req->offset + req->num_done);
+    sqe->addr = (u64)(uptr)(req->buffer + req->num_done);
+    sqe->len = (u32)(req->num_bytes - req->num_done); /* coy_async_file_queue made sure it fits. */
+    sqe->user_data = (u64)slot;
+
+    ring->sq_array[idx] = idx;
+}
+
+static inline i32
+coy_async_uring_enter(CoyIoUring *ring, u32 tail, i32 to_submit)
+{
+    /* Only this thread writes the tail, the kernel moves the head. The ring has room for every slot, so it can't overflow. */
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    i32 num_left = to_submit;
+    while(num_left > 0)
+    {
+        long num_submitted = syscall(SYS_io_uring_enter, ring->fd, num_left, 0, 0, NULL, 0);
+        if(num_submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            /* The kernel only takes entries inside io_uring_enter, so the ones it didn't take can be pulled back out of
+             * the ring. Otherwise the next enter would submit them behind the caller's back.
+             */
+            __atomic_store_n(ring->sq_tail, __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+            break;
+        }
+        if(num_submitted > 0) { num_left -= num_submitted; }
+    }
+
+    return to_submit - num_left;
+}
+
+static inline i32
+coy_async_uring_submit(CoyAsyncFile *file)
+{
+    CoyIoUring *ring = (CoyIoUring *)file->uring;
+
+    u32 tail = *ring->sq_tail;
+    for(i32 i = 0; i < file->num_queued; ++i)
+    {
+        coy_async_uring_push(file, tail++, file->queued[i]);
+    }
+
+    return coy_async_uring_enter(ring, tail, file->num_queued);
+}
+
+static inline i32
+coy_async_uring_reap(CoyAsyncFile *file, i32 max_slots, i32 *slots, b32 wait)
+{
+    CoyIoUring *ring = (CoyIoUring *)file->uring;
+
+    i32 num_reaped = 0;
+    while(true)
+    {
+        i32 resubmit[COY_ASYNC_QUEUE_DEPTH];
+        i32 num_resubmit = 0;
+
+        u32 head = *ring->cq_head;
+        u32 tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        u32 mask = *ring->cq_mask;
+        /* Resubmits count against max_slots, if one can't go back in it's reported as an error right here. */
+        while(head != tail && num_reaped + num_resubmit < max_slots)
+        {
+            struct io_uring_cqe *cqe = &ring->cqes[head & mask];
+            i32 slot = (i32)cqe->user_data;
+            CoyAsyncRequest *req = &file->requests[slot];
+            head++;
+
+            if(cqe->res < 0)
+            {
+                req->result = -1;
+                slots[num_reaped++] = slot;
+                continue;
+            }
+
+            /* Short reads and writes happen before the end of the file too, keep going like the thread pool does. A
+             * read that gets nothing is at the end of the file.
+             */
+            req->num_done += cqe->res;
+            if(cqe->res > 0 && req->num_done < req->num_bytes)
+            {
+                resubmit[num_resubmit++] = slot;
+                continue;
+            }
+
+            req->result = req->num_done;
+            slots[num_reaped++] = slot;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        if(num_resubmit > 0)
+        {
+            u32 sq_tail = *ring->sq_tail;
+            for(i32 i = 0; i < num_resubmit; ++i) { coy_async_uring_push(file, sq_tail++, resubmit[i]); }
+            i32 num_submitted = coy_async_uring_enter(ring, sq_tail, num_resubmit);
+
+            /* The ones that couldn't go back in are done, with an error. */
+            for(i32 i = num_submitted; i < num_resubmit; ++i)
+            {
+                file->requests[resubmit[i]].result = -1;
+                slots[num_reaped++] = resubmit[i];
+            }
+        }
+
+        if(num_reaped > 0 || !wait) { break; }
+
+        long err_code = syscall(SYS_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        StopIf(err_code < 0 && errno != EINTR, return -1);
+    }
+
+    return num_reaped;
+}
+
+static inline void
+coy_async_uring_destroy(CoyAsyncFile *file)
+{
+    CoyIoUring *ring = (CoyIoUring *)file->uring;
+    munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ring_size) { munmap(ring->cq_ring, ring->cq_ring_size); }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+#else
+
+static inline b32
+coy_async_uring_create(CoyAsyncFile *file)
+{
+    /* Built without the io_uring header, the thread pool does all the work. */
+    return false;
+}
+
+static inline i32
+coy_async_uring_submit(CoyAsyncFile *file)
+{
+    return 0;
+}
+
+static inline i32
+coy_async_uring_reap(CoyAsyncFile *file, i32 max_slots, i32 *slots, b32 wait)
+{
+    return -1;
+}
+
+static inline void
+coy_async_uring_destroy(CoyAsyncFile *file)
+{
+}
+
+#endif
+
 static inline void 
 coy_profile_initialize_os_metrics(void)
 {
@@ -62,12 +826,11 @@ coy_profile_initialize_os_metrics(void)
         pe.config = PERF_COUNT_SW_PAGE_FAULTS;
         pe.disabled = 1;
         pe.exclude_kernel = 0; /* Turns out most page faults happen here */
+        pe.inherit = 1;        /* Count threads started later too, like the process wide counters on Apple & Windows */
 
         fd = syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
-        if (fd == -1) {
-            /* Might need to run with sudo, crash! */
-            (*(int volatile*)0);
-        }
+        /* Not allowed (see /proc/sys/kernel/perf_event_paranoid), stay uninitialized so nothing reads the counter. */
+        StopIf(fd == -1, return);
 
         ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
 
@@ -12,6 +12,7 @@
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <x86intrin.h>
 #include <unistd.h>
 #include <dlfcn.h>
@@ -148,7 +149,7 @@ ERR_RETURN:
 }
 
 static inline CoyFileWriter
-coy_file_create(char const *filename)
+coy_file_create_with_buffer(char const *filename, size buf_size, byte *buffer)
 {
     int fd = open( filename,                                        // char const *pathname
                    O_WRONLY | O_CREAT | O_TRUNC,                    // Write only, create if needed, or truncate if needed.
@@ -156,7 +157,7 @@ coy_file_create(char const *filename)
 
     if (fd >= 0)
     {
-        return (CoyFileWriter){ .handle = (iptr) fd, .valid = true  };
+        return (CoyFileWriter){ .handle = (iptr) fd, .buffer = buffer, .buf_size = buf_size, .valid = true  };
     }
     else
     {
@@ -165,14 +166,14 @@ coy_file_create(char const *filename)
 }
 
 static inline CoyFileWriter
-coy_file_append(char const *filename)
+coy_file_append_with_buffer(char const *filename, size buf_size, byte *buffer)
 {
     int fd = open( filename,                                        // char const *pathname
                    O_WRONLY | O_CREAT | O_APPEND,                   // Write only, create if needed, and append.
                    S_IRWXU | S_IRGRP | S_IXGRP |S_IROTH | S_IXOTH); // Default permissions 0755
 
     if (fd >= 0) {
-        return (CoyFileWriter){ .handle = (iptr) fd, .valid = true  };
+        return (CoyFileWriter){ .handle = (iptr) fd, .buffer = buffer, .buf_size = buf_size, .valid = true  };
     }
     else
     {
@@ -184,6 +185,7 @@ static inline size
 coy_file_writer_flush(CoyFileWriter *file)
 {
     StopIf(!file->valid, goto ERR_RETURN);
+    if(file->background) { return coy_file_writer_flush_background(file); }
 
     _Static_assert(sizeof(ssize_t) == sizeof(size), "oh come on people. ssize_t != intptr_t!? Really!");
 
@@ -205,17 +207,18 @@ static inline size
 coy_file_write(CoyFileWriter *file, size nbytes_to_write, byte const *buffer)
 {
     Assert(nbytes_to_write >= 0);
+    if(file->background) { return coy_file_write_background(file, nbytes_to_write, buffer); }
     size num_bytes_written = 0;
 
     /* Check if we need to flush the buffer */
-    if(nbytes_to_write > (COY_FILE_WRITER_BUF_SIZE - file->buf_cursor))
+    if(nbytes_to_write > (file->buf_size - file->buf_cursor))
     {
         num_bytes_written = coy_file_writer_flush(file);
         StopIf(num_bytes_written < 0, goto ERR_RETURN);
     }
 
     /* For "small" writes, buffer the data. */
-    if(nbytes_to_write < COY_FILE_WRITER_BUF_SIZE)
+    if(nbytes_to_write < file->buf_size)
     {
         memcpy(file->buffer + file->buf_cursor, buffer, nbytes_to_write);
         file->buf_cursor += nbytes_to_write;
@@ -233,49 +236,127 @@ ERR_RETURN:
     return -1;
 }
 
-static inline void 
-coy_file_writer_close(CoyFileWriter *file)
+static inline i32
+coy_file_skip_iovecs(i32 num_iov, struct iovec *iov, size num_bytes)
 {
-    /* TODO: Rework API to return error if the flush fails. */
-    coy_file_writer_flush(file);
-    /* int err_code = */ close((int)file->handle);
-    file->valid = false;
+    /* Skip the pieces that are done, and trim the one that was cut short. Returns the index of the first one left. */
+    i32 i = 0;
+    while(i < num_iov && (size)iov[i].iov_len <= num_bytes)
+    {
+        num_bytes -= iov[i].iov_len;
+        ++i;
+    }
+    if(num_bytes > 0)
+    {
+        iov[i].iov_base = (byte *)iov[i].iov_base + num_bytes;
+        iov[i].iov_len -= num_bytes;
+    }
+
+    return i;
 }
 
-static inline size 
-coy_file_slurp(char const *filename, size buf_size, byte *buffer)
+static inline size
+coy_file_transfer_iovecs(int fd, b32 write_it, i32 num_iov, struct iovec *iov, size *num_bytes_moved)
 {
-    size file_size = coy_file_size(filename);
-    StopIf(file_size < 1 || file_size > buf_size, goto ERR_RETURN);
+    /* Keep going until it's all moved, readv and writev may stop short. Returns early only at the end of the file. On
+     * an error it returns -1, but num_bytes_moved (if not NULL) still says how much got through before it.
+     */
+    size total_num_bytes = 0;
+    while(num_iov > 0)
+    {
+        ssize_t num_bytes = write_it ? writev(fd, iov, num_iov) : readv(fd, iov, num_iov);
+        StopIf(num_bytes < 0, return -1);
+        if(num_bytes == 0) { break; }
+        total_num_bytes += num_bytes;
+        if(num_bytes_moved) { *num_bytes_moved = total_num_bytes; }
+
+        i32 num_done = coy_file_skip_iovecs(num_iov, iov, num_bytes);
+        iov += num_done;
+        num_iov -= num_done;
+    }
 
-    int fd = open( filename, // char const *pathname
-                   O_RDONLY, // Read only
-                   0);       // No mode information needed.
+    return total_num_bytes;
+}
 
-    StopIf(fd < 0, goto ERR_RETURN);
-    
-    size space_available = buf_size;
-    size num_bytes_read = 0;
-    size total_num_bytes_read = 0;
-    do
+static inline size
+coy_file_writev(CoyFileWriter *file, i32 num_vecs, CoyIoVec const *vecs)
+{
+    Assert(num_vecs >= 0 && num_vecs <= COY_FILE_MAX_IO_VECS);
+    StopIf(!file->valid, goto ERR_RETURN);
+
+    size total_num_bytes = 0;
+    for(i32 i = 0; i < num_vecs; ++i) { total_num_bytes += vecs[i].num_bytes; }
+
+    if(file->background)
     {
-        num_bytes_read = read(fd, buffer + total_num_bytes_read, space_available);
-        space_available -= num_bytes_read;
-        total_num_bytes_read += num_bytes_read;
+        /* The I/O thread does the system calls, just queue the pieces up in order. */
+        for(i32 i = 0; i < num_vecs; ++i)
+        {
+            StopIf(coy_file_write_background(file, vecs[i].num_bytes, vecs[i].data) < 0, goto ERR_RETURN);
+        }
+        return total_num_bytes;
+    }
 
-        StopIf(num_bytes_read < 0, goto ERR_RETURN);
+    if(total_num_bytes <= file->buf_size - file->buf_cursor)
+    {
+        /* Small records just go in the buffer. */
+        for(i32 i = 0; i < num_vecs; ++i)
+        {
+            memcpy(file->buffer + file->buf_cursor, vecs[i].data, vecs[i].num_bytes);
+            file->buf_cursor += vecs[i].num_bytes;
+        }
+        return total_num_bytes;
+    }
 
-    } while(space_available && num_bytes_read);
+    /* The buffered data goes first so everything stays in order. */
+    struct iovec iov[COY_FILE_MAX_IO_VECS + 1];
+    i32 num_iov = 0;
+    if(file->buf_cursor > 0) { iov[num_iov++] = (struct iovec){ .iov_base = file->buffer, .iov_len = file->buf_cursor }; }
+    for(i32 i = 0; i < num_vecs; ++i)
+    {
+        if(vecs[i].num_bytes > 0)
+        {
+            iov[num_iov++] = (struct iovec){ .iov_base = vecs[i].data, .iov_len = vecs[i].num_bytes };
+        }
+    }
 
-    close(fd);
-    return (size) total_num_bytes_read;
+    size num_bytes_moved = 0;
+    size num_bytes_written = coy_file_transfer_iovecs((int)file->handle, true, num_iov, iov, &num_bytes_moved);
+    StopIf(num_bytes_written != file->buf_cursor + total_num_bytes, goto ERR_PARTIAL);
+    file->buf_cursor = 0;
+
+    return total_num_bytes;
 
+ERR_PARTIAL:
+    if(num_bytes_moved < file->buf_cursor)
+    {
+        /* Only buffered data went out, keep the rest of it so the writer is still good. */
+        memmove(file->buffer, file->buffer + num_bytes_moved, file->buf_cursor - num_bytes_moved);
+        file->buf_cursor -= num_bytes_moved;
+    }
+    else
+    {
+        /* Part of the caller's pieces are in the file already, a retry would write them twice. */
+        if(num_bytes_moved > file->buf_cursor) { file->valid = false; }
+        file->buf_cursor = 0;
+    }
 ERR_RETURN:
     return -1;
 }
 
-static inline CoyFileReader 
-coy_file_open_read(char const *filename)
+static inline b32
+coy_file_writer_close(CoyFileWriter *file)
+{
+    b32 success = coy_file_writer_flush(file) >= 0;
+    if(file->background) { success = coy_file_writer_finish_background(file) && success; }
+    /* int err_code = */ close((int)file->handle);
+    if(file->buffer_mem.valid) { coy_memory_free(&file->buffer_mem); }
+    file->valid = false;
+    return success;
+}
+
+static inline CoyFileReader
+coy_file_open_read_with_buffer(char const *filename, size buf_size, byte *buffer)
 {
     int fd = open( filename, // char const *pathname
                    O_RDONLY, // Read only
@@ -283,7 +364,7 @@ coy_file_open_read(char const *filename)
 
     if (fd >= 0)
     {
-        return (CoyFileReader){ .handle = (iptr) fd, .valid = true  };
+        return (CoyFileReader){ .handle = (iptr) fd, .buffer = buffer, .buf_size = buf_size, .valid = true  };
     }
     else
     {
@@ -291,11 +372,44 @@ coy_file_open_read(char const *filename)
     }
 }
 
+static inline void
+coy_file_drop_behind(CoyFileReader *file)
+{
+    /* Everything before what's still buffered has been consumed. */
+    size buffered = file->ring.valid ? coy_ring_buffer_bytes(&file->ring) : file->bytes_remaining;
+    size consumed = file->file_offset - buffered;
+    if(consumed - file->dropped_through >= COY_FILE_DROP_BEHIND_BYTES)
+    {
+        /* b32 success = */ coy_file_advise(file, COY_ACCESS_DONTNEED, file->dropped_through, consumed - file->dropped_through);
+        file->dropped_through = consumed;
+    }
+}
+
 static inline size 
 coy_file_fill_buffer(CoyFileReader *file)
 {
     _Static_assert(sizeof(ssize_t) <= sizeof(size), "oh come on people. ssize_t != intptr_t!? Really!");
 
+    if(file->ring.valid)
+    {
+        /* No need to move anything, the free space is always contiguous. */
+        CoyRingBuffer *ring = &file->ring;
+        size total_num_bytes_read = 0;
+        while(coy_ring_buffer_space(ring))
+        {
+            size num_bytes_read = read((int)file->handle, coy_ring_buffer_write_ptr(ring), coy_ring_buffer_space(ring));
+            StopIf(num_bytes_read < 0, goto ERR_RETURN);
+            if(num_bytes_read == 0) { break; }
+
+            coy_ring_buffer_produce(ring, num_bytes_read);
+            total_num_bytes_read += num_bytes_read;
+            file->file_offset += num_bytes_read;
+        }
+
+        if(file->streaming) { coy_file_drop_behind(file); }
+        return total_num_bytes_read;
+    }
+
     if(file->bytes_remaining > 0)
     {
         /* Move remaining data to the front of the buffer */
@@ -304,7 +418,7 @@ coy_file_fill_buffer(CoyFileReader *file)
 
     file->buf_cursor = 0;
 
-    size space_available = COY_FILE_READER_BUF_SIZE - file->bytes_remaining;
+    size space_available = file->buf_size - file->bytes_remaining;
     size num_bytes_read = 0;
     size total_num_bytes_read = 0;
     while(space_available)
@@ -319,6 +433,8 @@ coy_file_fill_buffer(CoyFileReader *file)
     }
 
     file->bytes_remaining += total_num_bytes_read;
+    file->file_offset += total_num_bytes_read;
+    if(file->streaming) { coy_file_drop_behind(file); }
 
     return (size) total_num_bytes_read;
 
@@ -332,6 +448,43 @@ coy_file_read(CoyFileReader *file, size buf_size, byte *buffer)
     Assert(buf_size > 0);
     StopIf(!file->valid, goto ERR_RETURN);
 
+    if(file->ring.valid)
+    {
+        if(buf_size > coy_ring_buffer_bytes(&file->ring))
+        {
+            size bytes_read = coy_file_fill_buffer(file);
+            StopIf(bytes_read < 0, goto ERR_RETURN);
+        }
+
+        size ring_bytes = coy_ring_buffer_bytes(&file->ring);
+        size size_to_copy = buf_size > ring_bytes ? ring_bytes : buf_size;
+        memcpy(buffer, coy_ring_buffer_read_ptr(&file->ring), size_to_copy);
+        coy_ring_buffer_consume(&file->ring, size_to_copy);
+
+        return size_to_copy;
+    }
+
+    if(buf_size >= file->buf_size)
+    {
+        /* For large reads, hand over what's buffered and read the rest straight into the caller's buffer. */
+        size total_num_bytes_read = file->bytes_remaining;
+        memcpy(buffer, file->buffer + file->buf_cursor, total_num_bytes_read);
+        file->buf_cursor = 0;
+        file->bytes_remaining = 0;
+
+        while(total_num_bytes_read < buf_size)
+        {
+            ssize_t num_bytes_read = read((int)file->handle, buffer + total_num_bytes_read, buf_size - total_num_bytes_read);
+            StopIf(num_bytes_read < 0, goto ERR_RETURN);
+            if(num_bytes_read == 0) { break; }
+            total_num_bytes_read += num_bytes_read;
+            file->file_offset += num_bytes_read;
+        }
+
+        if(file->streaming) { coy_file_drop_behind(file); }
+        return total_num_bytes_read;
+    }
+
     if(buf_size > file->bytes_remaining)
     {
         size bytes_read = coy_file_fill_buffer(file);
@@ -349,13 +502,192 @@ ERR_RETURN:
     return -1;
 }
 
+static inline size
+coy_file_readv(CoyFileReader *file, i32 num_vecs, CoyIoVec const *vecs)
+{
+    Assert(num_vecs >= 0 && num_vecs <= COY_FILE_MAX_IO_VECS);
+    StopIf(!file->valid, goto ERR_RETURN);
+
+    size total_num_bytes_read = 0;
+    if(file->ring.valid)
+    {
+        /* The ring has its own way of filling up, so just read each piece. */
+        for(i32 i = 0; i < num_vecs; ++i)
+        {
+            if(vecs[i].num_bytes == 0) { continue; }
+            size num_bytes_read = coy_file_read(file, vecs[i].num_bytes, vecs[i].data);
+            StopIf(num_bytes_read < 0, goto ERR_RETURN);
+            total_num_bytes_read += num_bytes_read;
+            if(num_bytes_read < vecs[i].num_bytes) { break; }
+        }
+
+        return total_num_bytes_read;
+    }
+
+    /* Hand over the buffered data first, and collect whatever is left to read. */
+    struct iovec iov[COY_FILE_MAX_IO_VECS + 1];
+    i32 num_iov = 0;
+    size num_bytes_wanted = 0;
+    for(i32 i = 0; i < num_vecs; ++i)
+    {
+        size size_to_copy = vecs[i].num_bytes > file->bytes_remaining ? file->bytes_remaining : vecs[i].num_bytes;
+        memcpy(vecs[i].data, file->buffer + file->buf_cursor, size_to_copy);
+        file->buf_cursor += size_to_copy;
+        file->bytes_remaining -= size_to_copy;
+        total_num_bytes_read += size_to_copy;
+
+        if(size_to_copy < vecs[i].num_bytes)
+        {
+            size left = vecs[i].num_bytes - size_to_copy;
+            iov[num_iov++] = (struct iovec){ .iov_base = (byte *)vecs[i].data + size_to_copy, .iov_len = left };
+            num_bytes_wanted += left;
+        }
+    }
+
+    if(num_bytes_wanted == 0) { return total_num_bytes_read; }
+
+    /* The buffer is empty now, refill it in the same call. */
+    Assert(file->bytes_remaining == 0);
+    file->buf_cursor = 0;
+    iov[num_iov++] = (struct iovec){ .iov_base = file->buffer, .iov_len = file->buf_size };
+
+    ssize_t num_bytes_read = readv((int)file->handle, iov, num_iov);
+    StopIf(num_bytes_read < 0, goto ERR_RETURN);
+    file->file_offset += num_bytes_read;
+
+    if(num_bytes_read >= num_bytes_wanted)
+    {
+        file->bytes_remaining = num_bytes_read - num_bytes_wanted;
+        return total_num_bytes_read + num_bytes_wanted;
+    }
+
+    /* Came up short, finish the caller's pieces without the buffer. */
+    total_num_bytes_read += num_bytes_read;
+    if(num_bytes_read > 0)
+    {
+        i32 num_done = coy_file_skip_iovecs(num_iov - 1, iov, num_bytes_read);
+        size rest = coy_file_transfer_iovecs((int)file->handle, false, num_iov - 1 - num_done, iov + num_done, NULL);
+        StopIf(rest < 0, goto ERR_RETURN);
+        total_num_bytes_read += rest;
+        file->file_offset += rest;
+    }
+
+    return total_num_bytes_read;
+
+ERR_RETURN:
+    return -1;
+}
+
 static inline void 
 coy_file_reader_close(CoyFileReader *file)
 {
     /* int err_code = */ close((int)file->handle);
+    if(file->ring.valid) { coy_ring_buffer_destroy(&file->ring); }
+    if(file->buffer_mem.valid) { coy_memory_free(&file->buffer_mem); }
     file->valid = false;
 }
 
+static inline iptr
+coy_file_open_handle(char const *filename, b32 create, b32 direct)
+{
+    int flags = create ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY;
+#if defined(O_DIRECT)
+    if(direct) { flags |= O_DIRECT; }
+#elif !defined(F_NOCACHE)
+    /* No way to ask for direct I/O (e.g. O_DIRECT hidden without _GNU_SOURCE), fail so the caller falls back. */
+    StopIf(direct, return -1);
+#endif
+
+    int fd = open(filename, flags, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+    StopIf(fd < 0, return -1);
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    /* Apple has no O_DIRECT, but it can turn off caching for a file. */
+    if(direct && fcntl(fd, F_NOCACHE, 1) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+#endif
+
+    return (iptr)fd;
+}
+
+static inline b32
+coy_file_set_size_handle(iptr handle, size num_bytes)
+{
+    int err_code = ftruncate((int)handle, (off_t)num_bytes);
+    return err_code == 0;
+}
+
+static inline void
+coy_file_close_handle(iptr handle)
+{
+    /* int err_code = */ close((int)handle);
+}
+
+static inline size
+coy_file_size_handle(iptr handle)
+{
+    struct stat statbuf = {0};
+    int err_code = fstat((int)handle, &statbuf);
+    StopIf(err_code != 0, return -1);
+
+    return (size)statbuf.st_size;
+}
+
+static inline size
+coy_file_read_at(iptr handle, size offset, size num_bytes, byte *buffer)
+{
+    size total_num_bytes_read = 0;
+    while(total_num_bytes_read < num_bytes)
+    {
+        size num_bytes_read = pread((int)handle,
+                                    buffer + total_num_bytes_read,
+                                    num_bytes - total_num_bytes_read,
+                                    offset + total_num_bytes_read);
+        StopIf(num_bytes_read < 0, return -1);
+        if(num_bytes_read == 0) { break; } /* End of file. */
+
+        total_num_bytes_read += num_bytes_read;
+    }
+
+    return total_num_bytes_read;
+}
+
+static inline size
+coy_file_write_at(iptr handle, size offset, size num_bytes, byte const *buffer)
+{
+    size total_num_bytes_written = 0;
+    while(total_num_bytes_written < num_bytes)
+    {
+        size num_bytes_written = pwrite((int)handle,
+                                        buffer + total_num_bytes_written,
+                                        num_bytes - total_num_bytes_written,
+                                        offset + total_num_bytes_written);
+        StopIf(num_bytes_written < 0, return -1);
+
+        total_num_bytes_written += num_bytes_written;
+    }
+
+    return total_num_bytes_written;
+}
+
+static inline size
+coy_file_write_all(iptr handle, size num_bytes, byte const *buffer)
+{
+    size total_num_bytes_written = 0;
+    while(total_num_bytes_written < num_bytes)
+    {
+        size num_bytes_written = write((int)handle, buffer + total_num_bytes_written, num_bytes - total_num_bytes_written);
+        StopIf(num_bytes_written < 0, return -1);
+
+        total_num_bytes_written += num_bytes_written;
+    }
+
+    return total_num_bytes_written;
+}
+
 static inline size 
 coy_file_size(char const *filename)
 {
@@ -367,48 +699,248 @@ coy_file_size(char const *filename)
     return (size)statbuf.st_size;
 }
 
+static inline CoyMemMappedFile
+coy_memmap_map_range(iptr handle, size offset, size num_bytes, b32 populate)
+{
+    /* mmap wants a page aligned offset, map from the page before and point data past the extra bytes. */
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size map_size = offset + num_bytes - start;
+
+    int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+    if(populate) { flags |= MAP_POPULATE; }
+#endif
+
+    byte *base = mmap(NULL,           // Starting address - OS chooses
+                      map_size,       // The size of the mapping
+                      PROT_READ,      // Read only access
+                      flags,          // flags - private since we never write
+                      (int)handle,    // file descriptor for the file to map
+                      start);         // offset into the file to read
+    StopIf(base == MAP_FAILED, goto ERR_RETURN);
+
+    if(map_size >= COY_MEMMAP_HUGE_PAGE_THRESHOLD)
+    {
+        coy_memory_hint_huge_pages(base, map_size);
+    }
+
+    CoyMemMappedFile file = { .size_in_bytes = num_bytes, 
+                              .data = base + (offset - start), 
+                              .offset = offset,
+                              ._internal = {0}, 
+                              .valid = true 
+    };
+
+#if !defined(MAP_POPULATE)
+    if(populate) { coy_memmap_advise(&file, COY_ACCESS_WILLNEED, 0, 0); }
+#endif
+
+    return file;
+
+ERR_RETURN:
+    return (CoyMemMappedFile) { .valid = false };
+}
+
 static inline CoyMemMappedFile 
-coy_memmap_read_only(char const *filename)
+coy_memmap_read_window(char const *filename, size offset, size num_bytes, b32 populate)
 {
     _Static_assert(sizeof(usize) == sizeof(size), "sizeof(size_t) != sizeof(intptr_t)");
-
-    size size_in_bytes = coy_file_size(filename);
-    StopIf(size_in_bytes == -1, goto ERR_RETURN);
+    Assert(offset >= 0 && num_bytes >= 0);
 
     int fd = open( filename, // char const *pathname
                    O_RDONLY, // Read only
                    0);       // No mode information needed.
     StopIf(fd < 0, goto ERR_RETURN);
 
-    byte const *data = mmap(NULL,           // Starting address - OS chooses
-                            size_in_bytes,  // The size of the mapping,should be the file size for this
-                            PROT_READ,      // Read only access
-                            MAP_PRIVATE,    // flags - not sure if anything is necessary for read only
-                            fd,             // file descriptor for the file to map
-                            0);             // offset into the file to read
+    /* Mapping past the end of the file crashes when it's touched, so the window has to fit. */
+    struct stat statbuf = {0};
+    StopIf(fstat(fd, &statbuf) != 0, goto CLOSE_AND_ERR);
+    size file_size = (size)statbuf.st_size;
+    if(num_bytes == 0) { num_bytes = file_size - offset; }
+    StopIf(num_bytes <= 0 || offset + num_bytes > file_size, goto CLOSE_AND_ERR);
 
+    /* The mapping keeps the file open. */
+    CoyMemMappedFile file = coy_memmap_map_range((iptr)fd, offset, num_bytes, populate);
     close(fd);
-    StopIf(data == MAP_FAILED, goto ERR_RETURN);
-
-    return (CoyMemMappedFile){ .size_in_bytes = (size)size_in_bytes, 
-                               .data = data, 
-                               ._internal = {0}, 
-                               .valid = true 
-    };
+    return file;
 
+CLOSE_AND_ERR:
+    close(fd);
 ERR_RETURN:
     return (CoyMemMappedFile) { .valid = false };
 }
 
+static inline CoyMemMappedFile 
+coy_memmap_read_only(char const *filename)
+{
+    return coy_memmap_read_window(filename, 0, 0, false);
+}
+
 static inline void 
 coy_memmap_close(CoyMemMappedFile *file)
 {
-    /*BOOL success = */ munmap((void *)file->data, file->size_in_bytes);
+    /* Windows start part way into a page, unmap from the start of the page. */
+    size extra = file->offset % coy_memory_page_size();
+    /*BOOL success = */ munmap((void *)(file->data - extra), file->size_in_bytes + extra);
+    if(file->writable) { close((int)file->_internal[0]); }
     file->valid = false;
 
     return;
 }
 
+static inline CoyMemMapWindowIter
+coy_memmap_window_iterator_open(char const *filename, size window_size, size overlap)
+{
+    Assert(window_size > 0 && overlap >= 0 && overlap < window_size);
+
+    int fd = open(filename, O_RDONLY, 0);
+    StopIf(fd < 0, goto ERR_RETURN);
+
+    struct stat statbuf = {0};
+    if(fstat(fd, &statbuf) != 0)
+    {
+        close(fd);
+        goto ERR_RETURN;
+    }
+
+    return (CoyMemMapWindowIter){ .file_size = (size)statbuf.st_size,
+                                  .window_size = window_size,
+                                  .step = window_size - overlap,
+                                  ._handle = (iptr)fd,
+                                  .valid = true
+    };
+
+ERR_RETURN:
+    return (CoyMemMapWindowIter) { ._handle = -1, .valid = false };
+}
+
+static inline void
+coy_memmap_window_iterator_close(CoyMemMapWindowIter *iter)
+{
+    if(iter->window.valid) { coy_memmap_close(&iter->window); }
+    if(iter->_next.valid) { coy_memmap_close(&iter->_next); }
+    if(iter->_handle >= 0) { close((int)iter->_handle); }
+    iter->_handle = -1;
+    iter->valid = false;
+}
+
+static inline CoyMemMappedFile
+coy_memmap_shared(int fd, size size_in_bytes)
+{
+    byte *data = mmap(NULL, size_in_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    StopIf(data == MAP_FAILED, goto ERR_RETURN);
+
+    /* Hang on to the file descriptor, it's needed to grow the file. */
+    return (CoyMemMappedFile){ .size_in_bytes = size_in_bytes,
+                               .writable_data = data,
+                               ._internal = { (iptr)fd, 0 },
+                               .writable = true,
+                               .valid = true
+    };
+
+ERR_RETURN:
+    close(fd);
+    return (CoyMemMappedFile) { .valid = false };
+}
+
+static inline CoyMemMappedFile
+coy_memmap_create(char const *filename, size num_bytes)
+{
+    Assert(num_bytes > 0);
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+    StopIf(fd < 0, goto ERR_RETURN);
+
+    if(!coy_file_allocate_handle((iptr)fd, num_bytes))
+    {
+        close(fd);
+        goto ERR_RETURN;
+    }
+
+    return coy_memmap_shared(fd, num_bytes);
+
+ERR_RETURN:
+    return (CoyMemMappedFile) { .valid = false };
+}
+
+static inline CoyMemMappedFile
+coy_memmap_read_write(char const *filename)
+{
+    int fd = open(filename, O_RDWR, 0);
+    StopIf(fd < 0, goto ERR_RETURN);
+
+    /* Can't map an empty file. */
+    struct stat statbuf = {0};
+    if(fstat(fd, &statbuf) != 0 || statbuf.st_size == 0)
+    {
+        close(fd);
+        goto ERR_RETURN;
+    }
+
+    return coy_memmap_shared(fd, (size)statbuf.st_size);
+
+ERR_RETURN:
+    return (CoyMemMappedFile) { .valid = false };
+}
+
+static inline b32
+coy_memmap_flush(CoyMemMappedFile const *file, size offset, size num_bytes, b32 wait)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= file->size_in_bytes);
+    StopIf(!file->valid || !file->writable, return false);
+    if(num_bytes == 0) { num_bytes = file->size_in_bytes - offset; }
+    if(num_bytes == 0) { return true; }
+
+    /* msync wants a page aligned start. */
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    int err_code = msync(file->writable_data + start, offset + num_bytes - start, wait ? MS_SYNC : MS_ASYNC);
+    return err_code == 0;
+}
+
+static inline b32
+coy_memmap_lock(CoyMemMappedFile const *file)
+{
+    StopIf(!file->valid, return false);
+    int err_code = mlock(file->data, file->size_in_bytes);
+    return err_code == 0;
+}
+
+static inline b32
+coy_memmap_unlock(CoyMemMappedFile const *file)
+{
+    StopIf(!file->valid, return false);
+    int err_code = munlock(file->data, file->size_in_bytes);
+    return err_code == 0;
+}
+
+static inline b32
+coy_memmap_advise(CoyMemMappedFile const *file, CoyAccessHint hint, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= file->size_in_bytes);
+    StopIf(!file->valid, return false);
+    if(num_bytes == 0) { num_bytes = file->size_in_bytes - offset; }
+    if(num_bytes == 0) { return true; }
+
+    int advice = MADV_NORMAL;
+    switch(hint)
+    {
+        case COY_ACCESS_NORMAL:     advice = MADV_NORMAL;     break;
+        case COY_ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+        case COY_ACCESS_RANDOM:     advice = MADV_RANDOM;     break;
+        case COY_ACCESS_WILLNEED:   advice = MADV_WILLNEED;   break;
+        case COY_ACCESS_DONTNEED:   advice = MADV_DONTNEED;   break;
+    }
+
+    /* madvise wants a page aligned address, and a window's data doesn't start on a page. */
+    uptr page_size = (uptr)coy_memory_page_size();
+    uptr first = (uptr)(file->data + offset);
+    uptr start = first - first % page_size;
+    int err_code = madvise((void *)start, (usize)(first + num_bytes - start), advice);
+    return err_code == 0;
+}
+
 static inline CoyFileNameIter 
 coy_file_name_iterator_open(char const *directory_path, char const *file_extension)
 {
@@ -501,6 +1033,7 @@ coy_thread_func_internal(void *thread_params)
 {
     CoyThread *thrd = thread_params;
     thrd->func(thrd->thread_data);
+    coy_scratch_release();
 
     return NULL;
 }
@@ -516,6 +1049,23 @@ coy_thread_create(CoyThread *thrd, CoyThreadFunc func, void *thread_data)
     return 0 == pthread_create((pthread_t *)thrd->handle, NULL, coy_thread_func_internal, thrd);
 }
 
+static inline b32
+coy_thread_stack_prefault_lock(size num_bytes)
+{
+    Assert(num_bytes > 0);
+    size page_size = coy_memory_page_size();
+
+    /* The VLA is the stack just below this frame. Touch it from the top down, the same way the stack grows. */
+    byte volatile stack[num_bytes];
+    for(size i = num_bytes - 1; i >= 0; i -= page_size) { stack[i] = 0; }
+    stack[0] = 0;
+
+    uptr start = (uptr)stack & ~(uptr)(page_size - 1);
+    uptr end = (uptr)stack + num_bytes;
+    int err_code = mlock((void *)start, end - start);
+    return err_code == 0;
+}
+
 static inline b32
 coy_thread_join(CoyThread *thread)
 {
@@ -7,6 +7,7 @@
 #include <windows.h>
 #include <bcrypt.h>
 #include <intrin.h>
+#include <malloc.h>
 #include <psapi.h>
 
 _Static_assert(UINT32_MAX < INTPTR_MAX, "DWORD cannot be cast to intptr_t safely.");
@@ -164,7 +165,7 @@ ERR_RETURN:
 }
 
 static inline CoyFileWriter
-coy_file_create(char const *filename)
+coy_file_create_with_buffer(char const *filename, size buf_size, byte *buffer)
 {
     HANDLE fh = CreateFileA(filename,              // [in]           LPCSTR                lpFileName,
                             GENERIC_WRITE,         // [in]           DWORD                 dwDesiredAccess,
@@ -176,7 +177,7 @@ coy_file_create(char const *filename)
 
     if(fh != INVALID_HANDLE_VALUE)
     {
-        return (CoyFileWriter){.handle = (iptr)fh, .valid = true};
+        return (CoyFileWriter){.handle = (iptr)fh, .buffer = buffer, .buf_size = buf_size, .valid = true};
     }
     else
     {
@@ -185,7 +186,7 @@ coy_file_create(char const *filename)
 }
 
 static inline CoyFileWriter
-coy_file_append(char const *filename)
+coy_file_append_with_buffer(char const *filename, size buf_size, byte *buffer)
 {
     HANDLE fh = CreateFileA(filename,              // [in]           LPCSTR                lpFileName,
                             FILE_APPEND_DATA,      // [in]           DWORD                 dwDesiredAccess,
@@ -197,7 +198,7 @@ coy_file_append(char const *filename)
 
     if(fh != INVALID_HANDLE_VALUE)
     {
-        return (CoyFileWriter){.handle = (iptr)fh, .valid = true};
+        return (CoyFileWriter){.handle = (iptr)fh, .buffer = buffer, .buf_size = buf_size, .valid = true};
     }
     else
     {
@@ -209,6 +210,7 @@ static inline size
 coy_file_writer_flush(CoyFileWriter *file)
 {
     StopIf(!file->valid, goto ERR_RETURN);
+    if(file->background) { return coy_file_writer_flush_background(file); }
 
     if(file->buf_cursor)
     {
@@ -234,28 +236,31 @@ ERR_RETURN:
     return -1;
 }
 
-static inline void 
+static inline b32
 coy_file_writer_close(CoyFileWriter *file)
 {
-    /* TODO change API to return size so I can return an error if the flush fails. */
-    coy_file_writer_flush(file);
+    b32 success = coy_file_writer_flush(file) >= 0;
+    if(file->background) { success = coy_file_writer_finish_background(file) && success; }
     CloseHandle((HANDLE)file->handle);
+    if(file->buffer_mem.valid) { coy_memory_free(&file->buffer_mem); }
     file->valid = false;
 
-    return;
+    return success;
 }
 
 static inline size 
 coy_file_write(CoyFileWriter *file, size nbytes_write, byte const *buffer)
 {
+    if(file->background) { return coy_file_write_background(file, nbytes_write, buffer); }
+
     /* check to see if the buffer needs flushed. */
-    if(file->buf_cursor + nbytes_write > COY_FILE_WRITER_BUF_SIZE)
+    if(file->buf_cursor + nbytes_write > file->buf_size)
     {
         size bytes_flushed = coy_file_writer_flush(file);
         StopIf(bytes_flushed < 0, goto ERR_RETURN);
     }
 
-    if(nbytes_write < COY_FILE_WRITER_BUF_SIZE)
+    if(nbytes_write < file->buf_size)
     {
         /* Dump small writes into the buffer. */
         memcpy(file->buffer + file->buf_cursor, buffer, nbytes_write);
@@ -283,8 +288,41 @@ ERR_RETURN:
     return -1;
 }
 
+static inline size
+coy_file_writev(CoyFileWriter *file, i32 num_vecs, CoyIoVec const *vecs)
+{
+    /* WriteFileGather only works on unbuffered, overlapped handles with page sized pieces, so no single call gather write
+     * here. Small records still go in the buffer with no extra system calls, big pieces bypass it in coy_file_write.
+     */
+    Assert(num_vecs >= 0 && num_vecs <= COY_FILE_MAX_IO_VECS);
+    StopIf(!file->valid, goto ERR_RETURN);
+
+    size total_num_bytes = 0;
+    for(i32 i = 0; i < num_vecs; ++i)
+    {
+        if(vecs[i].num_bytes == 0) { continue; }
+        size num_bytes_written = coy_file_write(file, vecs[i].num_bytes, vecs[i].data);
+        StopIf(num_bytes_written != vecs[i].num_bytes, goto ERR_RETURN);
+        total_num_bytes += num_bytes_written;
+    }
+
+    return total_num_bytes;
+
+ERR_RETURN:
+    return -1;
+}
+
+static inline b32
+coy_file_advise(CoyFileReader *file, CoyAccessHint hint, size offset, size num_bytes)
+{
+    /* Windows only takes access hints when the file is opened (FILE_FLAG_SEQUENTIAL_SCAN / FILE_FLAG_RANDOM_ACCESS). */
+    Assert(offset >= 0 && num_bytes >= 0);
+    StopIf(!file->valid, return false);
+    return true;
+}
+
 static inline CoyFileReader
-coy_file_open_read(char const *filename)
+coy_file_open_read_with_buffer(char const *filename, size buf_size, byte *buffer)
 {
     HANDLE fh = CreateFileA(filename,              // [in]           LPCSTR                lpFileName,
                             GENERIC_READ,          // [in]           DWORD                 dwDesiredAccess,
@@ -296,7 +334,7 @@ coy_file_open_read(char const *filename)
 
     if(fh != INVALID_HANDLE_VALUE)
     {
-        return (CoyFileReader){.handle = (iptr)fh, .valid = true};
+        return (CoyFileReader){.handle = (iptr)fh, .buffer = buffer, .buf_size = buf_size, .valid = true};
     }
     else
     {
@@ -307,6 +345,28 @@ coy_file_open_read(char const *filename)
 static inline size 
 coy_file_fill_buffer(CoyFileReader *file)
 {
+    if(file->ring.valid)
+    {
+        /* No need to move anything, the free space is always contiguous. */
+        CoyRingBuffer *ring = &file->ring;
+        size total_num_bytes_read = 0;
+        while(coy_ring_buffer_space(ring))
+        {
+            size space_available = coy_ring_buffer_space(ring);
+            Assert(INT32_MAX >= space_available); /* Not prepared for REALLY large reads. */
+            DWORD nbytes_read = 0;
+            BOOL success = ReadFile((HANDLE)file->handle, coy_ring_buffer_write_ptr(ring), (DWORD)space_available, &nbytes_read, NULL);
+            StopIf(!success, goto ERR_RETURN);
+            if(nbytes_read == 0) { break; }
+
+            coy_ring_buffer_produce(ring, nbytes_read);
+            total_num_bytes_read += nbytes_read;
+            file->file_offset += nbytes_read;
+        }
+
+        return total_num_bytes_read;
+    }
+
     if(file->bytes_remaining > 0)
     {
         /* Move remaining data to the front of the buffer */
@@ -314,7 +374,7 @@ coy_file_fill_buffer(CoyFileReader *file)
     }
     file->buf_cursor = 0;
 
-    size space_available = COY_FILE_READER_BUF_SIZE - file->bytes_remaining;
+    size space_available = file->buf_size - file->bytes_remaining;
 
     Assert(INT32_MAX >= space_available); /* Not prepared for REALLY large reads. */
     DWORD nbytes_read = 0;
@@ -327,6 +387,7 @@ coy_file_fill_buffer(CoyFileReader *file)
     StopIf(!success, goto ERR_RETURN);
 
     file->bytes_remaining += nbytes_read;
+    file->file_offset += nbytes_read;
 
     return (size)nbytes_read;
 
@@ -340,6 +401,45 @@ coy_file_read(CoyFileReader *file, size buf_size, byte *buffer)
     Assert(buf_size > 0);
     StopIf(!file->valid, goto ERR_RETURN);
 
+    if(file->ring.valid)
+    {
+        if(buf_size > coy_ring_buffer_bytes(&file->ring))
+        {
+            size bytes_read = coy_file_fill_buffer(file);
+            StopIf(bytes_read < 0, goto ERR_RETURN);
+        }
+
+        size ring_bytes = coy_ring_buffer_bytes(&file->ring);
+        size size_to_copy = buf_size > ring_bytes ? ring_bytes : buf_size;
+        memcpy(buffer, coy_ring_buffer_read_ptr(&file->ring), size_to_copy);
+        coy_ring_buffer_consume(&file->ring, size_to_copy);
+
+        return size_to_copy;
+    }
+
+    if(buf_size >= file->buf_size)
+    {
+        /* For large reads, hand over what's buffered and read the rest straight into the caller's buffer. */
+        size total_num_bytes_read = file->bytes_remaining;
+        memcpy(buffer, file->buffer + file->buf_cursor, total_num_bytes_read);
+        file->buf_cursor = 0;
+        file->bytes_remaining = 0;
+
+        while(total_num_bytes_read < buf_size)
+        {
+            size to_read = buf_size - total_num_bytes_read;
+            if(to_read > INT32_MAX) { to_read = INT32_MAX; }
+            DWORD nbytes_read = 0;
+            BOOL success = ReadFile((HANDLE)file->handle, buffer + total_num_bytes_read, (DWORD)to_read, &nbytes_read, NULL);
+            StopIf(!success, goto ERR_RETURN);
+            if(nbytes_read == 0) { break; }
+            total_num_bytes_read += nbytes_read;
+            file->file_offset += nbytes_read;
+        }
+
+        return total_num_bytes_read;
+    }
+
     if(buf_size > file->bytes_remaining)
     {
         size bytes_read = coy_file_fill_buffer(file);
@@ -357,51 +457,174 @@ ERR_RETURN:
     return -1;
 }
 
+static inline size
+coy_file_readv(CoyFileReader *file, i32 num_vecs, CoyIoVec const *vecs)
+{
+    /* Same story as coy_file_writev, ReadFileScatter needs unbuffered, overlapped handles. Read each piece. */
+    Assert(num_vecs >= 0 && num_vecs <= COY_FILE_MAX_IO_VECS);
+    StopIf(!file->valid, goto ERR_RETURN);
+
+    size total_num_bytes_read = 0;
+    for(i32 i = 0; i < num_vecs; ++i)
+    {
+        if(vecs[i].num_bytes == 0) { continue; }
+        size num_bytes_read = coy_file_read(file, vecs[i].num_bytes, vecs[i].data);
+        StopIf(num_bytes_read < 0, goto ERR_RETURN);
+        total_num_bytes_read += num_bytes_read;
+        if(num_bytes_read < vecs[i].num_bytes) { break; }
+    }
+
+    return total_num_bytes_read;
+
+ERR_RETURN:
+    return -1;
+}
+
 static inline void 
 coy_file_reader_close(CoyFileReader *file)
 {
     CloseHandle((HANDLE)file->handle);
+    if(file->ring.valid) { coy_ring_buffer_destroy(&file->ring); }
+    if(file->buffer_mem.valid) { coy_memory_free(&file->buffer_mem); }
     file->valid = false;
 
     return;
 }
 
-static inline size 
-coy_file_slurp(char const *filename, size buf_size, byte *buffer)
+static inline iptr
+coy_file_open_handle(char const *filename, b32 create, b32 direct)
 {
-    size file_size = coy_file_size(filename);
-    StopIf(file_size < 1 || file_size > buf_size, goto ERR_RETURN);
+    DWORD access = create ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    DWORD share_mode = create ? 0 : FILE_SHARE_READ;
+    DWORD disposition = create ? CREATE_ALWAYS : OPEN_EXISTING;
+    DWORD attributes = direct ? FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : FILE_ATTRIBUTE_NORMAL;
 
     HANDLE fh = CreateFileA(filename,              // [in]           LPCSTR                lpFileName,
-                            GENERIC_READ,          // [in]           DWORD                 dwDesiredAccess,
-                            FILE_SHARE_READ,       // [in]           DWORD                 dwShareMode,
+                            access,                // [in]           DWORD                 dwDesiredAccess,
+                            share_mode,            // [in]           DWORD                 dwShareMode,
                             NULL,                  // [in, optional] LPSECURITY_ATTRIBUTES lpSecurityAttributes,
-                            OPEN_EXISTING,         // [in]           DWORD                 dwCreationDisposition,
-                            FILE_ATTRIBUTE_NORMAL, // [in]           DWORD                 dwFlagsAndAttributes,
+                            disposition,           // [in]           DWORD                 dwCreationDisposition,
+                            attributes,            // [in]           DWORD                 dwFlagsAndAttributes,
                             NULL);                 // [in, optional] HANDLE                hTemplateFile
 
-    StopIf(fh == INVALID_HANDLE_VALUE, goto ERR_RETURN);
-    
-    size space_available = buf_size;
+    /* INVALID_HANDLE_VALUE is -1. */
+    return (iptr)fh;
+}
 
-    Assert(INT32_MAX >= space_available); /* Not prepared for REALLY large reads. */
-    DWORD nbytes_read = 0;
-    BOOL success =  ReadFile(fh,                     //  [in]                HANDLE       hFile,
-                             buffer,                 //  [out]               LPVOID       lpBuffer,
-                             (DWORD)space_available, //  [in]                DWORD        nNumberOfBytesToRead,
-                             &nbytes_read,           //  [out, optional]     LPDWORD      lpNumberOfBytesRead,
-                             NULL);                  //  [in, out, optional] LPOVERLAPPED lpOverlapped
+static inline b32
+coy_file_set_size_handle(iptr handle, size num_bytes)
+{
+    LARGE_INTEGER pos = { .QuadPart = num_bytes };
+    BOOL success = SetFilePointerEx((HANDLE)handle, pos, NULL, FILE_BEGIN);
+    StopIf(!success, return false);
 
-    success &= CloseHandle(fh);
+    success = SetEndOfFile((HANDLE)handle);
+    return success != 0;
+}
 
-    StopIf(!success, goto ERR_RETURN);
+static inline void
+coy_file_close_handle(iptr handle)
+{
+    CloseHandle((HANDLE)handle);
+}
 
-    return (size)nbytes_read;
+static inline size
+coy_file_size_handle(iptr handle)
+{
+    LARGE_INTEGER file_size = {0};
+    BOOL success = GetFileSizeEx((HANDLE)handle, &file_size);
+    StopIf(!success, return -1);
 
-ERR_RETURN:
+    return (size)file_size.QuadPart;
+}
+
+static inline size
+coy_file_read_at(iptr handle, size offset, size num_bytes, byte *buffer)
+{
+    size total_num_bytes_read = 0;
+    while(total_num_bytes_read < num_bytes)
+    {
+        /* An OVERLAPPED on a synchronous handle just supplies the offset. */
+        u64 pos = (u64)(offset + total_num_bytes_read);
+        OVERLAPPED ov = { .Offset = (DWORD)(pos & 0xFFFFFFFF), .OffsetHigh = (DWORD)(pos >> 32) };
+
+        size remaining = num_bytes - total_num_bytes_read;
+        DWORD to_read = remaining > INT32_MAX ? INT32_MAX : (DWORD)remaining;
+        DWORD nbytes_read = 0;
+        BOOL success = ReadFile((HANDLE)handle, buffer + total_num_bytes_read, to_read, &nbytes_read, &ov);
+        if(!success && GetLastError() == ERROR_HANDLE_EOF) { break; }
+        StopIf(!success, return -1);
+        if(nbytes_read == 0) { break; } /* End of file. */
+
+        total_num_bytes_read += nbytes_read;
+    }
+
+    return total_num_bytes_read;
+}
+
+static inline size
+coy_file_write_at(iptr handle, size offset, size num_bytes, byte const *buffer)
+{
+    size total_num_bytes_written = 0;
+    while(total_num_bytes_written < num_bytes)
+    {
+        u64 pos = (u64)(offset + total_num_bytes_written);
+        OVERLAPPED ov = { .Offset = (DWORD)(pos & 0xFFFFFFFF), .OffsetHigh = (DWORD)(pos >> 32) };
+
+        size remaining = num_bytes - total_num_bytes_written;
+        DWORD to_write = remaining > INT32_MAX ? INT32_MAX : (DWORD)remaining;
+        DWORD nbytes_written = 0;
+        BOOL success = WriteFile((HANDLE)handle, buffer + total_num_bytes_written, to_write, &nbytes_written, &ov);
+        StopIf(!success, return -1);
+
+        total_num_bytes_written += nbytes_written;
+    }
+
+    return total_num_bytes_written;
+}
+
+static inline size
+coy_file_write_all(iptr handle, size num_bytes, byte const *buffer)
+{
+    size total_num_bytes_written = 0;
+    while(total_num_bytes_written < num_bytes)
+    {
+        size remaining = num_bytes - total_num_bytes_written;
+        DWORD to_write = remaining > INT32_MAX ? INT32_MAX : (DWORD)remaining;
+        DWORD nbytes_written = 0;
+        BOOL success = WriteFile((HANDLE)handle, buffer + total_num_bytes_written, to_write, &nbytes_written, NULL);
+        StopIf(!success, return -1);
+
+        total_num_bytes_written += nbytes_written;
+    }
+
+    return total_num_bytes_written;
+}
+
+static inline b32
+coy_async_uring_create(CoyAsyncFile *file)
+{
+    /* No io_uring on Windows, the thread pool does all the work. */
+    return false;
+}
+
+static inline i32
+coy_async_uring_submit(CoyAsyncFile *file)
+{
+    return 0;
+}
+
+static inline i32
+coy_async_uring_reap(CoyAsyncFile *file, i32 max_slots, i32 *slots, b32 wait)
+{
     return -1;
 }
 
+static inline void
+coy_async_uring_destroy(CoyAsyncFile *file)
+{
+}
+
 static inline size 
 coy_file_size(char const *filename)
 {
@@ -419,66 +642,299 @@ ERR_RETURN:
     return -1;
 }
 
+static inline size
+coy_memmap_granularity(void)
+{
+    /* Views have to start on an allocation granularity boundary, not just a page. */
+    SYSTEM_INFO info = {0};
+    GetSystemInfo(&info);
+    return (size)info.dwAllocationGranularity;
+}
+
+static inline CoyMemMappedFile
+coy_memmap_map_range(iptr handle, size offset, size num_bytes, b32 populate)
+{
+    size start = offset - offset % coy_memmap_granularity();
+    u64 start_u64 = (u64)start;
+
+    LPVOID base = MapViewOfFile((HANDLE)handle,                     // [in] HANDLE hFileMappingObject,
+                                FILE_MAP_READ,                      // [in] DWORD  dwDesiredAccess,
+                                (DWORD)(start_u64 >> 32),           // [in] DWORD  dwFileOffsetHigh,
+                                (DWORD)(start_u64 & 0xFFFFFFFF),    // [in] DWORD  dwFileOffsetLow,
+                                (SIZE_T)(offset + num_bytes - start)); // [in] SIZE_T dwNumberOfBytesToMap
+    StopIf(!base, goto ERR_RETURN);
+
+    CoyMemMappedFile file = { .size_in_bytes = num_bytes,
+                              .data = (byte const *)base + (offset - start),
+                              .offset = offset,
+                              ._internal = {0},
+                              .valid = true
+    };
+
+    if(populate) { coy_memmap_advise(&file, COY_ACCESS_WILLNEED, 0, 0); }
+
+    return file;
+
+ERR_RETURN:
+    return (CoyMemMappedFile) { .valid = false };
+}
+
 static inline CoyMemMappedFile 
-coy_memmap_read_only(char const *filename)
+coy_memmap_read_window(char const *filename, size offset, size num_bytes, b32 populate)
 {
-    CoyFileReader cf = coy_file_open_read(filename);
-    StopIf(!cf.valid, goto ERR_RETURN);
+    Assert(offset >= 0 && num_bytes >= 0);
+
+    /* Just the handle, a CoyFileReader would allocate a buffer for nothing. */
+    iptr fh = coy_file_open_handle(filename, false, false);
+    StopIf(fh == -1, goto ERR_RETURN);
+
+    /* Mapping past the end of the file fails, so the window has to fit. */
+    LARGE_INTEGER file_size = {0};
+    StopIf(!GetFileSizeEx((HANDLE)fh, &file_size), goto CLOSE_CF_AND_ERR);
+    if(num_bytes == 0) { num_bytes = (size)file_size.QuadPart - offset; }
+    StopIf(num_bytes <= 0 || offset + num_bytes > (size)file_size.QuadPart, goto CLOSE_CF_AND_ERR);
 
-    HANDLE fmh =  CreateFileMappingA((HANDLE)cf.handle, // [in]           HANDLE                hFile,
+    HANDLE fmh =  CreateFileMappingA((HANDLE)fh,        // [in]           HANDLE                hFile,
                                      NULL,              // [in, optional] LPSECURITY_ATTRIBUTES lpFileMappingAttributes,
                                      PAGE_READONLY,     // [in]           DWORD                 flProtect,
                                      0,                 // [in]           DWORD                 dwMaximumSizeHigh,
                                      0,                 // [in]           DWORD                 dwMaximumSizeLow,
                                      NULL);             // [in, optional] LPCSTR                lpName
-    StopIf(fmh == INVALID_HANDLE_VALUE, goto CLOSE_CF_AND_ERR);
+    StopIf(!fmh, goto CLOSE_CF_AND_ERR);
+
+    /* The view keeps the mapping object and the file open, so neither handle is needed after this. */
+    CoyMemMappedFile file = coy_memmap_map_range((iptr)fmh, offset, num_bytes, populate);
+    CloseHandle(fmh);
+    coy_file_close_handle(fh);
+    return file;
+
+CLOSE_CF_AND_ERR:
+    coy_file_close_handle(fh);
+ERR_RETURN:
+    return (CoyMemMappedFile) { .valid = false };
+}
+
+static inline CoyMemMappedFile 
+coy_memmap_read_only(char const *filename)
+{
+    return coy_memmap_read_window(filename, 0, 0, false);
+}
 
-    LPVOID ptr =  MapViewOfFile(fmh,           // [in] HANDLE hFileMappingObject,
-                                FILE_MAP_READ, // [in] DWORD  dwDesiredAccess,
-                                0,             // [in] DWORD  dwFileOffsetHigh,
-                                0,             // [in] DWORD  dwFileOffsetLow,
-                                0);            // [in] SIZE_T dwNumberOfBytesToMap
-    StopIf(!ptr, goto CLOSE_FMH_AND_ERR);
+static inline void 
+coy_memmap_close(CoyMemMappedFile *file)
+{
+    /* Windows start part way into the view, unmap from its start. */
+    size extra = file->offset % coy_memmap_granularity();
+    /*BOOL success = */UnmapViewOfFile(file->data - extra);
 
-    // Get the size of the file mapped.
-    DWORD file_size_high = 0;
-    DWORD file_size_low = GetFileSize((HANDLE)cf.handle, &file_size_high);
-    StopIf(file_size_low == INVALID_FILE_SIZE, goto CLOSE_FMH_AND_ERR);
+    /* Writable mappings hang on to their handles to grow and flush. */
+    if(file->writable)
+    {
+        CloseHandle((HANDLE)file->_internal[1]);
+        coy_file_close_handle(file->_internal[0]);
+    }
 
-    uptr file_size = ((uptr)file_size_high << 32) | file_size_low;
-    StopIf(file_size > INTPTR_MAX, goto CLOSE_FMH_AND_ERR);
+    file->valid = false;
 
+    return;
+}
 
-    return (CoyMemMappedFile){
-      .size_in_bytes = (size)file_size, 
-        .data = ptr, 
-        ._internal = { cf.handle, (size)fmh }, 
-        .valid = true 
+static inline CoyMemMapWindowIter
+coy_memmap_window_iterator_open(char const *filename, size window_size, size overlap)
+{
+    Assert(window_size > 0 && overlap >= 0 && overlap < window_size);
+
+    iptr fh = coy_file_open_handle(filename, false, false);
+    StopIf(fh == -1, goto ERR_RETURN);
+
+    LARGE_INTEGER file_size = {0};
+    StopIf(!GetFileSizeEx((HANDLE)fh, &file_size), goto CLOSE_CF_AND_ERR);
+
+    /* Empty files can't be mapped, but there's nothing to iterate over anyway. */
+    HANDLE fmh = NULL;
+    if(file_size.QuadPart > 0)
+    {
+        fmh = CreateFileMappingA((HANDLE)fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        StopIf(!fmh, goto CLOSE_CF_AND_ERR);
+    }
+
+    /* The mapping object keeps the file open. */
+    coy_file_close_handle(fh);
+
+    return (CoyMemMapWindowIter){ .file_size = (size)file_size.QuadPart,
+                                  .window_size = window_size,
+                                  .step = window_size - overlap,
+                                  ._handle = (iptr)fmh,
+                                  .valid = true
     };
 
-CLOSE_FMH_AND_ERR:
-    CloseHandle(fmh);
 CLOSE_CF_AND_ERR:
-    coy_file_reader_close(&cf);
+    coy_file_close_handle(fh);
+ERR_RETURN:
+    return (CoyMemMapWindowIter) { .valid = false };
+}
+
+static inline void
+coy_memmap_window_iterator_close(CoyMemMapWindowIter *iter)
+{
+    if(iter->window.valid) { coy_memmap_close(&iter->window); }
+    if(iter->_next.valid) { coy_memmap_close(&iter->_next); }
+    if(iter->_handle) { CloseHandle((HANDLE)iter->_handle); }
+    iter->_handle = 0;
+    iter->valid = false;
+}
+
+static inline b32
+coy_memmap_lock(CoyMemMappedFile const *file)
+{
+    StopIf(!file->valid, return false);
+    BOOL success = VirtualLock((void *)file->data, file->size_in_bytes);
+    return success != 0;
+}
+
+static inline b32
+coy_memmap_unlock(CoyMemMappedFile const *file)
+{
+    StopIf(!file->valid, return false);
+    BOOL success = VirtualUnlock((void *)file->data, file->size_in_bytes);
+    return success != 0;
+}
+
+static inline b32
+coy_memmap_map_writable(CoyMemMappedFile *file, size num_bytes)
+{
+    /* A mapping object bigger than the file makes the file bigger. */
+    u64 max_size = (u64)num_bytes;
+    HANDLE fmh = CreateFileMappingA((HANDLE)file->_internal[0],          // [in]           HANDLE                hFile,
+                                    NULL,                                // [in, optional] LPSECURITY_ATTRIBUTES lpFileMappingAttributes,
+                                    PAGE_READWRITE,                      // [in]           DWORD                 flProtect,
+                                    (DWORD)(max_size >> 32),             // [in]           DWORD                 dwMaximumSizeHigh,
+                                    (DWORD)(max_size & 0xFFFFFFFF),      // [in]           DWORD                 dwMaximumSizeLow,
+                                    NULL);                               // [in, optional] LPCSTR                lpName
+    StopIf(!fmh, return false);
+
+    LPVOID ptr = MapViewOfFile(fmh, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+    if(!ptr)
+    {
+        CloseHandle(fmh);
+        return false;
+    }
+
+    file->_internal[1] = (iptr)fmh;
+    file->writable_data = ptr;
+    file->size_in_bytes = num_bytes;
+    return true;
+}
+
+static inline CoyMemMappedFile
+coy_memmap_create(char const *filename, size num_bytes)
+{
+    Assert(num_bytes > 0);
+
+    iptr fh = coy_file_open_handle(filename, true, false);
+    StopIf(fh == -1, goto ERR_RETURN);
+
+    CoyMemMappedFile file = { ._internal = { fh, 0 }, .writable = true, .valid = true };
+    StopIf(!coy_memmap_map_writable(&file, num_bytes), goto CLOSE_AND_ERR);
+
+    return file;
+
+CLOSE_AND_ERR:
+    coy_file_close_handle(fh);
 ERR_RETURN:
     return (CoyMemMappedFile) { .valid = false };
 }
 
-static inline void 
-coy_memmap_close(CoyMemMappedFile *file)
+static inline CoyMemMappedFile
+coy_memmap_read_write(char const *filename)
 {
-    void const*data = file->data;
-    iptr fh = file->_internal[0];
-    HANDLE fmh = (HANDLE)file->_internal[1];
+    HANDLE fh = CreateFileA(filename,                     // [in]           LPCSTR                lpFileName,
+                            GENERIC_READ | GENERIC_WRITE, // [in]           DWORD                 dwDesiredAccess,
+                            0,                            // [in]           DWORD                 dwShareMode,
+                            NULL,                         // [in, optional] LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                            OPEN_EXISTING,                // [in]           DWORD                 dwCreationDisposition,
+                            FILE_ATTRIBUTE_NORMAL,        // [in]           DWORD                 dwFlagsAndAttributes,
+                            NULL);                        // [in, optional] HANDLE                hTemplateFile
+    StopIf(fh == INVALID_HANDLE_VALUE, goto ERR_RETURN);
 
-    /*BOOL success = */UnmapViewOfFile(data);
-    CloseHandle(fmh);
-    CoyFileReader cf = { .handle = fh, .valid = true };
-    coy_file_reader_close(&cf);
+    /* Can't map an empty file. */
+    LARGE_INTEGER file_size = {0};
+    StopIf(!GetFileSizeEx(fh, &file_size) || file_size.QuadPart == 0, goto CLOSE_AND_ERR);
 
-    file->valid = false;
+    CoyMemMappedFile file = { ._internal = { (iptr)fh, 0 }, .writable = true, .valid = true };
+    StopIf(!coy_memmap_map_writable(&file, (size)file_size.QuadPart), goto CLOSE_AND_ERR);
 
-    return;
+    return file;
+
+CLOSE_AND_ERR:
+    CloseHandle(fh);
+ERR_RETURN:
+    return (CoyMemMappedFile) { .valid = false };
+}
+
+static inline b32
+coy_memmap_grow(CoyMemMappedFile *file, size new_size)
+{
+    Assert(new_size >= file->size_in_bytes);
+    StopIf(!file->valid || !file->writable, return false);
+    if(new_size == file->size_in_bytes) { return true; }
+
+    /* Map the bigger file before letting go of the old view, so a failure leaves the old one intact. */
+    void *old_data = file->writable_data;
+    HANDLE old_fmh = (HANDLE)file->_internal[1];
+    StopIf(!coy_memmap_map_writable(file, new_size), return false);
+
+    UnmapViewOfFile(old_data);
+    CloseHandle(old_fmh);
+    return true;
+}
+
+static inline b32
+coy_memmap_flush(CoyMemMappedFile const *file, size offset, size num_bytes, b32 wait)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= file->size_in_bytes);
+    StopIf(!file->valid || !file->writable, return false);
+    if(num_bytes == 0) { num_bytes = file->size_in_bytes - offset; }
+    if(num_bytes == 0) { return true; }
+
+    BOOL success = FlushViewOfFile(file->writable_data + offset, (SIZE_T)num_bytes);
+    StopIf(!success, return false);
+
+    /* FlushViewOfFile only starts the writes, this waits for them and the file metadata. */
+    if(wait)
+    {
+        success = FlushFileBuffers((HANDLE)file->_internal[0]);
+    }
+    return success != 0;
+}
+
+static inline b32
+coy_memmap_advise(CoyMemMappedFile const *file, CoyAccessHint hint, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= file->size_in_bytes);
+    StopIf(!file->valid, return false);
+    if(num_bytes == 0) { num_bytes = file->size_in_bytes - offset; }
+    if(num_bytes == 0) { return true; }
+
+    void *start = (byte *)file->data + offset;
+    switch(hint)
+    {
+        case COY_ACCESS_WILLNEED:
+        {
+            WIN32_MEMORY_RANGE_ENTRY range = { .VirtualAddress = start, .NumberOfBytes = (SIZE_T)num_bytes };
+            BOOL success = PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            return success != 0;
+        }
+
+        case COY_ACCESS_DONTNEED:
+        {
+            /* Unlocking pages that aren't locked takes them out of the working set, it "fails" with ERROR_NOT_LOCKED. */
+            /* BOOL success = */ VirtualUnlock(start, (SIZE_T)num_bytes);
+            return true;
+        }
+
+        default: return true; /* Windows has no equivalent. */
+    }
 }
 
 // I don't normally use static storage, but the linux interface uses it internally, so I'm stuck with those semantics.
@@ -611,6 +1067,23 @@ coy_get_terminal_size(void)
     return (CoyTerminalSize) { .columns = -1, .rows = -1 };
 }
 
+static inline size
+coy_memory_page_size(void)
+{
+    SYSTEM_INFO info = {0};
+    GetSystemInfo(&info);
+    return (size)info.dwPageSize;
+}
+
+static inline size
+coy_memory_allocation_granularity(void)
+{
+    /* Address space comes in 64 KiB pieces, coy_memory_allocate rounds anything bigger up to a whole piece. */
+    SYSTEM_INFO info = {0};
+    GetSystemInfo(&info);
+    return (size)info.dwAllocationGranularity;
+}
+
 static inline CoyMemoryBlock 
 coy_memory_allocate(size minimum_num_bytes)
 {
@@ -644,7 +1117,50 @@ coy_memory_allocate(size minimum_num_bytes)
          return (CoyMemoryBlock){.mem = 0, .size = 0, .valid = false };
     }
 
-    return (CoyMemoryBlock){.mem = mem, .size = a_size, .valid = true };
+    return (CoyMemoryBlock){.mem = mem, .size = a_size, .committed = a_size, .valid = true };
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_with_flags(size minimum_num_bytes, u32 flags)
+{
+    CoyMemoryBlock mem = { .valid = false };
+    if(minimum_num_bytes > 0 && (flags & (COY_MEMORY_FLAG_HUGE_PAGES | COY_MEMORY_FLAG_HUGE_PAGES_1GiB)))
+    {
+        /* Large pages need the SeLockMemoryPrivilege, if we don't have it VirtualAlloc fails and we use normal pages. There
+         * are no transparent huge pages on Windows.
+         */
+        uptr large_page_size = GetLargePageMinimum();
+        if(large_page_size)
+        {
+            uptr allocation_size = minimum_num_bytes + large_page_size - 1;
+            allocation_size -= allocation_size % large_page_size;
+
+            void *ptr = VirtualAlloc(NULL, allocation_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if(ptr)
+            {
+                CoyMemoryPageKind kind = large_page_size == COY_GiB(1) ? COY_MEMORY_PAGES_HUGE_1GiB : COY_MEMORY_PAGES_HUGE_2MiB;
+                mem = (CoyMemoryBlock)
+                    {
+                        .mem = ptr,
+                        .size = (size)allocation_size,
+                        .committed = (size)allocation_size,
+                        .page_kind = kind,
+                        .valid = true
+                    };
+            }
+        }
+    }
+
+    if(!mem.valid) { mem = coy_memory_allocate(minimum_num_bytes); }
+
+    /* Large pages are never paged out anyway. */
+    if(mem.valid && mem.page_kind == COY_MEMORY_PAGES_NORMAL && (flags & COY_MEMORY_FLAG_LOCKED) && !coy_memory_lock(&mem, false))
+    {
+        coy_memory_free(&mem);
+        return (CoyMemoryBlock){ .valid = false };
+    }
+
+    return mem;
 }
 
 static inline void
@@ -659,11 +1175,264 @@ coy_memory_free(CoyMemoryBlock *mem)
     return;
 }
 
+static inline void
+coy_memory_free_lazily(CoyMemoryBlock *mem)
+{
+    /* The OS may discard the pages instead of writing them to the page file, otherwise they stay in the working set. */
+    /* void *ptr = */ VirtualAlloc(mem->mem, mem->size, MEM_RESET, PAGE_READWRITE);
+}
+
+static inline CoyMemoryBlock
+coy_memory_reserve(size minimum_num_bytes)
+{
+    if(minimum_num_bytes <= 0)
+    {
+         return (CoyMemoryBlock){.mem = 0, .size = minimum_num_bytes, .valid = false };
+    }
+
+    SYSTEM_INFO info = {0};
+    GetSystemInfo(&info);
+    uptr alloc_gran = info.dwAllocationGranularity;
+
+    uptr reserve_size = minimum_num_bytes;
+    if(minimum_num_bytes % alloc_gran)
+    {
+        reserve_size += alloc_gran - (minimum_num_bytes % alloc_gran);
+    }
+
+    if(reserve_size > INTPTR_MAX)
+    {
+         return (CoyMemoryBlock){.mem = 0, .size = INTPTR_MAX, .valid = false };
+    }
+
+    void *mem = VirtualAlloc(NULL, reserve_size, MEM_RESERVE, PAGE_NOACCESS);
+    if(!mem)
+    {
+         return (CoyMemoryBlock){.mem = 0, .size = 0, .valid = false };
+    }
+
+    return (CoyMemoryBlock){.mem = mem, .size = (size)reserve_size, .committed = 0, .valid = true };
+}
+
+static inline b32
+coy_memory_commit(CoyMemoryBlock *mem, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= mem->size);
+    StopIf(!mem->valid, return false);
+
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size end = offset + num_bytes + page_size - 1;
+    end -= end % page_size;
+
+    void *ptr = VirtualAlloc((byte *)mem->mem + start, end - start, MEM_COMMIT, PAGE_READWRITE);
+    StopIf(!ptr, return false);
+
+    /* Clamped, committing pages that are already committed would count them twice. */
+    mem->committed = mem->committed + (end - start) < mem->size ? mem->committed + (end - start) : mem->size;
+    return true;
+}
+
+static inline b32
+coy_memory_decommit(CoyMemoryBlock *mem, size offset, size num_bytes)
+{
+    Assert(offset >= 0 && num_bytes >= 0 && offset + num_bytes <= mem->size);
+    StopIf(!mem->valid, return false);
+
+    size page_size = coy_memory_page_size();
+    size start = offset - offset % page_size;
+    size end = offset + num_bytes + page_size - 1;
+    end -= end % page_size;
+
+    BOOL success = VirtualFree((byte *)mem->mem + start, end - start, MEM_DECOMMIT);
+    StopIf(!success, return false);
+
+    /* Clamped, decommitting pages that aren't committed would take the count below zero. */
+    mem->committed = mem->committed > end - start ? mem->committed - (end - start) : 0;
+    return true;
+}
+
+static inline b32
+coy_memory_lock(CoyMemoryBlock const *mem, b32 on_fault)
+{
+    /* No lock on fault on Windows, and only committed pages can be locked. */
+    StopIf(!mem->valid, return false);
+    BOOL success = VirtualLock(mem->mem, mem->size);
+    return success != 0;
+}
+
+static inline b32
+coy_memory_unlock(CoyMemoryBlock const *mem)
+{
+    StopIf(!mem->valid, return false);
+    BOOL success = VirtualUnlock(mem->mem, mem->size);
+    return success != 0;
+}
+
+static inline b32
+coy_thread_stack_prefault_lock(size num_bytes)
+{
+    Assert(num_bytes > 0);
+    size page_size = coy_memory_page_size();
+
+    /* _alloca probes the guard pages in order, so the stack below this frame is committed. */
+    byte volatile *stack = _alloca(num_bytes);
+    for(size i = num_bytes - 1; i >= 0; i -= page_size) { stack[i] = 0; }
+    stack[0] = 0;
+
+    BOOL success = VirtualLock((void *)stack, num_bytes);
+    return success != 0;
+}
+
+static inline i32
+coy_numa_node_count(void)
+{
+    ULONG highest_node = 0;
+    BOOL success = GetNumaHighestNodeNumber(&highest_node);
+    StopIf(!success, return 1);
+    return (i32)highest_node + 1;
+}
+
+static inline CoyMemoryBlock
+coy_memory_allocate_numa(size minimum_num_bytes, i32 node)
+{
+    i32 num_nodes = coy_numa_node_count();
+    StopIf(node < COY_NUMA_INTERLEAVE || node >= num_nodes, return (CoyMemoryBlock){ .valid = false });
+    if(num_nodes == 1) { return coy_memory_allocate(minimum_num_bytes); }
+
+    CoyMemoryBlock mem = coy_memory_reserve(minimum_num_bytes);
+    StopIf(!mem.valid, return mem);
+
+    HANDLE process = GetCurrentProcess();
+    size page_size = coy_memory_page_size();
+    if(node != COY_NUMA_INTERLEAVE)
+    {
+        void *ptr = VirtualAllocExNuma(process, mem.mem, mem.size, MEM_COMMIT, PAGE_READWRITE, (DWORD)node);
+        if(!ptr)
+        {
+            coy_memory_free(&mem);
+            return (CoyMemoryBlock){ .valid = false };
+        }
+    }
+    else
+    {
+        /* There's no interleave policy on Windows, so commit the pages one at a time round robin across the nodes. */
+        for(size offset = 0, i = 0; offset < mem.size; offset += page_size, ++i)
+        {
+            byte *page = (byte *)mem.mem + offset;
+            void *ptr = VirtualAllocExNuma(process, page, page_size, MEM_COMMIT, PAGE_READWRITE, (DWORD)(i % num_nodes));
+            if(!ptr)
+            {
+                coy_memory_free(&mem);
+                return (CoyMemoryBlock){ .valid = false };
+            }
+        }
+    }
+
+    /* The node preference only takes effect when a page is first touched, so fault them all in now. */
+    for(size offset = 0; offset < mem.size; offset += page_size) { ((byte volatile *)mem.mem)[offset] = 0; }
+
+    mem.committed = mem.size;
+    return mem;
+}
+
+static inline i32
+coy_memory_node(CoyMemoryBlock const *mem)
+{
+    StopIf(!mem->valid || mem->committed == 0, return -1);
+
+    /* The page must be in the working set to report its node. */
+    byte volatile first = *(byte volatile *)mem->mem;
+    (void)first;
+
+    PSAPI_WORKING_SET_EX_INFORMATION info = { .VirtualAddress = mem->mem };
+    BOOL success = QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info));
+    StopIf(!success || !info.VirtualAttributes.Valid, return -1);
+
+    return (i32)info.VirtualAttributes.Node;
+}
+
+static inline b32
+coy_numa_bind_current_thread(i32 node)
+{
+    i32 num_nodes = coy_numa_node_count();
+    StopIf(node < 0 || node >= num_nodes, return false);
+    if(num_nodes == 1) { return true; }
+
+    /* Windows allocates from the node of the CPU a thread runs on, so the affinity takes care of the memory too. */
+    GROUP_AFFINITY affinity = {0};
+    BOOL success = GetNumaNodeProcessorMaskEx((USHORT)node, &affinity);
+    StopIf(!success || affinity.Mask == 0, return false);
+
+    success = SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+    StopIf(!success, return false);
+
+    return true;
+}
+
+static inline CoyRingBuffer
+coy_ring_buffer_create(size minimum_capacity)
+{
+    Assert(minimum_capacity > 0);
+
+    /* Views have to start on an allocation granularity boundary. */
+    SYSTEM_INFO info = {0};
+    GetSystemInfo(&info);
+    size alloc_gran = info.dwAllocationGranularity;
+    size capacity = minimum_capacity + alloc_gran - 1;
+    capacity -= capacity % alloc_gran;
+
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE,                 // Backed by the page file
+                                        NULL,                                 // Default security
+                                        PAGE_READWRITE,                       // Read / write access
+                                        (DWORD)((u64)capacity >> 32),         // High DWORD of the size
+                                        (DWORD)((u64)capacity & 0xFFFFFFFF),  // Low DWORD of the size
+                                        NULL);                                // No name
+    StopIf(!mapping, goto ERR_RETURN);
+
+    /* Find a free range big enough for both copies, release it, and map into it. Another thread could grab the range in
+     * between, so try a few times.
+     */
+    for(i32 attempt = 0; attempt < 16; ++attempt)
+    {
+        byte *buf = VirtualAlloc(NULL, 2 * capacity, MEM_RESERVE, PAGE_NOACCESS);
+        StopIf(!buf, goto ERR_CLOSE);
+        VirtualFree(buf, 0, MEM_RELEASE);
+
+        void *first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity, buf);
+        if(!first) { continue; }
+
+        void *second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity, buf + capacity);
+        if(!second)
+        {
+            UnmapViewOfFile(first);
+            continue;
+        }
+
+        return (CoyRingBuffer){ .buf = buf, .capacity = capacity, ._internal = (iptr)mapping, .valid = true };
+    }
+
+ERR_CLOSE:
+    CloseHandle(mapping);
+ERR_RETURN:
+    return (CoyRingBuffer){ .valid = false };
+}
+
+static inline void
+coy_ring_buffer_destroy(CoyRingBuffer *ring)
+{
+    UnmapViewOfFile(ring->buf + ring->capacity);
+    UnmapViewOfFile(ring->buf);
+    CloseHandle((HANDLE)ring->_internal);
+    ring->valid = false;
+}
+
 static inline u32 
 coy_thread_func_internal(void *thread_params)
 {
     CoyThread *thrd = thread_params;
     thrd->func(thrd->thread_data);
+    coy_scratch_release();
 
     return 0;
 }
@@ -107,6 +107,13 @@ test_memmap_read(void)
 	  Assert(test_str[i] == mmstr[i]); 
     }
 
+    // A small file is well under any lock limit.
+    success = coy_memmap_lock(&mmf);
+    Assert(success);
+    Assert(mmstr[0] == test_str[0]);
+    success = coy_memmap_unlock(&mmf);
+    Assert(success);
+
     coy_memmap_close(&mmf);
     Assert(!mmf.valid);
 
@@ -139,6 +146,1209 @@ test_file_slurp(void)
     return;
 }
 
+static void
+test_file_read_f64_into_vec(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "f64_vec_test.dat");
+    Assert(success);
+
+    i32 const num_vals = 100000;
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(writer.valid);
+    for(i32 i = 0; i < num_vals; ++i)
+    {
+        success = coy_file_write_f64(&writer, i * 0.5);
+        Assert(success);
+    }
+    coy_file_writer_close(&writer);
+
+    // Read it back without knowing how many values there are.
+    CoyVec vec = COY_VEC_CREATE(f64, COY_GiB(1));
+    Assert(vec.valid);
+
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    Assert(reader.valid);
+    f64 val = 0.0;
+    while(coy_file_read_f64(&reader, &val))
+    {
+        f64 *next = COY_VEC_PUSH(&vec, f64);
+        Assert(next);
+        *next = val;
+    }
+    coy_file_reader_close(&reader);
+
+    Assert(vec.len == num_vals);
+    for(i32 i = 0; i < num_vals; ++i) { Assert(COY_VEC_AT(&vec, f64, i) == i * 0.5); }
+
+    coy_vec_destroy(&vec);
+}
+
+static void
+test_file_read_ring(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "ring_test.dat");
+    Assert(success);
+
+    // Variable length records, [u32 length][length bytes], so plenty of them straddle the end of the ring.
+    i32 const num_records = 2000;
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(writer.valid);
+    for(i32 i = 0; i < num_records; ++i)
+    {
+        u32 len = (u32)(i * 7919) % 3000 + 1;
+        success = coy_file_write_u32(&writer, len);
+        Assert(success);
+        for(u32 j = 0; j < len; ++j)
+        {
+            success = coy_file_write_u8(&writer, (u8)(i + j));
+            Assert(success);
+        }
+    }
+    coy_file_writer_close(&writer);
+
+    CoyFileReader reader = coy_file_open_read_ring(path_buf, COY_KiB(4));
+    Assert(reader.valid && reader.ring.valid);
+    Assert(reader.ring.capacity >= COY_KiB(4));
+
+    i32 num_read = 0;
+    CoyByteView view = coy_file_peek(&reader, sizeof(u32));
+    while(view.num_bytes >= (size)sizeof(u32))
+    {
+        u32 len = 0;
+        memcpy(&len, view.data, sizeof(len));
+        Assert(len == (u32)(num_read * 7919) % 3000 + 1);
+
+        // Always contiguous, even across the end of the ring.
+        view = coy_file_peek(&reader, sizeof(u32) + len);
+        Assert(view.num_bytes >= sizeof(u32) + len);
+        u8 const *payload = (u8 const *)view.data + sizeof(u32);
+        for(u32 j = 0; j < len; ++j) { Assert(payload[j] == (u8)(num_read + j)); }
+
+        coy_file_consume(&reader, sizeof(u32) + len);
+        view = coy_file_peek(&reader, sizeof(u32));
+        ++num_read;
+    }
+    Assert(num_read == num_records);
+
+    coy_file_reader_close(&reader);
+    Assert(!reader.valid);
+
+    // The regular read functions work in ring mode too.
+    reader = coy_file_open_read_ring(path_buf, 1);
+    Assert(reader.valid);
+    for(i32 i = 0; i < 100; ++i)
+    {
+        u32 len = 0;
+        success = coy_file_read_u32(&reader, &len);
+        Assert(success && len == (u32)(i * 7919) % 3000 + 1);
+        for(u32 j = 0; j < len; ++j)
+        {
+            u8 val = 0;
+            success = coy_file_read_u8(&reader, &val);
+            Assert(success && val == (u8)(i + j));
+        }
+    }
+    coy_file_reader_close(&reader);
+}
+
+static void
+test_async_file(u32 extra_flags)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "async_test.dat");
+    Assert(success);
+
+    size const chunk_size = COY_KiB(64);
+    i32 const num_chunks = 100; // More than the queue depth.
+    CoyMemoryBlock mem = coy_memory_allocate(chunk_size * num_chunks);
+    Assert(mem.valid);
+    u32 *vals = mem.mem;
+    for(size i = 0; i < mem.size / (size)sizeof(u32); ++i) { vals[i] = (u32)i; }
+
+    // Write the chunks backwards, batches as big as the queue allows.
+    CoyAsyncFile async_file = {0};
+    CoyAsyncFile *file = &async_file;
+    success = coy_async_file_open(file, path_buf, COY_ASYNC_FLAG_WRITE | extra_flags);
+    Assert(success);
+    if(extra_flags & COY_ASYNC_FLAG_NO_IO_URING) { Assert(!file->using_io_uring); }
+
+    // Too big for one request, the buffer is never touched.
+    Assert(!coy_async_file_queue_read(file, 0, (size)UINT32_MAX + 1, mem.mem, NULL));
+
+    CoyAsyncCompletion completions[COY_ASYNC_QUEUE_DEPTH];
+    i32 next_chunk = num_chunks - 1;
+    i32 num_completed = 0;
+    while(num_completed < num_chunks)
+    {
+        while(next_chunk >= 0)
+        {
+            byte const *chunk = (byte const *)mem.mem + next_chunk * chunk_size;
+            if(!coy_async_file_queue_write(file, next_chunk * chunk_size, chunk_size, chunk, (void *)(iptr)next_chunk)) { break; }
+            --next_chunk;
+        }
+        Assert(coy_async_file_submit(file) >= 0);
+
+        i32 num_reaped = coy_async_file_reap(file, COY_ASYNC_QUEUE_DEPTH, completions, true);
+        Assert(num_reaped > 0);
+        for(i32 i = 0; i < num_reaped; ++i)
+        {
+            Assert(completions[i].is_write && completions[i].result == chunk_size);
+        }
+        num_completed += num_reaped;
+    }
+    Assert(coy_async_file_reap(file, COY_ASYNC_QUEUE_DEPTH, completions, true) == 0);
+    coy_async_file_close(file);
+    Assert(!file->valid);
+    Assert(coy_file_size(path_buf) == chunk_size * num_chunks);
+
+    // Read it back in odd sized pieces, the last one runs off the end of the file.
+    success = coy_async_file_open(file, path_buf, extra_flags);
+    Assert(success);
+
+    CoyMemoryBlock read_mem = coy_memory_allocate(mem.size + chunk_size);
+    Assert(read_mem.valid);
+    size const piece_size = 3 * COY_KiB(17);
+    size num_pieces = mem.size / piece_size + 1;
+    size next_piece = 0;
+    size total_read = 0;
+    size num_pieces_done = 0;
+    while(num_pieces_done < num_pieces)
+    {
+        while(next_piece < num_pieces)
+        {
+            byte *dest = (byte *)read_mem.mem + next_piece * piece_size;
+            if(!coy_async_file_queue_read(file, next_piece * piece_size, piece_size, dest, NULL)) { break; }
+            ++next_piece;
+        }
+        Assert(coy_async_file_submit(file) >= 0);
+
+        i32 num_reaped = coy_async_file_reap(file, 7, completions, true);
+        Assert(num_reaped > 0 && num_reaped <= 7);
+        for(i32 i = 0; i < num_reaped; ++i)
+        {
+            Assert(!completions[i].is_write && completions[i].result >= 0);
+            total_read += completions[i].result;
+        }
+        num_pieces_done += num_reaped;
+    }
+    Assert(total_read == mem.size);
+
+    u32 const *read_vals = read_mem.mem;
+    for(size i = 0; i < mem.size / (size)sizeof(u32); ++i) { Assert(read_vals[i] == (u32)i); }
+
+    // Closing with reads still in flight waits for them.
+    success = coy_async_file_queue_read(file, 0, chunk_size, read_mem.mem, NULL);
+    Assert(success);
+    Assert(coy_async_file_submit(file) == 1);
+    coy_async_file_close(file);
+    Assert(!file->valid);
+
+    coy_memory_free(&read_mem);
+    coy_memory_free(&mem);
+
+    success = coy_async_file_open(file, "not_a_real_file.dat", extra_flags);
+    Assert(!success && !file->valid);
+}
+
+static void
+test_file_peek_consume(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "peek_test.dat");
+    Assert(success);
+
+    u32 const num_vals = 100000;
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(writer.valid);
+    for(u32 i = 0; i < num_vals; ++i)
+    {
+        success = coy_file_write_u32(&writer, i);
+        Assert(success);
+    }
+    coy_file_writer_close(&writer);
+
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    Assert(reader.valid);
+
+    // Peeking doesn't move through the file, consuming does.
+    u32 val = 0;
+    CoyByteView view = coy_file_peek(&reader, sizeof(u32));
+    Assert(view.num_bytes >= (size)sizeof(u32));
+    memcpy(&val, view.data, sizeof(val));
+    Assert(val == 0);
+    view = coy_file_peek(&reader, 3 * sizeof(u32));
+    Assert(view.num_bytes >= 3 * (size)sizeof(u32));
+    memcpy(&val, view.data, sizeof(val));
+    Assert(val == 0);
+    coy_file_consume(&reader, 3 * sizeof(u32));
+    success = coy_file_read_u32(&reader, &val);
+    Assert(success && val == 3);
+
+    // A big read picks up the buffered bytes and then goes straight to the file.
+    u32 const num_big = 20000;
+    CoyMemoryBlock mem = coy_memory_allocate(num_big * sizeof(u32));
+    Assert(mem.valid);
+    size num_bytes_read = coy_file_read(&reader, num_big * sizeof(u32), mem.mem);
+    Assert(num_bytes_read == num_big * (size)sizeof(u32));
+    u32 const *vals = mem.mem;
+    for(u32 i = 0; i < num_big; ++i) { Assert(vals[i] == i + 4); }
+
+    // Peek works across refills, all the way to the end of the file.
+    u32 next = num_big + 4;
+    view = coy_file_peek(&reader, reader.buf_size);
+    while(view.num_bytes > 0)
+    {
+        Assert(view.num_bytes % sizeof(u32) == 0);
+        for(size i = 0; i < view.num_bytes; i += sizeof(u32))
+        {
+            memcpy(&val, view.data + i, sizeof(val));
+            Assert(val == next++);
+        }
+        coy_file_consume(&reader, view.num_bytes);
+        view = coy_file_peek(&reader, reader.buf_size);
+    }
+    Assert(view.num_bytes == 0);
+    Assert(next == num_vals);
+
+    coy_memory_free(&mem);
+    coy_file_reader_close(&reader);
+}
+
+static void
+test_file_caller_buffers(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "buffers_test.dat");
+    Assert(success);
+
+    // The handles don't carry their buffers around with them.
+    Assert(sizeof(CoyFileReader) < 256 && sizeof(CoyFileWriter) < 256);
+
+    // A tiny writer buffer, so writes are buffered, flushed, and bypass the buffer.
+    byte write_buf[7];
+    CoyFileWriter writer = coy_file_create_with_buffer(path_buf, sizeof(write_buf), write_buf);
+    Assert(writer.valid && writer.buffer == write_buf && !writer.buffer_mem.valid);
+    u32 const num_vals = 5000;
+    for(u32 i = 0; i < num_vals; ++i)
+    {
+        success = coy_file_write_u32(&writer, i);
+        Assert(success);
+    }
+    coy_file_writer_close(&writer);
+    Assert(!writer.valid);
+
+    writer = coy_file_append_with_buffer(path_buf, sizeof(write_buf), write_buf);
+    Assert(writer.valid);
+    success = coy_file_write_u16(&writer, 0xBEEF);
+    Assert(success);
+    coy_file_writer_close(&writer);
+    Assert(coy_file_size(path_buf) == num_vals * sizeof(u32) + sizeof(u16));
+
+    // A big reader buffer from an arena.
+    CoyArena arena = coy_arena_create(COY_MiB(4) + COY_KiB(4));
+    Assert(arena.valid);
+    byte *read_buf = coy_arena_push(&arena, COY_MiB(4), 16);
+    Assert(read_buf);
+    CoyFileReader reader = coy_file_open_read_with_buffer(path_buf, COY_MiB(4), read_buf);
+    Assert(reader.valid && reader.buffer == read_buf && reader.buf_size == COY_MiB(4));
+    u32 val = 0;
+    for(u32 i = 0; i < num_vals; ++i)
+    {
+        success = coy_file_read_u32(&reader, &val);
+        Assert(success && val == i);
+    }
+    u16 val16 = 0;
+    success = coy_file_read_u16(&reader, &val16);
+    Assert(success && val16 == 0xBEEF);
+    Assert(!coy_file_read_u8(&reader, (u8 *)&val16));
+    coy_file_reader_close(&reader);
+    Assert(!reader.valid);
+
+    // And a tiny one on the stack.
+    byte small_buf[5];
+    reader = coy_file_open_read_with_buffer(path_buf, sizeof(small_buf), small_buf);
+    Assert(reader.valid);
+    for(u32 i = 0; i < num_vals; ++i)
+    {
+        success = coy_file_read_u32(&reader, &val);
+        Assert(success && val == i);
+    }
+    coy_file_reader_close(&reader);
+
+    coy_arena_destroy(&arena);
+
+    reader = coy_file_open_read_with_buffer("not_a_real_file.dat", sizeof(small_buf), small_buf);
+    Assert(!reader.valid);
+    reader = coy_file_open_read("not_a_real_file.dat");
+    Assert(!reader.valid && !reader.buffer_mem.valid);
+}
+
+static void
+test_file_vectored_io(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "vectored_test.dat");
+    Assert(success);
+
+    CoyMemoryBlock mem = coy_memory_allocate(COY_KiB(200));
+    Assert(mem.valid);
+    u8 *payload = mem.mem;
+    for(size i = 0; i < mem.size; ++i) { payload[i] = (u8)(i * 31); }
+
+    // Records of [u32 length][u32 tag][payload], some fit in the buffer and some don't, mixed in with buffered writes.
+    byte write_buf[256];
+    CoyFileWriter writer = coy_file_create_with_buffer(path_buf, sizeof(write_buf), write_buf);
+    Assert(writer.valid);
+    i32 const num_records = 40;
+    size expected_size = 0;
+    for(i32 i = 0; i < num_records; ++i)
+    {
+        u32 len = (i % 3 == 0) ? (u32)(i * 4000) : (u32)(i * 5);
+        u32 tag = 0xC0DE0000 | (u32)i;
+        CoyIoVec vecs[] = { { &len, sizeof(len) }, { &tag, sizeof(tag) }, { payload, len } };
+        size num_bytes_written = coy_file_writev(&writer, 3, vecs);
+        Assert(num_bytes_written == 2 * sizeof(u32) + len);
+
+        success = coy_file_write_u8(&writer, 0xAB);
+        Assert(success);
+        expected_size += 2 * sizeof(u32) + len + 1;
+    }
+    coy_file_writer_close(&writer);
+    Assert(coy_file_size(path_buf) == expected_size);
+
+    // Read them back in pieces, the payloads straight into place.
+    CoyMemoryBlock read_mem = coy_memory_allocate(COY_KiB(200));
+    Assert(read_mem.valid);
+    u8 *read_payload = read_mem.mem;
+
+    byte read_buf[100];
+    CoyFileReader reader = coy_file_open_read_with_buffer(path_buf, sizeof(read_buf), read_buf);
+    Assert(reader.valid);
+    for(i32 i = 0; i < num_records; ++i)
+    {
+        u32 len = 0;
+        u32 tag = 0;
+        CoyIoVec header[] = { { &len, sizeof(len) }, { &tag, sizeof(tag) } };
+        Assert(coy_file_readv(&reader, 2, header) == 2 * sizeof(u32));
+        Assert(len == ((i % 3 == 0) ? (u32)(i * 4000) : (u32)(i * 5)));
+        Assert(tag == (0xC0DE0000 | (u32)i));
+
+        u8 marker = 0;
+        CoyIoVec body[] = { { read_payload, len }, { &marker, 1 } };
+        Assert(coy_file_readv(&reader, 2, body) == len + 1);
+        Assert(marker == 0xAB);
+        for(u32 j = 0; j < len; ++j) { Assert(read_payload[j] == payload[j]); }
+    }
+
+    // Short at the end of the file.
+    u32 extra = 0;
+    CoyIoVec past_end[] = { { &extra, sizeof(extra) } };
+    Assert(coy_file_readv(&reader, 1, past_end) == 0);
+    Assert(reader.file_offset == expected_size);
+    coy_file_reader_close(&reader);
+
+    coy_memory_free(&read_mem);
+    coy_memory_free(&mem);
+}
+
+static void
+test_file_background_writer(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "background_test.dat");
+    Assert(success);
+
+    CoyMemoryBlock mem = coy_memory_allocate(COY_KiB(20));
+    Assert(mem.valid);
+    u32 *big = mem.mem;
+
+    // Small buffers so the I/O thread falls behind and the writer has to wait on it.
+    CoyFileWriter writer = coy_file_create_background(path_buf, COY_KiB(4), 3);
+    Assert(writer.valid && writer.background);
+    u32 next = 0;
+    for(i32 i = 0; i < 200; ++i)
+    {
+        for(i32 j = 0; j < 500; ++j)
+        {
+            success = coy_file_write_u32(&writer, next++);
+            Assert(success);
+        }
+
+        // Big writes still come out in order.
+        size num_big = mem.size / sizeof(u32);
+        for(size j = 0; j < num_big; ++j) { big[j] = next++; }
+        Assert(coy_file_write(&writer, mem.size, mem.mem) == mem.size);
+
+        u32 a = next++;
+        u32 b = next++;
+        CoyIoVec vecs[] = { { &a, sizeof(a) }, { &b, sizeof(b) } };
+        Assert(coy_file_writev(&writer, 2, vecs) == 2 * sizeof(u32));
+
+        if(i % 50 == 0) { Assert(coy_file_writer_flush(&writer) >= 0); }
+    }
+    Assert(coy_file_writer_close(&writer));
+    Assert(!writer.valid);
+    Assert(coy_file_size(path_buf) == next * (size)sizeof(u32));
+
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    Assert(reader.valid);
+    for(u32 i = 0; i < next; ++i)
+    {
+        u32 val = 0;
+        success = coy_file_read_u32(&reader, &val);
+        Assert(success && val == i);
+    }
+    coy_file_reader_close(&reader);
+
+    // Appending works the same way.
+    writer = coy_file_append_background(path_buf, COY_KiB(4), 2);
+    Assert(writer.valid);
+    success = coy_file_write_u32(&writer, next);
+    Assert(success);
+    Assert(coy_file_writer_close(&writer));
+    Assert(coy_file_size(path_buf) == (next + 1) * (size)sizeof(u32));
+
+#if defined(__linux__)
+    // Every write to /dev/full fails, the error comes back on a later write or on close.
+    writer = coy_file_create_background("/dev/full", COY_KiB(4), 2);
+    Assert(writer.valid);
+    b32 saw_error = false;
+    for(i32 i = 0; i < 100 && !saw_error; ++i)
+    {
+        saw_error = coy_file_write(&writer, mem.size, mem.mem) < 0;
+    }
+    Assert(saw_error);
+    Assert(!coy_file_writer_close(&writer));
+#endif
+
+    coy_memory_free(&mem);
+}
+
+static void
+test_direct_io(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "direct_test.dat");
+    Assert(success);
+
+    // A file size that isn't a multiple of the alignment, so there's a tail to deal with.
+    size const file_size = COY_MiB(3) + 1234;
+    size const padded_size = (file_size + COY_FILE_DIRECT_ALIGNMENT - 1) / COY_FILE_DIRECT_ALIGNMENT * COY_FILE_DIRECT_ALIGNMENT;
+    CoyMemoryBlock mem = coy_memory_allocate(padded_size);
+    Assert(mem.valid);
+    u8 *data = mem.mem;
+    for(size i = 0; i < padded_size; ++i) { data[i] = (u8)(i * 7 + i / 4096); }
+
+    // Write it in aligned blocks, the last one padded out, then trim the file.
+    CoyAsyncFile async_file = {0};
+    CoyAsyncFile *file = &async_file;
+    success = coy_async_file_open(file, path_buf, COY_ASYNC_FLAG_WRITE | COY_ASYNC_FLAG_DIRECT);
+    Assert(success);
+
+    // Some file systems refuse direct I/O and the file is opened the normal way, the data has to round trip either way.
+    // Direct I/O needs aligned memory, offsets, and sizes.
+    if(file->direct) { Assert((uptr)data % COY_FILE_DIRECT_ALIGNMENT == 0); }
+
+    size const block_size = COY_KiB(64);
+    size next_offset = 0;
+    size total_written = 0;
+    CoyAsyncCompletion completions[COY_ASYNC_QUEUE_DEPTH];
+    while(total_written < padded_size)
+    {
+        while(next_offset < padded_size)
+        {
+            size num_bytes = padded_size - next_offset > block_size ? block_size : padded_size - next_offset;
+            if(file->direct)
+            {
+                Assert(next_offset % COY_FILE_DIRECT_ALIGNMENT == 0 && num_bytes % COY_FILE_DIRECT_ALIGNMENT == 0);
+            }
+            if(!coy_async_file_queue_write(file, next_offset, num_bytes, (byte *)data + next_offset, NULL)) { break; }
+            next_offset += num_bytes;
+        }
+        Assert(coy_async_file_submit(file) >= 0);
+
+        i32 num_reaped = coy_async_file_reap(file, COY_ASYNC_QUEUE_DEPTH, completions, true);
+        Assert(num_reaped > 0);
+        for(i32 i = 0; i < num_reaped; ++i) { Assert(completions[i].result > 0); total_written += completions[i].result; }
+    }
+    Assert(total_written == padded_size);
+    Assert(coy_async_file_set_size(file, file_size));
+    coy_async_file_close(file);
+    Assert(coy_file_size(path_buf) == file_size);
+
+    // Scan it back, block_size gets rounded up to the alignment.
+    CoyDirectReader direct_reader = {0};
+    CoyDirectReader *reader = &direct_reader;
+    success = coy_direct_reader_open(reader, path_buf, 10000, 8);
+    Assert(success);
+    Assert(reader->block_size >= 10000);
+    if(reader->file.direct) { Assert(reader->block_size % COY_FILE_DIRECT_ALIGNMENT == 0); }
+
+    size offset = 0;
+    CoyByteView view = coy_direct_reader_next(reader);
+    while(view.num_bytes > 0)
+    {
+        Assert(view.num_bytes == reader->block_size || offset + view.num_bytes == file_size);
+        if(reader->file.direct) { Assert((uptr)view.data % COY_FILE_DIRECT_ALIGNMENT == 0); }
+        u8 const *read_data = (u8 const *)view.data;
+        for(size i = 0; i < view.num_bytes; ++i) { Assert(read_data[i] == data[offset + i]); }
+        offset += view.num_bytes;
+        view = coy_direct_reader_next(reader);
+    }
+    Assert(view.num_bytes == 0);
+    Assert(offset == file_size);
+    coy_direct_reader_close(reader);
+    Assert(!reader->valid);
+
+    // Stopping early is fine too.
+    success = coy_direct_reader_open(reader, path_buf, COY_KiB(4), 4);
+    Assert(success);
+    view = coy_direct_reader_next(reader);
+    Assert(view.num_bytes == COY_KiB(4));
+    coy_direct_reader_close(reader);
+
+    coy_memory_free(&mem);
+
+    success = coy_direct_reader_open(reader, "not_a_real_file.dat", COY_KiB(4), 4);
+    Assert(!success && !reader->valid);
+}
+
+static void
+test_file_access_hints(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "hints_test.dat");
+    Assert(success);
+
+    // Big enough for a few rounds of dropping pages behind.
+    size const file_size = 3 * COY_FILE_DROP_BEHIND_BYTES;
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(writer.valid);
+    for(u32 i = 0; i < file_size / sizeof(u32); ++i)
+    {
+        success = coy_file_write_u32(&writer, i);
+        Assert(success);
+    }
+    Assert(coy_file_writer_close(&writer));
+
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    Assert(reader.valid);
+    Assert(coy_file_advise(&reader, COY_ACCESS_RANDOM, 0, 0));
+    Assert(coy_file_advise(&reader, COY_ACCESS_WILLNEED, COY_MiB(1), COY_MiB(2)));
+    Assert(coy_file_advise(&reader, COY_ACCESS_NORMAL, 0, 0));
+
+    // Streaming reads the same data.
+    Assert(coy_file_set_streaming(&reader, true));
+    for(u32 i = 0; i < file_size / sizeof(u32); ++i)
+    {
+        u32 val = 0;
+        success = coy_file_read_u32(&reader, &val);
+        Assert(success && val == i);
+    }
+    Assert(reader.file_offset == file_size);
+    Assert(reader.dropped_through >= 2 * COY_FILE_DROP_BEHIND_BYTES);
+    coy_file_reader_close(&reader);
+
+    CoyMemMappedFile mm = coy_memmap_read_only(path_buf);
+    Assert(mm.valid);
+
+    Assert(coy_memmap_advise(&mm, COY_ACCESS_SEQUENTIAL, 0, 0));
+    Assert(coy_memmap_advise(&mm, COY_ACCESS_WILLNEED, 12345, COY_MiB(1)));
+    u32 const *vals = (u32 const *)mm.data;
+    for(u32 i = 0; i < COY_MiB(1) / sizeof(u32); ++i) { Assert(vals[i] == i); }
+    Assert(coy_memmap_advise(&mm, COY_ACCESS_DONTNEED, 0, COY_MiB(1)));
+    Assert(coy_memmap_advise(&mm, COY_ACCESS_RANDOM, 0, 0));
+    for(u32 i = 0; i < file_size / sizeof(u32); i += 4099) { Assert(vals[i] == i); }
+    coy_memmap_close(&mm);
+}
+
+static void
+test_memmap_write(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "memmap_write_test.dat");
+    Assert(success);
+
+    size const first_size = COY_KiB(64);
+    CoyMemMappedFile mm = coy_memmap_create(path_buf, first_size);
+    Assert(mm.valid && mm.writable && mm.size_in_bytes == first_size);
+    Assert(coy_file_size(path_buf) == first_size);
+    for(size i = 0; i < first_size; ++i) { mm.writable_data[i] = (byte)(i % 251); }
+    Assert(coy_memmap_flush(&mm, 1000, 5000, false));
+
+    // Grow it, the old contents come along.
+    size const second_size = COY_MiB(1) + 5;
+    success = coy_memmap_grow(&mm, second_size);
+    Assert(success && mm.size_in_bytes == second_size);
+    Assert(coy_file_size(path_buf) == second_size);
+    for(size i = 0; i < first_size; ++i) { Assert((u8)mm.writable_data[i] == (u8)(i % 251)); }
+    for(size i = first_size; i < second_size; ++i) { mm.writable_data[i] = (byte)(i % 13); }
+    Assert(coy_memmap_flush(&mm, 0, 0, true));
+    coy_memmap_close(&mm);
+    Assert(!mm.valid);
+
+    // Everything made it into the file.
+    CoyMemMappedFile ro = coy_memmap_read_only(path_buf);
+    Assert(ro.valid && !ro.writable && ro.size_in_bytes == second_size);
+    for(size i = 0; i < first_size; ++i) { Assert((u8)ro.data[i] == (u8)(i % 251)); }
+    for(size i = first_size; i < second_size; ++i) { Assert((u8)ro.data[i] == (u8)(i % 13)); }
+    coy_memmap_close(&ro);
+
+    // Change an existing file in place.
+    mm = coy_memmap_read_write(path_buf);
+    Assert(mm.valid && mm.size_in_bytes == second_size);
+    mm.writable_data[second_size - 1] = 42;
+    coy_memmap_close(&mm);
+
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    Assert(reader.valid);
+    CoyMemoryBlock mem = coy_memory_allocate(second_size);
+    Assert(mem.valid);
+    Assert(coy_file_read(&reader, second_size, mem.mem) == second_size);
+    Assert(((byte *)mem.mem)[second_size - 1] == 42);
+    Assert((u8)((byte *)mem.mem)[second_size - 2] == (u8)((second_size - 2) % 13));
+    coy_memory_free(&mem);
+    coy_file_reader_close(&reader);
+
+    // Empty and missing files can't be mapped.
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(coy_file_writer_close(&writer));
+    mm = coy_memmap_read_write(path_buf);
+    Assert(!mm.valid);
+    mm = coy_memmap_read_write("not_a_real_file.dat");
+    Assert(!mm.valid);
+}
+
+static void
+test_memmap_windows(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "memmap_window_test.dat");
+    Assert(success);
+
+    // Not a multiple of a page, or of a window.
+    size const file_size = COY_MiB(1) + 777;
+    CoyMemMappedFile mm = coy_memmap_create(path_buf, file_size);
+    Assert(mm.valid);
+    for(size i = 0; i < file_size; ++i) { mm.writable_data[i] = (byte)(i % 251); }
+    coy_memmap_close(&mm);
+
+    // A window starting in the middle of a page.
+    CoyMemMappedFile win = coy_memmap_read_window(path_buf, 70001, 5000, false);
+    Assert(win.valid && win.offset == 70001 && win.size_in_bytes == 5000);
+    for(size i = 0; i < win.size_in_bytes; ++i) { Assert((u8)win.data[i] == (u8)((70001 + i) % 251)); }
+    Assert(coy_memmap_advise(&win, COY_ACCESS_WILLNEED, 0, 0));
+    Assert(coy_memmap_advise(&win, COY_ACCESS_SEQUENTIAL, 123, 4000));
+    coy_memmap_close(&win);
+    Assert(!win.valid);
+
+    // Through the end, populated.
+    win = coy_memmap_read_window(path_buf, file_size - 100, 0, true);
+    Assert(win.valid && win.size_in_bytes == 100);
+    Assert((u8)win.data[99] == (u8)((file_size - 1) % 251));
+    coy_memmap_close(&win);
+
+    // Windows that don't fit in the file.
+    win = coy_memmap_read_window(path_buf, file_size - 100, 101, false);
+    Assert(!win.valid);
+    win = coy_memmap_read_window(path_buf, file_size, 0, false);
+    Assert(!win.valid);
+
+    // Slide over the whole file, the overlap repeats the end of each window at the start of the next.
+    size const window_size = COY_KiB(64) + 3;
+    size const overlap = 1000;
+    CoyMemMapWindowIter iter = coy_memmap_window_iterator_open(path_buf, window_size, overlap);
+    Assert(iter.valid && iter.file_size == file_size);
+
+    size expected_offset = 0;
+    i32 num_windows = 0;
+    CoyMemMappedFile const *window = NULL;
+    while((window = coy_memmap_window_iterator_next(&iter)))
+    {
+        Assert(window->offset == expected_offset);
+        Assert(coy_memmap_advise(window, COY_ACCESS_SEQUENTIAL, 0, 0));
+        Assert(window->size_in_bytes == window_size || window->offset + window->size_in_bytes == file_size);
+        for(size i = 0; i < window->size_in_bytes; ++i)
+        {
+            Assert((u8)window->data[i] == (u8)((window->offset + i) % 251));
+        }
+
+        expected_offset += window_size - overlap;
+        ++num_windows;
+    }
+    Assert(iter.valid);
+    Assert(num_windows == (i32)((file_size - overlap + (window_size - overlap) - 1) / (window_size - overlap)));
+    Assert(!coy_memmap_window_iterator_next(&iter));
+    coy_memmap_window_iterator_close(&iter);
+    Assert(!iter.valid);
+
+    // An empty file has no windows.
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(coy_file_writer_close(&writer));
+    iter = coy_memmap_window_iterator_open(path_buf, window_size, 0);
+    Assert(iter.valid && !coy_memmap_window_iterator_next(&iter));
+    coy_memmap_window_iterator_close(&iter);
+
+    iter = coy_memmap_window_iterator_open("not_a_real_file.dat", window_size, 0);
+    Assert(!iter.valid);
+    coy_memmap_window_iterator_close(&iter);
+}
+
+static void
+test_file_slurp_arena(void)
+{
+    char const test_str[] =
+	  "This directory should remain empty other than this file. It is used for writing test results into.\n\n";
+
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "README.md");
+    Assert(success);
+
+    CoyArena arena = coy_arena_create(COY_MiB(1));
+    Assert(arena.valid);
+
+    CoyByteView view = coy_file_slurp_arena(path_buf, &arena);
+    Assert(view.num_bytes == sizeof(test_str) - 1);
+    for(size i = 0; i < view.num_bytes; ++i) { Assert(view.data[i] == test_str[i]); }
+    Assert(view.data[view.num_bytes] == 0);
+    Assert(arena.offset == view.num_bytes + 1);
+
+    // Nothing is left behind on errors.
+    view = coy_file_slurp_arena("not_a_real_file.dat", &arena);
+    Assert(view.num_bytes == -1 && !view.data);
+    Assert(arena.offset == sizeof(test_str));
+
+    // Files of different sizes, one of them empty and one missing.
+    char names[5][1024] = {0};
+    size const sizes[] = { COY_KiB(100) + 1, 0, 3, -1, COY_KiB(4) };
+    for(i32 i = 0; i < COY_ARRAY_SIZE(sizes); ++i)
+    {
+        success = coy_path_append(sizeof(names[i]), names[i], test_data_dir);
+        Assert(success);
+        char name[64] = {0};
+        snprintf(name, sizeof(name), "slurp_batch_%d.dat", i);
+        success = coy_path_append(sizeof(names[i]), names[i], name);
+        Assert(success);
+
+        if(sizes[i] < 0) { continue; }
+        CoyFileWriter writer = coy_file_create(names[i]);
+        Assert(writer.valid);
+        for(size j = 0; j < sizes[i]; ++j) { Assert(coy_file_write_u8(&writer, (u8)(i + j))); }
+        Assert(coy_file_writer_close(&writer));
+    }
+
+    char const *filenames[] = { names[0], names[1], names[2], names[3], names[4] };
+    for(i32 num_threads = 1; num_threads <= 8; num_threads *= 2)
+    {
+        coy_arena_reset(&arena);
+
+        CoyByteView views[COY_ARRAY_SIZE(filenames)] = {0};
+        success = coy_file_slurp_batch(COY_ARRAY_SIZE(filenames), filenames, &arena, num_threads, views);
+        Assert(!success);
+
+        byte const *expected_start = views[0].data;
+        for(i32 i = 0; i < COY_ARRAY_SIZE(sizes); ++i)
+        {
+            Assert(views[i].num_bytes == sizes[i]);
+            if(sizes[i] < 0) { Assert(!views[i].data); continue; }
+
+            // Back to back in one block.
+            Assert(views[i].data == expected_start);
+            expected_start += sizes[i] + 1;
+
+            for(size j = 0; j < sizes[i]; ++j) { Assert((u8)views[i].data[j] == (u8)(i + j)); }
+            Assert(views[i].data[sizes[i]] == 0);
+        }
+    }
+
+    // Without the missing file it all works.
+    filenames[3] = names[4];
+    CoyByteView views[4] = {0};
+    success = coy_file_slurp_batch(4, filenames, &arena, 4, views);
+    Assert(success && views[3].num_bytes == sizes[4]);
+
+    // More files than can be open at once still come back in one block.
+    i32 const num_many = 2 * COY_FILE_SLURP_MAX_OPEN + 7;
+    CoyArena name_arena = coy_arena_create(COY_MiB(1));
+    Assert(name_arena.valid);
+    char const **many_names = COY_ARENA_PUSH_ARRAY(&name_arena, char const *, num_many);
+    CoyByteView *many_views = COY_ARENA_PUSH_ARRAY(&name_arena, CoyByteView, num_many);
+    Assert(many_names && many_views);
+    for(i32 i = 0; i < num_many; ++i)
+    {
+        char *name = COY_ARENA_PUSH_ARRAY(&name_arena, char, 1024);
+        Assert(name);
+        name[0] = 0;
+        success = coy_path_append(1024, name, test_data_dir);
+        Assert(success);
+        char file_name[64] = {0};
+        snprintf(file_name, sizeof(file_name), "slurp_many_%d.dat", i);
+        success = coy_path_append(1024, name, file_name);
+        Assert(success);
+        many_names[i] = name;
+
+        CoyFileWriter writer = coy_file_create(name);
+        Assert(writer.valid);
+        for(i32 j = 0; j < i % 5 + 1; ++j) { Assert(coy_file_write_u8(&writer, (u8)(i + j))); }
+        Assert(coy_file_writer_close(&writer));
+    }
+
+    coy_arena_reset(&arena);
+    success = coy_file_slurp_batch(num_many, many_names, &arena, 4, many_views);
+    Assert(success);
+    byte const *expected_start = many_views[0].data;
+    for(i32 i = 0; i < num_many; ++i)
+    {
+        Assert(many_views[i].data == expected_start && many_views[i].num_bytes == i % 5 + 1);
+        for(i32 j = 0; j < i % 5 + 1; ++j) { Assert((u8)many_views[i].data[j] == (u8)(i + j)); }
+        Assert(many_views[i].data[many_views[i].num_bytes] == 0);
+        expected_start += many_views[i].num_bytes + 1;
+    }
+    coy_arena_destroy(&name_arena);
+
+    coy_arena_destroy(&arena);
+}
+
+static void
+test_file_typed_arrays(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "typed_arrays_test.dat");
+    Assert(success);
+
+    size const count = 100000;
+    CoyMemoryBlock mem = coy_memory_allocate(2 * count * (sizeof(f64) + sizeof(u32) + sizeof(i16) + sizeof(u64)));
+    Assert(mem.valid);
+    f64 *f64s = mem.mem;
+    f64 *f64s_in = f64s + count;
+    u32 *u32s = (u32 *)(f64s_in + count);
+    u32 *u32s_in = u32s + count;
+    u64 *u64s = (u64 *)(u32s_in + count);
+    u64 *u64s_in = u64s + count;
+    i16 *i16s = (i16 *)(u64s_in + count);
+    i16 *i16s_in = i16s + count;
+    for(size i = 0; i < count; ++i)
+    {
+        f64s[i] = (f64)i * 0.5 - 7.0;
+        u32s[i] = (u32)(i * 2654435761u);
+        u64s[i] = (u64)i * UINT64_C(0x9E3779B97F4A7C15);
+        i16s[i] = (i16)(i - 30000);
+    }
+
+    // A tiny odd sized buffer splits values across flushes, the default one lets big blocks skip it.
+    byte small_buf[13] = {0};
+    for(i32 pass = 0; pass < 2; ++pass)
+    {
+        CoyFileWriter writer = pass == 0 ? coy_file_create_with_buffer(path_buf, sizeof(small_buf), small_buf)
+                                         : coy_file_create(path_buf);
+        Assert(writer.valid);
+        Assert(coy_file_write_u8(&writer, 7)); // Nothing lines up with the buffer after this.
+        Assert(coy_file_write_f64_array(&writer, count, f64s, COY_BYTE_ORDER_NATIVE));
+        Assert(coy_file_write_u32_array(&writer, count, u32s, COY_BYTE_ORDER_BIG));
+        Assert(coy_file_write_u64_array(&writer, count, u64s, COY_BYTE_ORDER_BIG));
+        Assert(coy_file_write_i16_array(&writer, count, i16s, COY_BYTE_ORDER_LITTLE));
+        Assert(coy_file_write_u32_array(&writer, 1, u32s + 1, COY_BYTE_ORDER_BIG));
+        Assert(coy_file_write_u32_array(&writer, 0, u32s, COY_BYTE_ORDER_BIG));
+        Assert(coy_file_writer_close(&writer));
+
+        size const file_size = 1 + count * (sizeof(f64) + sizeof(u32) + sizeof(u64) + sizeof(i16)) + sizeof(u32);
+        Assert(coy_file_size(path_buf) == file_size);
+
+        CoyFileReader reader = coy_file_open_read(path_buf);
+        Assert(reader.valid);
+        u8 first = 0;
+        Assert(coy_file_read_u8(&reader, &first) && first == 7);
+        Assert(coy_file_read_f64_array(&reader, count, f64s_in, COY_BYTE_ORDER_NATIVE) == count);
+        Assert(coy_file_read_u32_array(&reader, count, u32s_in, COY_BYTE_ORDER_BIG) == count);
+        Assert(coy_file_read_u64_array(&reader, count, u64s_in, COY_BYTE_ORDER_BIG) == count);
+        Assert(coy_file_read_i16_array(&reader, count, i16s_in, COY_BYTE_ORDER_LITTLE) == count);
+        for(size i = 0; i < count; ++i)
+        {
+            Assert(f64s_in[i] == f64s[i] && u32s_in[i] == u32s[i] && u64s_in[i] == u64s[i] && i16s_in[i] == i16s[i]);
+        }
+
+        // Big endian really is big endian in the file.
+        u8 be[4] = {0};
+        Assert(coy_file_read_u8_array(&reader, 4, be, COY_BYTE_ORDER_NATIVE) == 4);
+        Assert(be[0] == (u8)(u32s[1] >> 24) && be[1] == (u8)(u32s[1] >> 16));
+        Assert(be[2] == (u8)(u32s[1] >> 8) && be[3] == (u8)u32s[1]);
+
+        // Only what's there comes back at the end of the file.
+        Assert(coy_file_read_u32_array(&reader, count, u32s_in, COY_BYTE_ORDER_BIG) == 0);
+        coy_file_reader_close(&reader);
+    }
+
+    // A value cut short by the end of the file doesn't count.
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(coy_file_write_u16_array(&writer, 3, (u16 const *)u32s, COY_BYTE_ORDER_BIG));
+    Assert(coy_file_writer_close(&writer));
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    Assert(coy_file_read_u32_array(&reader, 2, u32s_in, COY_BYTE_ORDER_NATIVE) == 1);
+    coy_file_reader_close(&reader);
+
+    coy_memory_free(&mem);
+}
+
+static void
+test_file_varints(void)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "varint_test.dat");
+    Assert(success);
+
+    u64 const edges[] = { 0, 1, 127, 128, 16383, 16384, UINT64_C(1) << 63, UINT64_MAX };
+    i64 const signed_edges[] = { 0, -1, 1, -64, 64, INT64_MIN, INT64_MAX };
+
+    // Mostly small values, runs of two byte ones, big ones mixed in, and timestamps a few ticks apart.
+    size const count = 100000;
+    CoyMemoryBlock mem = coy_memory_allocate(4 * count * sizeof(u64));
+    Assert(mem.valid);
+    u64 *vals = mem.mem;
+    u64 *vals_in = vals + count;
+    i64 *stamps = (i64 *)(vals_in + count);
+    i64 *stamps_in = stamps + count;
+    for(size i = 0; i < count; ++i)
+    {
+        vals[i] = i % 17 == 0 ? (u64)i * UINT64_C(0x9E3779B97F4A7C15) : (i / 1000) % 3 == 1 ? (u64)(128 + i % 16000)
+                                                                                            : (u64)(i % 100);
+        stamps[i] = INT64_C(1700000000000) + (i64)i * 3 - (i % 5 == 0 ? 2 : 0);
+    }
+
+    // A tiny writer buffer can't hold a whole value, an odd reader buffer splits values between refills.
+    byte small_write_buf[7] = {0};
+    byte small_read_buf[37] = {0};
+    for(i32 pass = 0; pass < 2; ++pass)
+    {
+        CoyFileWriter writer = pass == 0
+            ? coy_file_create(path_buf)
+            : coy_file_create_with_buffer(path_buf, sizeof(small_write_buf), small_write_buf);
+        Assert(writer.valid);
+        for(i32 i = 0; i < COY_ARRAY_SIZE(edges); ++i) { Assert(coy_file_write_varint_u64(&writer, edges[i])); }
+        for(i32 i = 0; i < COY_ARRAY_SIZE(signed_edges); ++i)
+        {
+            Assert(coy_file_write_varint_i64(&writer, signed_edges[i]));
+        }
+        Assert(coy_file_write_varint_u64_array(&writer, count, vals));
+
+        // In two pieces, carrying the last value across.
+        i64 last = 0;
+        Assert(coy_file_write_delta_i64_array(&writer, 1000, stamps, &last) && last == stamps[999]);
+        Assert(coy_file_write_delta_i64_array(&writer, count - 1000, stamps + 1000, &last));
+        Assert(coy_file_writer_close(&writer));
+
+        // Most values took 1 byte.
+        Assert(coy_file_size(path_buf) < (size)(count * 2 * 2));
+
+        CoyFileReader reader = pass == 0
+            ? coy_file_open_read(path_buf)
+            : coy_file_open_read_with_buffer(path_buf, sizeof(small_read_buf), small_read_buf);
+        Assert(reader.valid);
+        for(i32 i = 0; i < COY_ARRAY_SIZE(edges); ++i)
+        {
+            u64 val = 0;
+            Assert(coy_file_read_varint_u64(&reader, &val) && val == edges[i]);
+        }
+        for(i32 i = 0; i < COY_ARRAY_SIZE(signed_edges); ++i)
+        {
+            i64 val = 0;
+            Assert(coy_file_read_varint_i64(&reader, &val) && val == signed_edges[i]);
+        }
+
+        Assert(coy_file_read_varint_u64_array(&reader, count, vals_in) == count);
+        for(size i = 0; i < count; ++i) { Assert(vals_in[i] == vals[i]); }
+
+        last = 0;
+        Assert(coy_file_read_delta_i64_array(&reader, 777, stamps_in, &last) == 777 && last == stamps[776]);
+        Assert(coy_file_read_delta_i64_array(&reader, count, stamps_in + 777, &last) == count - 777);
+        for(size i = 0; i < count; ++i) { Assert(stamps_in[i] == stamps[i]); }
+
+        u64 val = 0;
+        Assert(!coy_file_read_varint_u64(&reader, &val));
+        coy_file_reader_close(&reader);
+    }
+
+    // Too long for 64 bits, and cut off by the end of the file.
+    byte const bad[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0x01, 0x80 };
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(coy_file_write(&writer, sizeof(bad), bad) == sizeof(bad));
+    Assert(coy_file_writer_close(&writer));
+
+    CoyFileReader reader = coy_file_open_read(path_buf);
+    u64 val = 0;
+    Assert(!coy_file_read_varint_u64(&reader, &val));
+    coy_file_reader_close(&reader);
+
+    reader = coy_file_open_read(path_buf);
+    Assert(coy_file_read_varint_u64_array(&reader, 3, vals_in) == -1);
+    coy_file_reader_close(&reader);
+
+    reader = coy_file_open_read(path_buf);
+    CoyByteView view = coy_file_peek(&reader, 10);
+    Assert(view.num_bytes == sizeof(bad));
+    coy_file_consume(&reader, 10);
+    Assert(coy_file_read_varint_u64(&reader, &val) && val == 1);
+    Assert(!coy_file_read_varint_u64(&reader, &val));
+    coy_file_reader_close(&reader);
+
+    coy_memory_free(&mem);
+}
+
+static size
+find_line(byte const *data, size num_bytes, void *ctx)
+{
+    for(size i = 0; i < num_bytes; ++i)
+    {
+        if(data[i] == '\n') { return i + 1; }
+    }
+    return -1;
+}
+
+static void
+test_parallel_reader(b32 in_order)
+{
+    // Create a path to the file.
+    char path_buf[1024] = {0};
+    b32 success = coy_path_append(sizeof(path_buf), path_buf, test_data_dir);
+    Assert(success);
+    success = coy_path_append(sizeof(path_buf), path_buf, "parallel_test.txt");
+    Assert(success);
+
+    // Lines of all different lengths, and no newline at the end of the file.
+    size const file_size = COY_MiB(1) + 123;
+    CoyMemoryBlock mem = coy_memory_allocate(file_size);
+    Assert(mem.valid);
+    byte *text = mem.mem;
+    size line_len = 0;
+    for(size i = 0; i < file_size; ++i)
+    {
+        if(line_len >= (i / 7) % 200 + 1) { text[i] = '\n'; line_len = 0; }
+        else { text[i] = 'a' + (i % 26); ++line_len; }
+    }
+    text[file_size - 1] = 'z';
+
+    CoyFileWriter writer = coy_file_create(path_buf);
+    Assert(writer.valid);
+    Assert(coy_file_write(&writer, file_size, text) == file_size);
+    coy_file_writer_close(&writer);
+
+    // Raw chunks, every byte shows up exactly once at the right place.
+    CoyMemoryBlock read_mem = coy_memory_allocate(file_size);
+    Assert(read_mem.valid);
+    byte *read_text = read_mem.mem;
+
+    size const chunk_size = COY_KiB(40);
+    CoyParallelReader parallel_reader = {0};
+    CoyParallelReader *reader = &parallel_reader;
+    success = coy_parallel_reader_open(reader, path_buf, chunk_size, 4, in_order, NULL, 0, NULL);
+    Assert(success);
+
+    size total = 0;
+    i64 expected_index = 0;
+    CoyFileChunk chunk = coy_parallel_reader_next(reader);
+    while(chunk.valid)
+    {
+        if(in_order) { Assert(chunk.index == expected_index++); }
+        Assert(chunk.offset == chunk.index * chunk_size);
+        Assert(chunk.num_bytes == chunk_size || chunk.offset + chunk.num_bytes == file_size);
+        for(size i = 0; i < chunk.num_bytes; ++i) { read_text[chunk.offset + i] = chunk.data[i]; }
+        total += chunk.num_bytes;
+
+        coy_parallel_reader_release(reader, &chunk);
+        Assert(!chunk.valid);
+        chunk = coy_parallel_reader_next(reader);
+    }
+    Assert(coy_parallel_reader_close(reader));
+    Assert(!reader->valid);
+    Assert(total == file_size);
+    for(size i = 0; i < file_size; ++i) { Assert(read_text[i] == text[i]); }
+
+    // Whole lines, tiny chunks so a lot of them have no line break in them at all.
+    for(size i = 0; i < file_size; ++i) { read_text[i] = 0; }
+    success = coy_parallel_reader_open(reader, path_buf, 150, 3, in_order, find_line, 256, NULL);
+    Assert(success);
+
+    total = 0;
+    size next_offset = 0;
+    chunk = coy_parallel_reader_next(reader);
+    while(chunk.valid)
+    {
+        if(in_order) { Assert(chunk.offset == next_offset); }
+        Assert(chunk.num_bytes > 0);
+        Assert(chunk.offset == 0 || text[chunk.offset - 1] == '\n');
+        Assert(chunk.offset + chunk.num_bytes == file_size || chunk.data[chunk.num_bytes - 1] == '\n');
+        for(size i = 0; i < chunk.num_bytes; ++i) { read_text[chunk.offset + i] = chunk.data[i]; }
+        total += chunk.num_bytes;
+        next_offset = chunk.offset + chunk.num_bytes;
+
+        coy_parallel_reader_release(reader, &chunk);
+        chunk = coy_parallel_reader_next(reader);
+    }
+    Assert(coy_parallel_reader_close(reader));
+    Assert(total == file_size);
+    for(size i = 0; i < file_size; ++i) { Assert(read_text[i] == text[i]); }
+
+    // A record longer than max_record_size is an error.
+    success = coy_parallel_reader_open(reader, path_buf, 150, 2, in_order, find_line, 16, NULL);
+    Assert(success);
+    chunk = coy_parallel_reader_next(reader);
+    while(chunk.valid)
+    {
+        coy_parallel_reader_release(reader, &chunk);
+        chunk = coy_parallel_reader_next(reader);
+    }
+    Assert(!coy_parallel_reader_close(reader));
+
+    coy_memory_free(&read_mem);
+    coy_memory_free(&mem);
+
+    success = coy_parallel_reader_open(reader, "not_a_real_file.dat", chunk_size, 2, in_order, NULL, 0, NULL);
+    Assert(!success && !reader->valid);
+}
+
 /*---------------------------------------------------------------------------------------------------------------------------
  *                                                    All file IO tests
  *-------------------------------------------------------------------------------------------------------------------------*/
@@ -149,5 +1359,22 @@ coyote_file_tests(void)
     test_file_create_write_append_open_read_close();
     test_memmap_read();
     test_file_slurp();
+    test_file_slurp_arena();
+    test_file_read_f64_into_vec();
+    test_file_read_ring();
+    test_file_peek_consume();
+    test_file_caller_buffers();
+    test_file_vectored_io();
+    test_file_typed_arrays();
+    test_file_varints();
+    test_file_background_writer();
+    test_direct_io();
+    test_file_access_hints();
+    test_memmap_write();
+    test_memmap_windows();
+    test_async_file(0);
+    test_async_file(COY_ASYNC_FLAG_NO_IO_URING);
+    test_parallel_reader(true);
+    test_parallel_reader(false);
 }
 
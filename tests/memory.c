@@ -45,6 +45,592 @@ test_allocate_free(void)
 
 }
 
+static void
+test_arena(void)
+{
+    CoyArena arena = coy_arena_create(COY_KiB(4));
+    Assert(arena.valid);
+    Assert(arena.buf_size >= COY_KiB(4));
+
+    u8 *a_byte = COY_ARENA_PUSH(&arena, u8);
+    Assert(a_byte);
+    *a_byte = 0xFF;
+
+    /* Alignment is honored even after an odd sized push. */
+    u64 *a_u64 = COY_ARENA_PUSH_ZERO(&arena, u64);
+    Assert(a_u64 && ((uptr)a_u64 % _Alignof(u64)) == 0);
+    Assert(*a_u64 == 0);
+
+    void *aligned = coy_arena_push(&arena, 3, 64);
+    Assert(aligned && ((uptr)aligned % 64) == 0);
+
+    /* Restoring a marker releases everything pushed after it, and the memory is handed out again. */
+    CoyArenaMarker mark = coy_arena_save(&arena);
+    i32 *ints = COY_ARENA_PUSH_ARRAY(&arena, i32, 100);
+    Assert(ints);
+    for(i32 i = 0; i < 100; ++i) { ints[i] = i; }
+    coy_arena_restore(mark);
+    Assert(arena.offset == mark.offset);
+
+    i32 *zeros = COY_ARENA_PUSH_ARRAY_ZERO(&arena, i32, 100);
+    Assert(zeros == ints);
+    for(i32 i = 0; i < 100; ++i) { Assert(zeros[i] == 0); }
+
+    /* Running out of space returns NULL and leaves the arena untouched. */
+    size offset = arena.offset;
+    Assert(coy_arena_push(&arena, arena.buf_size, 1) == NULL);
+    Assert(arena.offset == offset);
+
+    coy_arena_reset(&arena);
+    Assert(coy_arena_bytes_remaining(&arena) == arena.buf_size);
+    Assert(coy_arena_push(&arena, arena.buf_size, 1) == arena.buf);
+
+    coy_arena_destroy(&arena);
+    Assert(!arena.valid);
+
+    /* An arena over a caller provided buffer. */
+    _Alignas(16) byte buffer[256];
+    arena = coy_arena_create_from_buffer(sizeof(buffer), buffer);
+    Assert(arena.valid);
+    f64 *vals = COY_ARENA_PUSH_ARRAY(&arena, f64, 32);
+    Assert((byte *)vals == buffer);
+    Assert(COY_ARENA_PUSH(&arena, u8) == NULL);
+    coy_arena_destroy(&arena);
+    Assert(!arena.valid);
+}
+
+static void
+test_reserve_commit_decommit(void)
+{
+    size page_size = coy_memory_page_size();
+    Assert(page_size > 0);
+
+    CoyMemoryBlock mem = coy_memory_reserve(COY_GiB(1));
+    Assert(mem.valid);
+    Assert(mem.size >= COY_GiB(1));
+    Assert(mem.committed == 0);
+
+    /* Commit the front and a range in the middle of the block that doesn't start on a page boundary. */
+    b32 success = coy_memory_commit(&mem, 0, COY_MiB(1));
+    Assert(success);
+    Assert(mem.committed == COY_MiB(1));
+
+    success = coy_memory_commit(&mem, COY_MiB(512) + 10, page_size);
+    Assert(success);
+    Assert(mem.committed == COY_MiB(1) + 2 * page_size);
+
+    u8 *byte = mem.mem;
+    for(size i = 0; i < COY_MiB(1); ++i) { byte[i] = (i & 0xFF); }
+    for(size i = 0; i < COY_MiB(1); ++i) { Assert(byte[i] == (i & 0xFF)); }
+
+    u8 *middle = byte + COY_MiB(512);
+    for(size i = 0; i < 2 * page_size; ++i) { middle[i] = 0xAB; }
+
+    /* Decommitted pages come back zeroed when they're committed again. */
+    success = coy_memory_decommit(&mem, COY_MiB(512), 2 * page_size);
+    Assert(success);
+    Assert(mem.committed == COY_MiB(1));
+
+    success = coy_memory_commit(&mem, COY_MiB(512), 2 * page_size);
+    Assert(success);
+    for(size i = 0; i < 2 * page_size; ++i) { Assert(middle[i] == 0); }
+    Assert(mem.committed == COY_MiB(1) + 2 * page_size);
+
+    /* Overlapping ranges can't push the count past the block size or below zero. */
+    success = coy_memory_commit(&mem, 0, mem.size);
+    Assert(success);
+    Assert(mem.committed == mem.size);
+
+    success = coy_memory_decommit(&mem, 0, mem.size);
+    Assert(success);
+    Assert(mem.committed == 0);
+
+    success = coy_memory_decommit(&mem, 0, COY_MiB(1));
+    Assert(success);
+    Assert(mem.committed == 0);
+
+    coy_memory_free(&mem);
+    Assert(!mem.valid);
+}
+
+static void
+test_arena_reserved(void)
+{
+    CoyArena arena = coy_arena_create_reserved(COY_GiB(4));
+    Assert(arena.valid);
+    Assert(arena.buf_size >= COY_GiB(4));
+    Assert(arena.mem.committed == 0);
+
+    /* Memory is only committed as the arena grows. */
+    u64 *vals = COY_ARENA_PUSH_ARRAY(&arena, u64, 1000);
+    Assert(vals);
+    for(i32 i = 0; i < 1000; ++i) { vals[i] = i; }
+    Assert(arena.mem.committed == COY_ARENA_COMMIT_SIZE);
+
+    u8 *big = COY_ARENA_PUSH_ARRAY(&arena, u8, COY_MiB(3));
+    Assert(big);
+    for(size i = 0; i < COY_MiB(3); ++i) { big[i] = 0xCD; }
+    Assert(arena.mem.committed >= arena.offset && arena.mem.committed < arena.offset + COY_ARENA_COMMIT_SIZE);
+    for(i32 i = 0; i < 1000; ++i) { Assert(vals[i] == i); }
+
+    /* Still fails cleanly past the end of the reservation. */
+    Assert(coy_arena_push(&arena, arena.buf_size, 1) == NULL);
+
+    coy_arena_destroy(&arena);
+    Assert(!arena.valid);
+}
+
+static void
+test_allocate_huge_pages(void)
+{
+    CoyMemoryBlock mem = coy_memory_allocate_with_flags(COY_MiB(8) + 1, COY_MEMORY_FLAG_HUGE_PAGES);
+    Assert(mem.valid);
+    Assert(mem.size > COY_MiB(8) && mem.committed == mem.size);
+
+    /* Whatever the OS gave us, huge pages are always aligned to their size. */
+    switch(mem.page_kind)
+    {
+        case COY_MEMORY_PAGES_HUGE_1GiB: Assert((uptr)mem.mem % COY_GiB(1) == 0); break;
+        case COY_MEMORY_PAGES_HUGE_2MiB: /* fall through */
+        case COY_MEMORY_PAGES_TRANSPARENT_HUGE: Assert((uptr)mem.mem % COY_MiB(2) == 0); break;
+        case COY_MEMORY_PAGES_NORMAL: break;
+        default: Assert(false);
+    }
+
+    u8 *byte = mem.mem;
+    for(size i = 0; i < mem.size; ++i) { byte[i] = (i & 0xFF); }
+    for(size i = 0; i < mem.size; ++i) { Assert(byte[i] == (i & 0xFF)); }
+
+    coy_memory_free(&mem);
+    Assert(!mem.valid);
+
+    mem = coy_memory_allocate_with_flags(COY_KiB(1), 0);
+    Assert(mem.valid && mem.page_kind == COY_MEMORY_PAGES_NORMAL);
+    coy_memory_free(&mem);
+    Assert(!mem.valid);
+}
+
+static void
+test_pool(void)
+{
+    CoyMemoryBlock mem = coy_memory_allocate(COY_KiB(4));
+    Assert(mem.valid);
+
+    typedef struct { f64 x; f64 y; f64 z; } Point;
+    CoyPool pool = coy_pool_create(&mem, sizeof(Point), _Alignof(Point));
+    Assert(pool.valid);
+
+    CoyPoolStats stats = coy_pool_stats(&pool);
+    Assert(stats.capacity == mem.size / sizeof(Point));
+    Assert(stats.in_use == 0 && stats.high_water == 0);
+
+    /* Exhaust the pool. */
+    Point *first = coy_pool_alloc(&pool);
+    Assert(first && ((uptr)first % _Alignof(Point)) == 0);
+    Point *last = first;
+    for(size i = 1; i < stats.capacity; ++i)
+    {
+        Point *pnt = coy_pool_alloc(&pool);
+        Assert(pnt && pnt != last);
+        *pnt = (Point){ .x = i, .y = i, .z = i };
+        last = pnt;
+    }
+    Assert(coy_pool_alloc(&pool) == NULL);
+
+    stats = coy_pool_stats(&pool);
+    Assert(stats.in_use == stats.capacity && stats.high_water == stats.capacity);
+
+    /* Freed objects are reused, most recently freed first. */
+    coy_pool_free(&pool, first);
+    coy_pool_free(&pool, last);
+    Assert(coy_pool_alloc(&pool) == last);
+    Assert(coy_pool_alloc(&pool) == first);
+    coy_pool_free(&pool, first);
+
+    stats = coy_pool_stats(&pool);
+    Assert(stats.in_use == stats.capacity - 1 && stats.high_water == stats.capacity);
+
+    /* Caches move objects in batches, and can give them back to the pool. */
+    CoyPoolCache cache = coy_pool_cache_create(&pool);
+    Assert(coy_pool_cache_alloc(&cache) == first);
+    Assert(coy_pool_cache_alloc(&cache) == NULL);
+    coy_pool_cache_free(&cache, first);
+    coy_pool_cache_flush(&cache);
+    Assert(cache.count == 0);
+    Assert(coy_pool_stats(&pool).in_use == stats.capacity - 1);
+
+    coy_pool_destroy(&pool);
+    Assert(!pool.valid);
+    coy_memory_free(&mem);
+}
+
+static char *
+scratch_join_paths(CoyArena *out, char const *dir, char const *file)
+{
+    /* The result goes on the caller's arena, the path is built on a scratch arena that doesn't conflict with it. */
+    CoyArenaMarker scratch = coy_scratch_begin(1, &out);
+    Assert(scratch.arena && scratch.arena != out);
+
+    char *path_buf = COY_ARENA_PUSH_ARRAY_ZERO(scratch.arena, char, 1024);
+    Assert(path_buf);
+    b32 success = coy_path_append(1024, path_buf, dir);
+    Assert(success);
+    success = coy_path_append(1024, path_buf, file);
+    Assert(success);
+
+    size len = 0;
+    while(path_buf[len]) { ++len; }
+    char *result = COY_ARENA_PUSH_ARRAY(out, char, len + 1);
+    Assert(result);
+    memcpy(result, path_buf, len + 1);
+
+    coy_scratch_end(scratch);
+    return result;
+}
+
+static void
+test_scratch(void)
+{
+    CoyArenaMarker scratch = coy_scratch_begin(0, NULL);
+    Assert(scratch.arena && scratch.arena->valid);
+    CoyArena *outer = scratch.arena;
+
+    /* The scratch arena passed as a conflict is never handed out again. */
+    char *joined = scratch_join_paths(outer, "tmp_output", "README.md");
+    Assert(joined && joined[0] == 't');
+    Assert(coy_path_info(joined, false).exists);
+
+    CoyArenaMarker inner = coy_scratch_begin(1, &outer);
+    Assert(inner.arena && inner.arena != outer);
+
+    /* Every scratch arena is in use. */
+    CoyArena *both[2] = { outer, inner.arena };
+    CoyArenaMarker none = coy_scratch_begin(2, both);
+    Assert(none.arena == NULL);
+    coy_scratch_end(none);
+
+    size inner_offset = inner.arena->offset;
+    u8 *tmp = COY_ARENA_PUSH_ARRAY(inner.arena, u8, COY_MiB(1));
+    Assert(tmp);
+    coy_scratch_end(inner);
+    Assert(inner.arena->offset == inner_offset);
+
+    coy_scratch_end(scratch);
+    Assert(outer->offset == scratch.offset);
+
+    coy_scratch_release();
+    Assert(!outer->valid && !inner.arena->valid);
+}
+
+static void
+test_vec(void)
+{
+    CoyVec vec = COY_VEC_CREATE(f64, 100000000);
+    Assert(vec.valid);
+    Assert(vec.len == 0 && vec.capacity == 0 && vec.max_len >= 100000000);
+
+    /* Pointers stay valid as the array grows. */
+    f64 *first = COY_VEC_PUSH(&vec, f64);
+    Assert(first);
+    *first = 0.0;
+    for(i32 i = 1; i < 1000000; ++i)
+    {
+        f64 val = i;
+        f64 *pushed = coy_vec_push(&vec, &val);
+        Assert(pushed && *pushed == val);
+    }
+    Assert(vec.len == 1000000 && vec.capacity >= vec.len);
+    Assert(first == (f64 *)vec.data);
+    for(i32 i = 0; i < 1000000; ++i) { Assert(COY_VEC_AT(&vec, f64, i) == i); }
+
+    f64 *more = coy_vec_extend(&vec, 500);
+    Assert(more == (f64 *)vec.data + 1000000);
+    Assert(vec.len == 1000500);
+
+    coy_vec_truncate(&vec, 10);
+    Assert(vec.len == 10 && COY_VEC_AT(&vec, f64, 9) == 9.0);
+
+    /* Can't go past the reservation. */
+    Assert(!coy_vec_reserve(&vec, vec.max_len + 1));
+    Assert(coy_vec_extend(&vec, vec.max_len) == NULL);
+    Assert(vec.len == 10);
+
+    coy_vec_destroy(&vec);
+    Assert(!vec.valid);
+}
+
+static void
+test_memory_cache(void)
+{
+    CoyMemoryCache cache = coy_memory_cache_create(COY_MiB(64));
+
+    CoyMemoryBlock mem = coy_memory_cache_allocate(&cache, COY_MiB(4) + 1);
+    Assert(mem.valid && mem.size >= COY_MiB(4) + 1);
+    Assert(cache.misses == 1 && cache.hits == 0);
+
+    u8 *byte = mem.mem;
+    for(size i = 0; i < mem.size; ++i) { byte[i] = (i & 0xFF); }
+    void *first_ptr = mem.mem;
+    size first_size = mem.size;
+
+    coy_memory_cache_free(&cache, &mem);
+    Assert(!mem.valid);
+    Assert(cache.count == 1 && cache.bytes_cached == first_size);
+
+    /* Same size class gets the same block back. */
+    mem = coy_memory_cache_allocate(&cache, COY_MiB(4) + 100);
+    Assert(mem.valid && mem.mem == first_ptr && mem.size == first_size);
+    Assert(cache.hits == 1 && cache.count == 0 && cache.bytes_cached == 0);
+
+    /* A different size class does not. */
+    CoyMemoryBlock other = coy_memory_cache_allocate(&cache, COY_MiB(16));
+    Assert(other.valid && other.mem != first_ptr);
+    Assert(cache.misses == 2);
+
+    coy_memory_cache_free(&cache, &mem);
+    coy_memory_cache_free(&cache, &other);
+    Assert(cache.count == 2);
+
+    /* Trimming releases the oldest first. */
+    coy_memory_cache_trim(&cache, COY_MiB(16));
+    Assert(cache.count == 1 && cache.blocks[0].size == COY_MiB(16));
+
+    /* Blocks that won't fit in the cache are just freed. */
+    CoyMemoryBlock huge = coy_memory_cache_allocate(&cache, COY_MiB(128));
+    Assert(huge.valid);
+    coy_memory_cache_free(&cache, &huge);
+    Assert(!huge.valid && cache.count == 1);
+
+    /* Every size class comes back from the OS exactly that size, so all of them can be cached. */
+    coy_memory_cache_trim(&cache, 0);
+    for(size num_bytes = COY_KiB(60); num_bytes <= COY_KiB(300); num_bytes += COY_KiB(10))
+    {
+        mem = coy_memory_cache_allocate(&cache, num_bytes);
+        Assert(mem.valid && mem.size >= num_bytes);
+        coy_memory_cache_free(&cache, &mem);
+        Assert(cache.count == 1);
+
+        mem = coy_memory_cache_allocate(&cache, num_bytes);
+        Assert(mem.valid && cache.count == 0);
+        coy_memory_cache_free(&cache, &mem);
+        coy_memory_cache_trim(&cache, 0);
+    }
+
+    coy_memory_cache_destroy(&cache);
+    Assert(cache.count == 0 && cache.bytes_cached == 0);
+}
+
+static void
+test_allocate_prefault_parallel(void)
+{
+    coy_profile_initialize_os_metrics();
+
+    CoyPrefaultStats stats = {0};
+    CoyMemoryBlock mem = coy_memory_allocate_prefault_parallel(COY_MiB(256), 4, &stats);
+    Assert(mem.valid);
+    Assert(mem.size >= COY_MiB(256) && mem.committed == mem.size);
+    Assert(stats.num_threads == 4);
+    Assert(stats.seconds >= 0.0);
+
+    /* About one fault per page. Only the calling thread's quarter would show up if the workers weren't counted. */
+    size num_pages = mem.size / coy_memory_page_size();
+    if(coy_global_os_metrics.initialized) { Assert(stats.page_faults >= (u64)(num_pages * 9 / 10)); }
+
+    u8 *byte = mem.mem;
+    for(size i = 0; i < mem.size; ++i) { Assert(byte[i] == 0); }
+    for(size i = 0; i < mem.size; ++i) { byte[i] = (i & 0xFF); }
+    for(size i = 0; i < mem.size; ++i) { Assert(byte[i] == (i & 0xFF)); }
+
+    coy_memory_free(&mem);
+    Assert(!mem.valid);
+
+    /* Never uses more threads than there are pages. */
+    mem = coy_memory_allocate_prefault_parallel(1, 8, &stats);
+    Assert(mem.valid && stats.num_threads == 1);
+    coy_memory_free(&mem);
+
+    mem = coy_memory_allocate_prefault_parallel(COY_MiB(1), 0, NULL);
+    Assert(mem.valid);
+    coy_memory_free(&mem);
+}
+
+static void
+test_allocate_numa(void)
+{
+    i32 num_nodes = coy_numa_node_count();
+    Assert(num_nodes >= 1);
+
+    for(i32 node = 0; node < num_nodes; ++node)
+    {
+        CoyMemoryBlock mem = coy_memory_allocate_numa(COY_MiB(4), node);
+        Assert(mem.valid);
+        Assert(mem.size >= COY_MiB(4) && mem.committed == mem.size);
+
+        u8 *byte = mem.mem;
+        for(size i = 0; i < mem.size; ++i) { Assert(byte[i] == 0); }
+        for(size i = 0; i < mem.size; ++i) { byte[i] = (i & 0xFF); }
+        for(size i = 0; i < mem.size; ++i) { Assert(byte[i] == (i & 0xFF)); }
+
+        /* A preference, not a guarantee, but an idle test machine shouldn't run out of memory on a node. */
+        Assert(coy_memory_node(&mem) == node);
+
+        coy_memory_free(&mem);
+        Assert(!mem.valid);
+    }
+
+    CoyMemoryBlock mem = coy_memory_allocate_numa(COY_MiB(4), COY_NUMA_INTERLEAVE);
+    Assert(mem.valid);
+    i32 node = coy_memory_node(&mem);
+    Assert(node >= 0 && node < num_nodes);
+    coy_memory_free(&mem);
+
+    mem = coy_memory_allocate_numa(COY_MiB(4), num_nodes);
+    Assert(!mem.valid);
+
+    mem = coy_memory_reserve(COY_MiB(4));
+    Assert(coy_memory_node(&mem) == -1);
+    coy_memory_free(&mem);
+}
+
+static void
+test_memory_tags(void)
+{
+#if COY_MEMORY_TAGS
+    enum { TAG_BIG = 1, TAG_SMALL = 2 };
+
+    CoyMemoryTagStats before = coy_global_memory_tags.tags[TAG_BIG];
+
+    CoyMemoryBlock big = coy_memory_allocate_tagged(COY_MiB(8), TAG_BIG, "big");
+    Assert(big.valid);
+    CoyMemoryBlock small[4] = {0};
+    for(i32 i = 0; i < 4; ++i)
+    {
+        small[i] = coy_memory_allocate_tagged(100, TAG_SMALL, "small");
+        Assert(small[i].valid);
+    }
+
+    CoyMemoryTagStats *big_stats = &coy_global_memory_tags.tags[TAG_BIG];
+    CoyMemoryTagStats *small_stats = &coy_global_memory_tags.tags[TAG_SMALL];
+    Assert(big_stats->current_bytes == before.current_bytes + big.committed);
+    Assert(big_stats->allocation_count == before.allocation_count + 1);
+    Assert(small_stats->current_bytes >= 4 * coy_memory_page_size());
+
+    /* Freeing drops the current bytes, but not the peak. */
+    coy_memory_free_tagged(&small[3], TAG_SMALL);
+    Assert(!small[3].valid);
+    size small_peak = small_stats->peak_bytes;
+    Assert(small_stats->current_bytes < small_peak);
+
+    coy_memory_tag_report();
+    Assert(small_stats->live_allocations == 3);
+    Assert(big_stats->peak_mib >= 8.0);
+
+    /* big was prefaulted when it was allocated, freshly committed pages fault on first touch. */
+    coy_profile_initialize_os_metrics();
+    CoyMemoryBlock lazy = coy_memory_reserve(COY_MiB(8));
+    Assert(lazy.valid && coy_memory_commit(&lazy, 0, lazy.size));
+    u64 faults_before = big_stats->page_faults;
+
+    CoyMemoryTagAnchor ap = coy_memory_tag_begin(TAG_BIG);
+    u8 *bytes = big.mem;
+    for(size i = 0; i < big.size; ++i) { bytes[i] = 1; }
+    bytes = lazy.mem;
+    for(size i = 0; i < lazy.size; ++i) { bytes[i] = 1; }
+    coy_memory_tag_end(&ap);
+
+    if(coy_global_os_metrics.initialized) { Assert(big_stats->page_faults > faults_before); }
+    coy_memory_free(&lazy);
+
+    coy_memory_free_tagged(&big, TAG_BIG);
+    for(i32 i = 0; i < 3; ++i) { coy_memory_free_tagged(&small[i], TAG_SMALL); }
+
+    coy_memory_tag_report();
+    Assert(big_stats->current_bytes == before.current_bytes);
+    Assert(small_stats->current_bytes == 0 && small_stats->live_allocations == 0);
+    Assert(small_stats->peak_bytes == small_peak);
+#else
+    CoyMemoryBlock mem = coy_memory_allocate_tagged(100, 0, "untagged");
+    Assert(mem.valid);
+    coy_memory_free_tagged(&mem, 0);
+    Assert(!mem.valid);
+#endif
+}
+
+static void
+test_ring_buffer(void)
+{
+    CoyRingBuffer ring = coy_ring_buffer_create(100);
+    Assert(ring.valid);
+    Assert(ring.capacity >= 100 && ring.capacity % coy_memory_page_size() == 0);
+    Assert(coy_ring_buffer_bytes(&ring) == 0 && coy_ring_buffer_space(&ring) == ring.capacity);
+
+    /* The second half is the same memory as the first. */
+    ring.buf[0] = 42;
+    Assert(ring.buf[ring.capacity] == 42);
+    ring.buf[2 * ring.capacity - 1] = 43;
+    Assert(ring.buf[ring.capacity - 1] == 43);
+
+    /* Write and read in odd sized pieces so they keep wrapping around. */
+    u32 next_write = 0;
+    u32 next_read = 0;
+    for(i32 round = 0; round < 1000; ++round)
+    {
+        size num_write = coy_ring_buffer_space(&ring) / sizeof(u32);
+        if(num_write > 37) { num_write = 37; }
+        u32 *write = (u32 *)coy_ring_buffer_write_ptr(&ring);
+        for(size i = 0; i < num_write; ++i) { write[i] = next_write++; }
+        coy_ring_buffer_produce(&ring, num_write * sizeof(u32));
+
+        size num_read = coy_ring_buffer_bytes(&ring) / sizeof(u32);
+        if(num_read > 23) { num_read = 23; }
+        u32 const *read = (u32 const *)coy_ring_buffer_read_ptr(&ring);
+        for(size i = 0; i < num_read; ++i) { Assert(read[i] == next_read++); }
+        coy_ring_buffer_consume(&ring, num_read * sizeof(u32));
+
+        Assert(ring.read_offset < ring.capacity);
+    }
+    Assert(next_read > 2 * ring.capacity / sizeof(u32)); /* It really did wrap. */
+
+    coy_ring_buffer_destroy(&ring);
+    Assert(!ring.valid);
+}
+
+static void
+test_memory_lock(void)
+{
+    /* Stay well under the default RLIMIT_MEMLOCK, it's only 64 KiB on some systems. */
+    CoyMemoryBlock mem = coy_memory_allocate_with_flags(COY_KiB(32), COY_MEMORY_FLAG_LOCKED);
+    Assert(mem.valid);
+    Assert(mem.size >= COY_KiB(32));
+
+    u8 *byte = mem.mem;
+    for(size i = 0; i < mem.size; ++i) { byte[i] = (i & 0xFF); }
+    for(size i = 0; i < mem.size; ++i) { Assert(byte[i] == (i & 0xFF)); }
+
+    b32 success = coy_memory_unlock(&mem);
+    Assert(success);
+    success = coy_memory_lock(&mem, false);
+    Assert(success);
+    coy_memory_free(&mem);
+
+    /* Lock on fault with a reserved block, commit and touch it afterwards. */
+    mem = coy_memory_reserve(COY_KiB(32));
+    Assert(mem.valid);
+    success = coy_memory_commit(&mem, 0, COY_KiB(16));
+    Assert(success);
+    success = coy_memory_lock(&mem, true);
+#if defined(__linux__)
+    Assert(success);
+#endif
+    byte = mem.mem;
+    for(size i = 0; i < COY_KiB(16); ++i) { byte[i] = 1; }
+    coy_memory_free(&mem);
+
+    CoyMemoryBlock invalid = { .valid = false };
+    Assert(!coy_memory_lock(&invalid, false));
+    Assert(!coy_memory_unlock(&invalid));
+}
+
 /*---------------------------------------------------------------------------------------------------------------------------
  *                                                     All file Memory
  *-------------------------------------------------------------------------------------------------------------------------*/
@@ -52,5 +638,18 @@ void
 coyote_memory_tests(void)
 {
     test_allocate_free();
+    test_arena();
+    test_reserve_commit_decommit();
+    test_arena_reserved();
+    test_allocate_huge_pages();
+    test_pool();
+    test_scratch();
+    test_vec();
+    test_memory_cache();
+    test_allocate_prefault_parallel();
+    test_allocate_numa();
+    test_memory_tags();
+    test_ring_buffer();
+    test_memory_lock();
 }
 
@@ -74,6 +74,22 @@ main(int argc, char *argv[])
         }
     }
 #endif
+
+#if COY_MEMORY_TAGS
+    coy_memory_tag_report();
+    printf("\nMemory Peak = %.3lf MiB\n", (f64)coy_global_memory_tags.total_peak_bytes / COY_MiB(1));
+
+    for(i32 i = 0; i < COY_MEMORY_NUM_TAGS; ++i)
+    {
+        CoyMemoryTagStats *tag = &coy_global_memory_tags.tags[i];
+        if(tag->allocation_count)
+        {
+            printf("%-28s Allocs: %4"PRIu64" Live: %3"PRIu64" Current: %9.3lf MiB Peak: %9.3lf MiB Faults: %"PRIu64"\n",
+                    tag->label, tag->allocation_count, tag->live_allocations, tag->current_mib, tag->peak_mib,
+                    tag->page_faults);
+        }
+    }
+#endif
     return EXIT_SUCCESS;
 }
 
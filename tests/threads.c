@@ -201,6 +201,245 @@ test_multiple_producer_multiple_consumer(i32 num_to_send)
     Assert(total == 4 * num_to_send);
 }
 
+typedef struct
+{
+    CoyChannel *outbound;
+    CoyPool *pool;
+    u64 num_to_send;
+} PoolProducerThreadData;
+
+typedef struct
+{
+    CoyChannel *inbound;
+    CoyPool *pool;
+    u64 sum_received;
+} PoolConsumerThreadData;
+
+static void
+pool_producer(void *data)
+{
+    PoolProducerThreadData *pdata = data;
+    CoyPoolCache cache = coy_pool_cache_create(pdata->pool);
+
+    coy_channel_register_sender(pdata->outbound);
+    coy_channel_wait_until_ready_to_send(pdata->outbound);
+
+    for(u64 i = 0; i < pdata->num_to_send; ++i)
+    {
+        u64 *msg = coy_pool_cache_alloc(&cache);
+        while(!msg)
+        {
+            /* Every message is in flight, give the consumers a chance to free some. */
+            coy_pool_cache_flush(&cache);
+            msg = coy_pool_cache_alloc(&cache);
+        }
+
+        *msg = i;
+        b32 success = coy_channel_send(pdata->outbound, msg);
+        Assert(success);
+    }
+
+    coy_pool_cache_flush(&cache);
+    coy_channel_done_sending(pdata->outbound);
+}
+
+static void
+pool_consumer(void *data)
+{
+    PoolConsumerThreadData *cdata = data;
+    CoyPoolCache cache = coy_pool_cache_create(cdata->pool);
+
+    coy_channel_register_receiver(cdata->inbound);
+    coy_channel_wait_until_ready_to_receive(cdata->inbound);
+
+    void *val;
+    while(coy_channel_receive(cdata->inbound, &val))
+    {
+        cdata->sum_received += *(u64 *)val;
+        coy_pool_cache_free(&cache, val);
+    }
+
+    coy_pool_cache_flush(&cache);
+    coy_channel_done_receiving(cdata->inbound);
+}
+
+static void
+test_pool_through_channel(i32 num_to_send)
+{
+    /* Room for lots of messages in flight, so the caches on both ends get exercised. */
+    CoyMemoryBlock mem = coy_memory_allocate(COY_KiB(64));
+    Assert(mem.valid);
+    CoyPool pool = coy_pool_create(&mem, sizeof(u64), _Alignof(u64));
+    Assert(pool.valid);
+
+    CoyChannel chan = coy_channel_create();
+
+    b32 success = true;
+    PoolProducerThreadData pdata[4] = {0};
+    CoyThread producer_threads[4] = {0};
+    for(i32 i = 0; i < 4; ++i)
+    {
+        pdata[i] = (PoolProducerThreadData){ .outbound = &chan, .pool = &pool, .num_to_send = num_to_send };
+        success = coy_thread_create(&producer_threads[i], pool_producer, &pdata[i]);
+        Assert(success);
+    }
+
+    PoolConsumerThreadData cdata[4] = {0};
+    CoyThread consumer_threads[4] = {0};
+    for(i32 i = 0; i < 4; ++i)
+    {
+        cdata[i] = (PoolConsumerThreadData){ .inbound = &chan, .pool = &pool, .sum_received = 0 };
+        success = coy_thread_create(&consumer_threads[i], pool_consumer, &cdata[i]);
+        Assert(success);
+    }
+
+    for(i32 i = 0; i < 4; ++i)
+    {
+        success = coy_thread_join(&producer_threads[i]);
+        Assert(success);
+    }
+
+    for(i32 i = 0; i < 4; ++i)
+    {
+        success = coy_thread_join(&consumer_threads[i]);
+        Assert(success);
+    }
+
+    coy_channel_destroy(&chan, NULL, NULL);
+
+    u64 total = 0;
+    for(i32 i = 0; i < 4; ++i)
+    {
+        total += cdata[i].sum_received;
+    }
+
+    u64 n = num_to_send;
+    Assert(total == 4 * (n * (n - 1) / 2));
+
+    CoyPoolStats stats = coy_pool_stats(&pool);
+    Assert(stats.in_use == 0);
+    Assert(stats.high_water > 0 && stats.high_water <= stats.capacity);
+
+    coy_pool_destroy(&pool);
+    coy_memory_free(&mem);
+}
+
+static void
+scratch_user(void *data)
+{
+    CoyArena **arena_out = data;
+
+    CoyArenaMarker scratch = coy_scratch_begin(0, NULL);
+    Assert(scratch.arena);
+
+    u64 *vals = COY_ARENA_PUSH_ARRAY(scratch.arena, u64, 1000);
+    Assert(vals);
+    for(i32 i = 0; i < 1000; ++i) { vals[i] = i; }
+    for(i32 i = 0; i < 1000; ++i) { Assert(vals[i] == i); }
+
+    *arena_out = scratch.arena;
+    coy_scratch_end(scratch);
+}
+
+static void
+test_scratch_per_thread(void)
+{
+    CoyArena *arenas[4] = {0};
+    CoyThread threads[4] = {0};
+    for(i32 i = 0; i < 4; ++i)
+    {
+        b32 success = coy_thread_create(&threads[i], scratch_user, &arenas[i]);
+        Assert(success);
+    }
+
+    for(i32 i = 0; i < 4; ++i)
+    {
+        b32 success = coy_thread_join(&threads[i]);
+        Assert(success);
+    }
+
+    /* Each thread got its own scratch arena, not this thread's. */
+    CoyArenaMarker scratch = coy_scratch_begin(0, NULL);
+    Assert(scratch.arena);
+    for(i32 i = 0; i < 4; ++i)
+    {
+        Assert(arenas[i] && arenas[i] != scratch.arena);
+    }
+    coy_scratch_end(scratch);
+    coy_scratch_release();
+}
+
+typedef struct
+{
+    i32 node;
+    b32 bound;
+    i32 memory_node;
+} NumaThreadData;
+
+static void
+numa_worker(void *data)
+{
+    NumaThreadData *ndata = data;
+    ndata->bound = coy_numa_bind_current_thread(ndata->node);
+
+    /* First touch from a bound thread lands on its node. */
+    CoyMemoryBlock mem = coy_memory_allocate_prefault_parallel(COY_MiB(1), 1, NULL);
+    Assert(mem.valid);
+    ndata->memory_node = coy_memory_node(&mem);
+    coy_memory_free(&mem);
+}
+
+static void
+test_numa_bind_threads(void)
+{
+    i32 num_nodes = coy_numa_node_count();
+    Assert(num_nodes >= 1 && num_nodes <= 64);
+
+    NumaThreadData data[64] = {0};
+    CoyThread threads[64] = {0};
+    for(i32 i = 0; i < num_nodes; ++i)
+    {
+        data[i].node = i;
+        b32 success = coy_thread_create(&threads[i], numa_worker, &data[i]);
+        Assert(success);
+    }
+
+    for(i32 i = 0; i < num_nodes; ++i)
+    {
+        b32 success = coy_thread_join(&threads[i]);
+        Assert(success);
+        Assert(data[i].bound);
+        Assert(data[i].memory_node == i);
+    }
+
+    Assert(!coy_numa_bind_current_thread(num_nodes));
+    Assert(!coy_numa_bind_current_thread(-1));
+}
+
+static void
+stack_locker(void *data)
+{
+    b32 *locked = data;
+    *locked = coy_thread_stack_prefault_lock(COY_KiB(32));
+
+    /* Use the stack we just locked. */
+    byte volatile buffer[COY_KiB(16)];
+    for(i32 i = 0; i < COY_KiB(16); ++i) { buffer[i] = (byte)i; }
+    for(i32 i = 0; i < COY_KiB(16); ++i) { Assert(buffer[i] == (byte)i); }
+}
+
+static void
+test_thread_stack_prefault_lock(void)
+{
+    b32 locked = false;
+    CoyThread thread = {0};
+    b32 success = coy_thread_create(&thread, stack_locker, &locked);
+    Assert(success);
+    success = coy_thread_join(&thread);
+    Assert(success);
+    Assert(locked);
+}
+
 /*---------------------------------------------------------------------------------------------------------------------------
  *                                                   All threads tests
  *-------------------------------------------------------------------------------------------------------------------------*/
@@ -220,5 +459,14 @@ coyote_threads_tests(void)
     fprintf(stderr,".mpmc..");
     test_multiple_producer_multiple_consumer(1000000);
     test_multiple_producer_multiple_consumer(10);
+    fprintf(stderr,".pool..");
+    test_pool_through_channel(1000000);
+    test_pool_through_channel(10);
+    fprintf(stderr,".scratch..");
+    test_scratch_per_thread();
+    fprintf(stderr,".numa..");
+    test_numa_bind_threads();
+    fprintf(stderr,".stack lock..");
+    test_thread_stack_prefault_lock();
 }
 